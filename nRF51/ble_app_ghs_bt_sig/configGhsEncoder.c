@@ -663,23 +663,7 @@ void cleanUpMsmtGroupData(s_MsmtGroupData** msmtGroupDataPtr)
     s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
     if (msmtGroupData != NULL)
     {
-        if (msmtGroupData->sGhsMsmtIndex != NULL)
-        {
-            int i;
-            for (i = 0; i < msmtGroupData->currentGhsMsmtCount; i++)
-            {
-                if (msmtGroupData->sGhsMsmtIndex[i] != NULL)
-                {
-                    free(msmtGroupData->sGhsMsmtIndex[i]);
-                }
-            }
-            free(msmtGroupData->sGhsMsmtIndex);
-        }
-        if (msmtGroupData->data != NULL)
-        {
-            free(msmtGroupData->data);
-        }
-        free(msmtGroupData);
+        free(msmtGroupData);    // The index array and the data are in the same allocation
         *msmtGroupDataPtr = NULL;
     }
 }
@@ -995,7 +979,7 @@ void addId(s_MsmtGroupData** msmtGroupData, unsigned short id_index, unsigned lo
             NRF_LOG_DEBUG("Msmt index %d is invalid. Skipping", msmtIndex);
             return false;
         }
-        s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+        s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
         if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_NUMERIC)
         {
             NRF_LOG_DEBUG("Measurement is not a numeric. Skipping");
@@ -1105,7 +1089,7 @@ void addId(s_MsmtGroupData** msmtGroupData, unsigned short id_index, unsigned lo
         }
 
 
-        s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+        s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
         //bool isComplex = (sGhsMsmtIndex->msmtValueType == MSMT_VALUE_COMPOUND_COMPLEX);
         if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_COMPOUND_COMPLEX)
         {
@@ -1186,7 +1170,7 @@ bool updateDataCoded(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsign
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_CODED)
     {
         NRF_LOG_DEBUG("Measurement is not a coded enum. Skipping");
@@ -1240,7 +1224,7 @@ bool updateDataBits(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsigne
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_BITS)
     {
         NRF_LOG_DEBUG("Measurement is not a BITS enum. Skipping");
@@ -1323,7 +1307,7 @@ bool updateDataRtsa(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsigne
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_RTSA)
     {
         NRF_LOG_DEBUG("Measurement is not an RTSA. Skipping");
@@ -1383,7 +1367,7 @@ bool updateDataGhsMsmtSupplementalTypes(s_MsmtGroupData** msmtGroupDataPtr, unsi
     s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
     if (!checkMsmtGroupData(msmtGroupData)) return false;
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (suppType_index >= sGhsMsmtIndex->numberOfSuppTypes)
     {
         NRF_LOG_DEBUG("suppType_index exceeds number of supplemental types allocated.");
@@ -1441,7 +1425,7 @@ bool updateDataGhsMsmtRefs(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex,
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (ref_index >= sGhsMsmtIndex->numberRefs)
     {
         NRF_LOG_DEBUG("ref_index exceeds number of src handle refs allocated.");
@@ -1475,7 +1459,7 @@ bool updateDataGhsMsmtDuration(s_MsmtGroupData** msmtGroupDataPtr, short msmtInd
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->duration_index == 0)
     {
         NRF_LOG_DEBUG("Duration is not configured. Skipping.");
@@ -1497,7 +1481,7 @@ bool updateDataDropLastMsmt(s_MsmtGroupData** msmtGroupDataPtr)
     {
         no_of_msmts = no_of_msmts - 1;
         msmtGroupData->data[msmtGroupData->no_of_msmts_index] = (unsigned char)(no_of_msmts & 0xFF);
-        msmtGroupData->dataLength = msmtGroupData->dataLength - msmtGroupData->sGhsMsmtIndex[no_of_msmts]->msmt_length;
+        msmtGroupData->dataLength = msmtGroupData->dataLength - msmtGroupData->sGhsMsmtIndex[no_of_msmts].msmt_length;
         twoByteEncode(msmtGroupData->data, LENGTH_INDEX, (msmtGroupData->dataLength - 3));
         *msmtGroupDataPtr = msmtGroupData;
         return true;
@@ -1513,7 +1497,7 @@ bool updateDataRestoreLastMsmt(s_MsmtGroupData** msmtGroupDataPtr)
     unsigned short no_of_msmts = (unsigned short)msmtGroupData->data[msmtGroupData->no_of_msmts_index];
     if (no_of_msmts < msmtGroupData->currentGhsMsmtCount)
     {
-        msmtGroupData->dataLength = msmtGroupData->dataLength + msmtGroupData->sGhsMsmtIndex[no_of_msmts]->msmt_length;
+        msmtGroupData->dataLength = msmtGroupData->dataLength + msmtGroupData->sGhsMsmtIndex[no_of_msmts].msmt_length;
         no_of_msmts = no_of_msmts + 1;
         msmtGroupData->data[msmtGroupData->no_of_msmts_index] = (unsigned char)no_of_msmts;
         twoByteEncode(msmtGroupData->data, LENGTH_INDEX, (msmtGroupData->dataLength - 3));
@@ -1744,35 +1728,20 @@ bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *m
     }
     unsigned short groupLength = computeLengthOfMsmtGroup(msmtGroup);
 
-    unsigned char *msmtBuf = (unsigned char*)calloc(1, groupLength);
-    if (msmtBuf == NULL)
-    {
-        NRF_LOG_DEBUG("Could not allocate memory for group measurement buffer");
-        return false;
-    }
     s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
     if (msmtGroupData != NULL)
     {
         cleanUpMsmtGroupData(msmtGroupDataPtr);
     }
-    msmtGroupData = (s_MsmtGroupData *)calloc(1, sizeof(s_MsmtGroupData));
+    // One allocation holds the struct, then its sGhsMsmtIndex array, then the data buffer
+    msmtGroupData = (s_MsmtGroupData *)calloc(1, sizeof(s_MsmtGroupData) + msmtGroup->currentMsmtCount * sizeof(s_GhsMsmtIndex) + groupLength);
     if (msmtGroupData == NULL)
     {
         NRF_LOG_DEBUG("Could not allocate memory for group measurement data");
-        free(msmtBuf);
         return false;
     }
-    if (msmtGroup->currentMsmtCount > 0)
-    {
-        msmtGroupData->sGhsMsmtIndex = (s_GhsMsmtIndex**)calloc(1, msmtGroup->currentMsmtCount * sizeof(s_GhsMsmtIndex*));
-        if (msmtGroupData->sGhsMsmtIndex == NULL)
-        {
-            NRF_LOG_DEBUG("Could not allocate memory for group measurement index pointers");
-            free(msmtBuf);
-            free(msmtGroupData);
-            return false;
-        }
-    }
+    msmtGroupData->sGhsMsmtIndex = (s_GhsMsmtIndex *)(msmtGroupData + 1);
+    unsigned char *msmtBuf = (unsigned char *)(msmtGroupData->sGhsMsmtIndex + msmtGroup->currentMsmtCount);
     msmtGroupData->dataLength = (unsigned short)groupLength;
     msmtGroupData->currentGhsMsmtCount = msmtGroup->currentMsmtCount;
     
@@ -1865,14 +1834,7 @@ bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *m
     // ================================ Loop: over # of ghs msmts
     for (j = 0; j < msmtGroupData->currentGhsMsmtCount; j++)
     {
-        s_GhsMsmtIndex *sGhsMsmtIndex = (s_GhsMsmtIndex *)calloc(1, sizeof(s_GhsMsmtIndex));
-        if (sGhsMsmtIndex == NULL)
-        {
-            NRF_LOG_DEBUG("Could not allocate memory for group measurement index %d", j);
-            free(msmtBuf);
-            cleanUpMsmtGroupData(&msmtGroupData);
-            return false;
-        }
+        s_GhsMsmtIndex *sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[j];
         unsigned short ghsLength = 0;
         s_GhsMsmt* ghs = msmtGroup->ghsMsmts[j];
         // Need to set index of length location now as we don't know the length yet.
@@ -2049,7 +2011,6 @@ bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *m
             #endif
         }
         sGhsMsmtIndex->msmt_length = ghsLength;
-        msmtGroupData->sGhsMsmtIndex[j] = sGhsMsmtIndex;
         twoByteEncode(msmtBuf, lengthIndex, (ghsLength - 3));  // Don't need the updated lengthIndex in the return
     }
     msmtGroupData->data = msmtBuf;
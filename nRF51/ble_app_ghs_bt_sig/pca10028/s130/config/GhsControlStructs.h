@@ -510,7 +510,7 @@ typedef struct
     unsigned short ref_index;           // Location of the reference array
     unsigned short duration_index;      // Location of the duration
     unsigned short currentGhsMsmtCount; // The number of measurements currently in the group (this is used while creating the template and popping/pushing msmts in the group)
-    s_GhsMsmtIndex **sGhsMsmtIndex;     // the array of support info for each measurement entry
+    s_GhsMsmtIndex *sGhsMsmtIndex;      // the array of support info for each measurement entry. It and data are allocated with the struct
     unsigned char *data;                // the byte array to be sent to the PHG
 }s_MsmtGroupData;                       // Support information for using the measurement group data buffer for this measurement group
 
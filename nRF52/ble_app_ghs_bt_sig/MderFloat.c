@@ -514,3 +514,187 @@ bool getMderFloatFromString(s_MderFloat *mderFloat, char* floatAsString)
     }
     return false;
 }
+
+/*
+ * Batch conversions. These do the same as the single value methods above for whole arrays, as a gateway or host
+ * tool decoding stored data or RTSA samples needs. The loop bodies have no branches and no calls and work in int,
+ * so gcc and clang vectorize them at -O3 (SSE/AVX on a PC, NEON on ARMv7-A/ARMv8); on a Cortex-M4 they are simple
+ * loops. Selects on floating point values and if chains on one variable are avoided on purpose: the compiler keeps
+ * those as branches and then gives up on the loop. The sign extensions also work where long is 64 bits.
+ */
+#define SFLOAT_EXPONENT(raw) ((int)((((raw) >> 12) & 0x0F) ^ 0x08) - 0x08)
+#define SFLOAT_MANTISSA(raw) ((int)(((raw) & 0x0FFF) ^ 0x0800) - 0x0800)
+#define FLOAT_EXPONENT(raw) ((int)((((raw) >> 24) & 0xFF) ^ 0x80) - 0x80)
+#define FLOAT_MANTISSA(raw) ((int)(((raw) & 0x00FFFFFF) ^ 0x00800000) - 0x00800000)
+
+/* factor if the given bit of n is set, else 1 */
+static inline double powerOfTenFactor(int n, int bit, int factorMinusOne)
+{
+    return (double)(1 + ((0 - ((n >> bit) & 0x01)) & factorMinusOne));
+}
+
+/* 10 ** n for n from 0 to 255 by the bits of n rather than a table, so it vectorizes. Exact up to 22 */
+static inline double powerOfTen(int n)
+{
+    double e16 = powerOfTenFactor(n, 4, 99999999);
+    double e32 = powerOfTenFactor(n, 5, 99999999);
+    double e64 = powerOfTenFactor(n, 6, 99999999);
+    double e128 = powerOfTenFactor(n, 7, 99999999);
+    e16 = e16 * e16;
+    e32 = e32 * e32;
+    e32 = e32 * e32;
+    e64 = e64 * e64;
+    e64 = e64 * e64;
+    e64 = e64 * e64;
+    e128 = e128 * e128;
+    e128 = e128 * e128;
+    e128 = e128 * e128;
+    e128 = e128 * e128;
+    return powerOfTenFactor(n, 0, 9) * powerOfTenFactor(n, 1, 99) * powerOfTenFactor(n, 2, 9999)
+        * powerOfTenFactor(n, 3, 99999999) * e16 * e32 * e64 * e128;
+}
+
+/*
+ * mantissa * 10 ** exponent worked out as (mantissa * 10 ** exponent) / 1 or mantissa / 10 ** -exponent, so values like
+ * 0.1 are as close as a double gets. The special values fall out of the same division: +1 / 0 is INFINITY, -1 / 0 is
+ * -INFINITY and 0 / 0 is NAN, which is what NaN, NRes and reserved become.
+ */
+static inline double createDoubleFromParts(int exponent, int mantissa, int isSpecial, int isPinf, int isNinf)
+{
+    int negative = (exponent < 0);
+    double power = powerOfTen(negative ? -exponent : exponent);
+    double numerator = (double)((mantissa & (isSpecial - 1)) + isPinf - isNinf)
+        * (power * (double)(1 - negative) + (double)negative);
+    double denominator = (double)(1 - isSpecial) * (power * (double)negative + (double)(1 - negative));
+    return numerator / denominator;
+}
+
+bool createMderFloatArraysFromSFloats(const unsigned short *ieeeSFloats, short int *exponents, long int *mantissas,
+    enum MderSpecialValue *specialValues, unsigned long count)
+{
+    unsigned long i;
+    if (ieeeSFloats == NULL || exponents == NULL || mantissas == NULL || specialValues == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        int raw = ieeeSFloats[i];
+        int mant = (raw & 0x0FFF);
+        exponents[i] = (short int)SFLOAT_EXPONENT(raw);
+        mantissas[i] = SFLOAT_MANTISSA(raw);
+        specialValues[i] = (enum MderSpecialValue)(MDER_NUMBER
+            + (mant == 0x07FF) * (MDER_NAN - MDER_NUMBER)
+            + (mant == 0x07FE) * (MDER_PINF - MDER_NUMBER)
+            + (mant == 0x0802) * (MDER_NINF - MDER_NUMBER)
+            + (mant == 0x0801) * (MDER_NRES - MDER_NUMBER)
+            + (mant == 0x0800) * (MDER_RSVD - MDER_NUMBER));
+    }
+    return true;
+}
+
+bool createMderFloatArraysFromFloats(const unsigned long *ieeeFloats, short int *exponents, long int *mantissas,
+    enum MderSpecialValue *specialValues, unsigned long count)
+{
+    unsigned long i;
+    if (ieeeFloats == NULL || exponents == NULL || mantissas == NULL || specialValues == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        unsigned long raw = ieeeFloats[i];
+        int mant = (int)(raw & 0x00FFFFFF);
+        exponents[i] = (short int)FLOAT_EXPONENT(raw);
+        mantissas[i] = FLOAT_MANTISSA(raw);
+        specialValues[i] = (enum MderSpecialValue)(MDER_NUMBER
+            + (mant == 0x007FFFFF) * (MDER_NAN - MDER_NUMBER)
+            + (mant == 0x007FFFFE) * (MDER_PINF - MDER_NUMBER)
+            + (mant == 0x00800002) * (MDER_NINF - MDER_NUMBER)
+            + (mant == 0x00800001) * (MDER_NRES - MDER_NUMBER)
+            + (mant == 0x00800000) * (MDER_RSVD - MDER_NUMBER));
+    }
+    return true;
+}
+
+bool createIeeeSFloatsFromMderFloatArrays(const short int *exponents, const long int *mantissas,
+    const enum MderSpecialValue *specialValues, unsigned short *ieeeSFloats, unsigned long count)
+{
+    unsigned long i;
+    if (ieeeSFloats == NULL || exponents == NULL || mantissas == NULL || specialValues == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        int specialValue = specialValues[i];
+        unsigned int raw = (((unsigned int)exponents[i] << 12) & 0xF000) | ((unsigned int)mantissas[i] & 0x0FFF);
+        ieeeSFloats[i] = (unsigned short)(((0 - (unsigned int)(specialValue == MDER_NUMBER)) & raw)
+            | ((0 - (unsigned int)(specialValue == MDER_NAN)) & 0x07FF)
+            | ((0 - (unsigned int)(specialValue == MDER_PINF)) & 0x07FE)
+            | ((0 - (unsigned int)(specialValue == MDER_NINF)) & 0x0802)
+            | ((0 - (unsigned int)(specialValue == MDER_NRES)) & 0x0801)
+            | ((0 - (unsigned int)(specialValue == MDER_RSVD)) & 0x0800));
+    }
+    return true;
+}
+
+bool createIeeeFloatsFromMderFloatArrays(const short int *exponents, const long int *mantissas,
+    const enum MderSpecialValue *specialValues, unsigned long *ieeeFloats, unsigned long count)
+{
+    unsigned long i;
+    if (ieeeFloats == NULL || exponents == NULL || mantissas == NULL || specialValues == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        int specialValue = specialValues[i];
+        unsigned int raw = (((unsigned int)exponents[i] << 24) & 0xFF000000) | ((unsigned int)mantissas[i] & 0x00FFFFFF);
+        ieeeFloats[i] = ((0 - (unsigned int)(specialValue == MDER_NUMBER)) & raw)
+            | ((0 - (unsigned int)(specialValue == MDER_NAN)) & 0x007FFFFF)
+            | ((0 - (unsigned int)(specialValue == MDER_PINF)) & 0x007FFFFE)
+            | ((0 - (unsigned int)(specialValue == MDER_NINF)) & 0x00800002)
+            | ((0 - (unsigned int)(specialValue == MDER_NRES)) & 0x00800001)
+            | ((0 - (unsigned int)(specialValue == MDER_RSVD)) & 0x00800000);
+    }
+    return true;
+}
+
+bool createDoublesFromSFloats(const unsigned short *ieeeSFloats, double *values, unsigned long count)
+{
+    unsigned long i;
+    if (ieeeSFloats == NULL || values == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        int raw = ieeeSFloats[i];
+        int mant = (raw & 0x0FFF);
+        int isPinf = (mant == 0x07FE);
+        int isNinf = (mant == 0x0802);
+        int isSpecial = isPinf | isNinf | (mant == 0x07FF) | (mant == 0x0801) | (mant == 0x0800);
+        values[i] = createDoubleFromParts(SFLOAT_EXPONENT(raw), SFLOAT_MANTISSA(raw), isSpecial, isPinf, isNinf);
+    }
+    return true;
+}
+
+bool createDoublesFromFloats(const unsigned long *ieeeFloats, double *values, unsigned long count)
+{
+    unsigned long i;
+    if (ieeeFloats == NULL || values == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        unsigned long raw = ieeeFloats[i];
+        int mant = (int)(raw & 0x00FFFFFF);
+        int isPinf = (mant == 0x007FFFFE);
+        int isNinf = (mant == 0x00800002);
+        int isSpecial = isPinf | isNinf | (mant == 0x007FFFFF) | (mant == 0x00800001) | (mant == 0x00800000);
+        values[i] = createDoubleFromParts(FLOAT_EXPONENT(raw), FLOAT_MANTISSA(raw), isSpecial, isPinf, isNinf);
+    }
+    return true;
+}
@@ -30,6 +30,8 @@ DEALINGS IN THE SOFTWARE.
     #include <windows.h>
 #else
     #include "nrf_sdh.h"
+    #include "crc16.h"
+    #include "app_util.h"
     #include "handleSpecializations.h"
 #endif
 
@@ -697,16 +699,919 @@ ret_code_t createBatteryService(unsigned short int* serviceHandle, unsigned char
 extern unsigned short SPECIALIZATION;
 extern unsigned short numberOfStoredMsmtGroups;
 extern const char nameKey[10];
-extern s_MsmtData storedMsmts[];
 
-void saveKeysToFlash(ble_gap_sec_keyset_t* keys,
+/*
+ * Flash is written without disabling the SoftDevice. sd_flash_page_erase() and sd_flash_write() only
+ * schedule the operation between radio events and return; the result comes later as an
+ * NRF_EVT_FLASH_OPERATION_SUCCESS or _ERROR system event and only one operation can be outstanding.
+ * Operations are therefore queued here and run one after the other by runFlashOperations() from the
+ * main loop. flashSysEventHandler() only records the result, so the queue, the heap and the stored
+ * measurement log are never touched from interrupt context. The data of a write must stay put until
+ * the write completes; a write can own a heap buffer that is freed then.
+ */
+#define FLASH_OP_QUEUE_SIZE         8
+#define FLASH_OP_RETRIES            3   // The SoftDevice fails an operation if the radio leaves it no time slot
+
+typedef enum
+{
+    FLASH_OP_ERASE,
+    FLASH_OP_WRITE
+} e_FlashOpType;
+
+typedef struct
+{
+    e_FlashOpType type;
+    uint32_t page;                  // Erase: page to erase
+    uint32_t *addr;                 // Write: where the words go
+    uint32_t const *data;           // Write: words to write
+    uint32_t words;                 // Write: number of words
+    void *release;                  // Write: buffer to free when the write is done, or NULL
+    bool storedLog;                 // Operation of the current stored measurement log step
+} s_FlashOp;
+
+static s_FlashOp flashOps[FLASH_OP_QUEUE_SIZE];
+static unsigned short flashOpHead           = 0;    // Next free slot
+static unsigned short flashOpTail           = 0;    // Operation in progress or next to start
+static unsigned short flashOpRetries        = 0;
+static bool flashOpInProgress               = false;
+static volatile uint32_t flashOpResult      = 0;    // System event of the operation in progress, 0 until it arrives
+static bool storedLogStepFailed             = false;    // An operation of the current log step was given up on
+
+#if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+// Returns the page holding the bonding data. See saveKeysToFlash() for how it is found.
+static uint32_t getFlashDataPage(void)
+{
+    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
+    uint32_t pg_num  = NRF_FICR->CODESIZE - (NRF_FICR->CODESIZE * pg_size - 0xE0000) / pg_size;
+    return pg_num - 2;
+}
+#endif
+
+static unsigned short getFreeFlashOps(void)
+{
+    return (FLASH_OP_QUEUE_SIZE - 1) - (flashOpHead + FLASH_OP_QUEUE_SIZE - flashOpTail) % FLASH_OP_QUEUE_SIZE;
+}
+
+// The caller checks getFreeFlashOps() first so a sequence of operations is either queued whole or not at all
+static s_FlashOp *queueFlashOp(e_FlashOpType type, bool storedLog)
+{
+    s_FlashOp *op = &flashOps[flashOpHead];
+    memset(op, 0, sizeof(s_FlashOp));
+    op->type = type;
+    op->storedLog = storedLog;
+    flashOpHead = (flashOpHead + 1) % FLASH_OP_QUEUE_SIZE;
+    return op;
+}
+
+static void queueFlashErase(uint32_t page, bool storedLog)
+{
+    queueFlashOp(FLASH_OP_ERASE, storedLog)->page = page;
+}
+
+static void queueFlashWrite(uint32_t *addr, uint32_t const *data, uint32_t words, void *release, bool storedLog)
+{
+    s_FlashOp *op = queueFlashOp(FLASH_OP_WRITE, storedLog);
+    op->addr = addr;
+    op->data = data;
+    op->words = words;
+    op->release = release;
+}
+
+// Removes the finished (or abandoned) operation from the queue
+static void completeFlashOperation(bool failed)
+{
+    s_FlashOp *op = &flashOps[flashOpTail];
+
+    flashOpRetries = 0;
+    if (failed && op->storedLog)
+    {
+        storedLogStepFailed = true;
+    }
+    if (op->type == FLASH_OP_WRITE && op->release != NULL)
+    {
+        free(op->release);
+    }
+    flashOpTail = (flashOpTail + 1) % FLASH_OP_QUEUE_SIZE;
+}
+
+static void startFlashOperation(void)
+{
+    ret_code_t err_code;
+
+    while (!flashOpInProgress && flashOpTail != flashOpHead)
+    {
+        s_FlashOp *op = &flashOps[flashOpTail];
+        if (op->type == FLASH_OP_ERASE)
+        {
+            err_code = sd_flash_page_erase(op->page);
+        }
+        else
+        {
+            err_code = sd_flash_write(op->addr, op->data, op->words);
+        }
+        if (err_code == NRF_SUCCESS)
+        {
+            flashOpResult = 0;
+            flashOpInProgress = true;
+        }
+        else if (err_code == NRF_ERROR_BUSY)
+        {
+            break;  // Someone else's flash operation; tried again on the next pass of the main loop
+        }
+        else
+        {
+            NRF_LOG_ERROR("Flash operation %u could not be started. Error code %u", op->type, err_code);
+            completeFlashOperation(true);   // Drop it, there is no point in trying again
+        }
+    }
+}
+
+void flashSysEventHandler(uint32_t sys_evt)
+{
+    if (sys_evt == NRF_EVT_FLASH_OPERATION_SUCCESS || sys_evt == NRF_EVT_FLASH_OPERATION_ERROR)
+    {
+        flashOpResult = sys_evt;
+    }
+}
+
+bool isFlashIdle(void)
+{
+    return !flashOpInProgress && flashOpTail == flashOpHead;
+}
+
+/*
+ * Stored measurements live in flash, packed by packStoredMsmt(), in a ring of STORED_LOG_PAGES pages
+ * below the bonding data page. RAM only holds a 2-byte slot number per record (storedLogIndex[], oldest
+ * first) and a record is unpacked from flash when it is read. Each page starts with a page header whose
+ * sequence number is one more than that of the page before it in the ring. Records are appended to the
+ * head page and a new page is started when it is full. A page none of whose records are in the index any
+ * more is erased and leaves the ring at the tail. A new measurement waits in a small RAM buffer until it
+ * has been appended.
+ *
+ * Changes to the records already in flash (set time, leaving the current timeline) are kept as a fixup
+ * that is applied whenever a record is read, until a rewrite has copied every record, with the fixup
+ * applied, to the head. The pages left behind are then reclaimed. One page more than NUMBER_OF_STORED_MSMTS
+ * needs is kept so there is always room for the copy.
+ *
+ * When the log is full a new measurement replaces the oldest one, which only leaves the index; its page is
+ * reclaimed once none of its records are left. It is not tombstoned: loading keeps the newest
+ * NUMBER_OF_STORED_MSMTS records, so the evicted ones stay out after a restart as well.
+ *
+ * Deleting records takes them out of the index at once. Their slots are then tombstoned in the
+ * background by clearing the record state byte, so they stay deleted after a restart. Pages whose
+ * records are all gone are reclaimed as usual. If deletes leave the ring short of free pages while at
+ * least a page worth of slots is dead, a rewrite without a fixup compacts the log.
+ *
+ * The log work is done one step at a time from runFlashOperations() in the main loop: a page start, a
+ * record write, a tombstone or a page erase. The RAM state only changes once the step's flash
+ * operations succeeded.
+ */
+#define STORED_LOG_PAGE_SIZE            4096            // NRF_FICR->CODEPAGESIZE on the nRF52840
+#define STORED_LOG_PAGE_MAGIC           0x4C534847UL    // 'GHSL'
+#define STORED_LOG_FORMAT               4               // Format 1 kept a whole s_MsmtData per record; format 2 the absolute
+                                                        // epoch; format 3 one base for the current timeline
+#define STORED_LOG_RECORD_TAG           0xA5
+#define STORED_LOG_RECORD_LIVE          0xFF            // Record state byte as written
+#define STORED_LOG_RECORD_DELETED       0x00            // Record state byte once tombstoned
+#define STORED_LOG_RECORD_HEADER_SIZE   10              // Tag, state, crc16 of the rest and the 48-bit RTC ticks when stored
+#define STORED_LOG_RECORD_SIZE          ((STORED_LOG_RECORD_HEADER_SIZE + STORED_MSMT_PACKED_SIZE + 3) & ~3)
+#define STORED_LOG_RECORD_WORDS         (STORED_LOG_RECORD_SIZE >> 2)
+#define STORED_LOG_RECORDS_PER_PAGE     ((STORED_LOG_PAGE_SIZE - sizeof(s_StoredLogPageHeader)) / STORED_LOG_RECORD_SIZE)
+#define STORED_LOG_PAGES                ((NUMBER_OF_STORED_MSMTS + STORED_LOG_RECORDS_PER_PAGE - 1) / STORED_LOG_RECORDS_PER_PAGE + 1)
+#define STORED_LOG_SLOTS                (STORED_LOG_PAGES * STORED_LOG_RECORDS_PER_PAGE)
+#define STORED_LOG_PENDING              8               // New measurements that can wait to be appended
+#define STORED_LOG_TOMBSTONE_RANGES     4               // Deletes whose slots can wait to be tombstoned
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint16_t specialization;        // Records are only valid for the specialization and record size that wrote them
+    uint16_t recordSize;
+    uint16_t format;
+    uint16_t reserved;
+} s_StoredLogPageHeader;
+
+typedef enum
+{
+    STORED_LOG_STEP_NONE,
+    STORED_LOG_STEP_NEW_PAGE,
+    STORED_LOG_STEP_APPEND,
+    STORED_LOG_STEP_COPY,
+    STORED_LOG_STEP_RECLAIM,
+    STORED_LOG_STEP_TOMBSTONE
+} e_StoredLogStep;
+
+typedef struct
+{
+    uint16_t next;                  // Next slot to tombstone
+    uint16_t last;                  // Last slot to tombstone; the range runs round the ring in slot order
+} s_StoredLogRange;
+
+#if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+STATIC_ASSERT(STORED_LOG_PAGES <= STORED_LOG_RESERVED_PAGES);   // The log would run into the application image
+
+static uint16_t storedLogIndex[NUMBER_OF_STORED_MSMTS];     // Slot of each record in flash, oldest first
+static unsigned short msmtsInStoredLog              = 0;    // Entries in storedLogIndex; the pending msmts come after them
+static uint32_t storedLogPageSequence[STORED_LOG_PAGES];    // Sequence number of each ring page, 0 if not in the log
+static uint16_t storedLogPageLive[STORED_LOG_PAGES];        // Entries of storedLogIndex in each ring page
+static uint32_t storedLogFirstPage                  = 0;    // Flash page of ring page 0
+static uint32_t storedLogSequence                   = 0;    // Sequence number of the newest page ever started
+static unsigned short storedLogHead                 = 0;    // Ring page being appended to
+static unsigned short storedLogTail                 = 0;    // Oldest ring page in the log
+static unsigned short storedLogUsedPages            = 0;
+static unsigned short storedLogPosition             = 0;    // Next free record position in the head page
+
+static uint32_t storedLogPending[STORED_LOG_PENDING][STORED_LOG_RECORD_WORDS];  // Records not yet in flash
+static volatile unsigned short storedLogPendingHead = 0;    // Free running; only written by addStoredMsmt()
+static volatile unsigned short storedLogPendingTail = 0;    // Free running; only written from the main loop
+static volatile bool storedLogClear                 = false;    // clearStoredMsmts() was called
+static volatile unsigned short storedLogClearPending = 0;   // storedLogPendingHead when it was called
+static volatile unsigned long storedLogGeneration   = 0;    // Bumped when records leave the log and the indices after them move
+
+static bool storedLogRewriting                      = false;
+static unsigned short storedLogRewriteNext          = 0;    // Next record of storedLogIndex to copy
+static s_StoredMsmtFixup storedLogFixup;                    // Applied by the rewrite in progress
+static s_StoredMsmtFixup storedLogQueuedFixup;              // For all records in flash; waits for the next rewrite
+
+static e_StoredLogStep storedLogStep                = STORED_LOG_STEP_NONE;    // Step whose flash operations are queued
+static unsigned short storedLogStepPage             = 0;    // New page: the ring page started
+static uint16_t storedLogStepSlot                   = 0;    // Append and copy: the slot written
+static s_StoredLogPageHeader storedLogHeader;               // New page: the header written
+static uint32_t storedLogRecordBuffer[STORED_LOG_RECORD_WORDS];  // Copy: the record written
+static uint32_t storedLogTombstoneWord;                     // Tombstone: the first word of the record with its state cleared
+
+static s_StoredLogRange storedLogTombstones[STORED_LOG_TOMBSTONE_RANGES];
+static unsigned short storedLogTombstoneRanges      = 0;
+
+static uint8_t *getStoredLogSlotAddress(uint16_t slot)
+{
+    return (uint8_t *)(uintptr_t)((storedLogFirstPage + slot / STORED_LOG_RECORDS_PER_PAGE) * STORED_LOG_PAGE_SIZE
+        + sizeof(s_StoredLogPageHeader) + (slot % STORED_LOG_RECORDS_PER_PAGE) * STORED_LOG_RECORD_SIZE);
+}
+
+static unsigned long long getStoredLogRecordTicks(uint8_t *record)
+{
+    return getEpochFromBytes(&record[4]);
+}
+
+static void buildStoredLogRecord(uint32_t *record, s_MsmtData *msmt, unsigned long long ticks)
+{
+    uint8_t *bytes = (uint8_t *)record;
+    uint16_t crc;
+    int i;
+
+    memset(record, 0xFF, STORED_LOG_RECORD_SIZE);  // Padding stays erased
+    bytes[0] = STORED_LOG_RECORD_TAG;
+    bytes[1] = STORED_LOG_RECORD_LIVE;
+    for (i = 0; i < 6; i++)
+    {
+        bytes[4 + i] = (uint8_t)(ticks & 0xFF);
+        ticks = (ticks >> 8);
+    }
+    packStoredMsmt(msmt, &bytes[STORED_LOG_RECORD_HEADER_SIZE]);
+    crc = crc16_compute(&bytes[4], STORED_LOG_RECORD_SIZE - 4, NULL);
+    bytes[2] = (uint8_t)(crc & 0xFF);
+    bytes[3] = (uint8_t)(crc >> 8);
+}
+
+static bool isStoredLogRecordValid(uint8_t *record)
+{
+    if (record[0] != STORED_LOG_RECORD_TAG || record[1] != STORED_LOG_RECORD_LIVE)
+    {
+        return false;
+    }
+    uint16_t crc = crc16_compute(&record[4], STORED_LOG_RECORD_SIZE - 4, NULL);
+    return (crc == (record[2] | (record[3] << 8)));
+}
+
+// Queues the erase and header of the next ring page. False if every page is in use.
+static bool startStoredLogPage(void)
+{
+    if (storedLogUsedPages >= STORED_LOG_PAGES)
+    {
+        NRF_LOG_ERROR("Stored measurement log has no free page");
+        return false;
+    }
+    storedLogStepPage = (storedLogHead + 1) % STORED_LOG_PAGES;
+    storedLogHeader.magic = STORED_LOG_PAGE_MAGIC;
+    storedLogHeader.sequence = storedLogSequence + 1;
+    storedLogHeader.specialization = SPECIALIZATION;
+    storedLogHeader.recordSize = STORED_LOG_RECORD_SIZE;
+    storedLogHeader.format = STORED_LOG_FORMAT;
+    storedLogHeader.reserved = 0xFFFF;
+    queueFlashErase(storedLogFirstPage + storedLogStepPage, true);
+    queueFlashWrite((uint32_t *)(uintptr_t)((storedLogFirstPage + storedLogStepPage) * STORED_LOG_PAGE_SIZE),
+                    (uint32_t *)&storedLogHeader, sizeof(s_StoredLogPageHeader) >> 2, NULL, true);
+    storedLogStep = STORED_LOG_STEP_NEW_PAGE;
+    return true;
+}
+
+static bool isStoredLogHeadFull(void)
+{
+    return (storedLogUsedPages == 0 || storedLogPosition >= STORED_LOG_RECORDS_PER_PAGE);
+}
+
+static bool isPendingMsmtDeleted(unsigned short pending)
+{
+    return (((uint8_t *)storedLogPending[pending % STORED_LOG_PENDING])[1] == STORED_LOG_RECORD_DELETED);
+}
+
+static void addStoredLogTombstones(uint16_t first, uint16_t last)
+{
+    storedLogTombstones[storedLogTombstoneRanges].next = first;
+    storedLogTombstones[storedLogTombstoneRanges].last = last;
+    storedLogTombstoneRanges++;
+}
+
+// Queues the tombstone of the next live slot in the oldest delete range. False if there is none left
+static bool queueStoredLogTombstone(void)
+{
+    while (storedLogTombstoneRanges > 0)
+    {
+        s_StoredLogRange *range = &storedLogTombstones[0];
+        uint16_t slot = range->next;
+        uint8_t *record = getStoredLogSlotAddress(slot);
+        if (slot == range->last)
+        {
+            storedLogTombstoneRanges--;
+            memmove(&storedLogTombstones[0], &storedLogTombstones[1], storedLogTombstoneRanges * sizeof(s_StoredLogRange));
+        }
+        else
+        {
+            range->next = (slot + 1) % STORED_LOG_SLOTS;
+        }
+        // Skipped, failed and superseded slots in the range are tombstoned too if they still look live
+        if (record[0] == STORED_LOG_RECORD_TAG && record[1] == STORED_LOG_RECORD_LIVE)
+        {
+            storedLogTombstoneWord = *(uint32_t *)record & ~0x0000FF00UL;   // Flash bits can be cleared without an erase
+            queueFlashWrite((uint32_t *)record, &storedLogTombstoneWord, 1, NULL, true);
+            storedLogStep = STORED_LOG_STEP_TOMBSTONE;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drops the oldest record from the index of a full log to make room for a new one
+static void evictOldestStoredLogRecord(void)
+{
+    storedLogPageLive[storedLogIndex[0] / STORED_LOG_RECORDS_PER_PAGE]--;
+    memmove(&storedLogIndex[0], &storedLogIndex[1], (msmtsInStoredLog - 1) * sizeof(uint16_t));
+    msmtsInStoredLog--;
+    numberOfStoredMsmtGroups--;     // The new msmt was counted when it was added
+    storedLogGeneration++;
+}
+
+// True if the ring is about to run out of free pages while at least a page worth of its slots is dead
+static bool isStoredLogCompactionNeeded(void)
+{
+    if (storedLogUsedPages + 1 < STORED_LOG_PAGES)
+    {
+        return false;
+    }
+    unsigned long slots = (unsigned long)(storedLogUsedPages - 1) * STORED_LOG_RECORDS_PER_PAGE + storedLogPosition;
+    return (slots >= (unsigned long)msmtsInStoredLog + STORED_LOG_RECORDS_PER_PAGE);
+}
+
+// Updates the RAM state for the step whose flash operations have all completed
+static void commitStoredLogStep(void)
+{
+    switch (storedLogStep)
+    {
+        case STORED_LOG_STEP_NEW_PAGE:
+            storedLogPageSequence[storedLogStepPage] = storedLogHeader.sequence;
+            storedLogSequence = storedLogHeader.sequence;
+            if (storedLogUsedPages == 0)
+            {
+                storedLogTail = storedLogStepPage;
+            }
+            storedLogHead = storedLogStepPage;
+            storedLogUsedPages++;
+            storedLogPosition = 0;
+            break;
+
+        case STORED_LOG_STEP_APPEND:
+            if (isPendingMsmtDeleted(storedLogPendingTail))
+            {
+                addStoredLogTombstones(storedLogStepSlot, storedLogStepSlot);  // Deleted while it was being written
+            }
+            else
+            {
+                storedLogIndex[msmtsInStoredLog++] = storedLogStepSlot;
+                storedLogPageLive[storedLogHead]++;
+            }
+            storedLogPosition++;
+            storedLogPendingTail++;
+            break;
+
+        case STORED_LOG_STEP_COPY:
+            storedLogPageLive[storedLogIndex[storedLogRewriteNext] / STORED_LOG_RECORDS_PER_PAGE]--;
+            storedLogIndex[storedLogRewriteNext++] = storedLogStepSlot;
+            storedLogPageLive[storedLogHead]++;
+            storedLogPosition++;
+            break;
+
+        case STORED_LOG_STEP_TOMBSTONE:
+            break;
+
+        case STORED_LOG_STEP_RECLAIM:
+            storedLogPageSequence[storedLogTail] = 0;
+            storedLogUsedPages--;
+            storedLogTail = (storedLogTail + 1) % STORED_LOG_PAGES;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Called from runFlashOperations() when no flash operation is queued. Finishes the previous step and
+ * queues the next one: reclaiming the tail page comes first, then the rewrite, then appending.
+ */
+static void serviceStoredLog(void)
+{
+    unsigned short pending;
+    s_MsmtData msmt;
+
+    if (storedLogStep != STORED_LOG_STEP_NONE)
+    {
+        if (!storedLogStepFailed)
+        {
+            commitStoredLogStep();
+        }
+        else if (storedLogStep == STORED_LOG_STEP_APPEND || storedLogStep == STORED_LOG_STEP_COPY)
+        {
+            storedLogPosition++;    // The slot may be half written; skip it. Loading ignores it by its crc
+        }
+        else if (storedLogStep == STORED_LOG_STEP_TOMBSTONE)
+        {
+            NRF_LOG_ERROR("Deleted stored measurement could not be tombstoned; it returns after a restart");
+        }
+        storedLogStep = STORED_LOG_STEP_NONE;
+        storedLogStepFailed = false;
+    }
+    if (storedLogClear)
+    {
+        storedLogClear = false;
+        storedLogPendingTail = storedLogClearPending;
+        memset(storedLogPageLive, 0, sizeof(storedLogPageLive));
+        msmtsInStoredLog = 0;
+        if (storedLogRewriting && storedLogFixup.active)
+        {
+            storedMsmtFixupDone(&storedLogFixup);   // No records are left for it
+        }
+        if (storedLogQueuedFixup.active)
+        {
+            storedMsmtFixupDone(&storedLogQueuedFixup);
+        }
+        storedLogRewriting = false;
+        storedLogQueuedFixup.active = false;
+        storedLogTombstoneRanges = 0;   // The pages are erased anyway
+        NRF_LOG_DEBUG("Stored measurement log cleared; %u pages to erase", storedLogUsedPages);
+    }
+    while (storedLogPendingTail != storedLogPendingHead && isPendingMsmtDeleted(storedLogPendingTail))
+    {
+        storedLogPendingTail++;     // Deleted before it was appended
+    }
+    pending = (unsigned short)(storedLogPendingHead - storedLogPendingTail);
+
+    // Tombstones go first; a page must not be reclaimed and reused while a delete range still covers it
+    if (queueStoredLogTombstone())
+    {
+        return;
+    }
+
+    if (storedLogUsedPages > 0 && storedLogPageLive[storedLogTail] == 0 &&
+        (storedLogTail != storedLogHead || (msmtsInStoredLog == 0 && pending == 0)))
+    {
+        queueFlashErase(storedLogFirstPage + storedLogTail, true);
+        storedLogStep = STORED_LOG_STEP_RECLAIM;
+        return;
+    }
+
+    if (!storedLogRewriting && (storedLogQueuedFixup.active || isStoredLogCompactionNeeded()))
+    {
+        // Without a queued fixup the rewrite only compacts; the inactive fixup changes nothing
+        storedLogFixup = storedLogQueuedFixup;
+        storedLogQueuedFixup.active = false;
+        storedLogRewriting = true;
+        storedLogRewriteNext = 0;
+        NRF_LOG_INFO("Rewriting %u stored measurements%s", msmtsInStoredLog, storedLogFixup.active ? "" : " to compact the log");
+    }
+    if (storedLogRewriting)
+    {
+        if (storedLogRewriteNext < msmtsInStoredLog)
+        {
+            if (isStoredLogHeadFull())
+            {
+                startStoredLogPage();
+                return;
+            }
+            uint8_t *source = getStoredLogSlotAddress(storedLogIndex[storedLogRewriteNext]);
+            unpackStoredMsmt(&source[STORED_LOG_RECORD_HEADER_SIZE], &msmt);
+            applyStoredMsmtFixup(&msmt, &storedLogFixup);
+            buildStoredLogRecord(storedLogRecordBuffer, &msmt, getStoredLogRecordTicks(source));
+            storedLogStepSlot = storedLogHead * STORED_LOG_RECORDS_PER_PAGE + storedLogPosition;
+            queueFlashWrite((uint32_t *)getStoredLogSlotAddress(storedLogStepSlot), storedLogRecordBuffer,
+                            STORED_LOG_RECORD_WORDS, NULL, true);
+            storedLogStep = STORED_LOG_STEP_COPY;
+            return;
+        }
+        storedLogRewriting = false;
+        if (storedLogFixup.active)
+        {
+            storedMsmtFixupDone(&storedLogFixup);
+        }
+        NRF_LOG_INFO("Stored measurements rewritten");
+    }
+
+    // New msmts wait while a fixup is pending as it is for the records in flash only
+    if (pending > 0 && !storedLogRewriting && !storedLogQueuedFixup.active)
+    {
+        if (msmtsInStoredLog >= NUMBER_OF_STORED_MSMTS)
+        {
+            NRF_LOG_INFO("Stored measurement log full; oldest measurement dropped");
+            evictOldestStoredLogRecord();
+        }
+        if (isStoredLogHeadFull())
+        {
+            startStoredLogPage();
+            return;
+        }
+        storedLogStepSlot = storedLogHead * STORED_LOG_RECORDS_PER_PAGE + storedLogPosition;
+        queueFlashWrite((uint32_t *)getStoredLogSlotAddress(storedLogStepSlot),
+                        storedLogPending[storedLogPendingTail % STORED_LOG_PENDING], STORED_LOG_RECORD_WORDS, NULL, true);
+        storedLogStep = STORED_LOG_STEP_APPEND;
+    }
+}
+#endif
+
+void runFlashOperations(void)
+{
+    if (flashOpInProgress)
+    {
+        if (flashOpResult == 0)
+        {
+            return;
+        }
+        flashOpInProgress = false;
+        if (flashOpResult == NRF_EVT_FLASH_OPERATION_SUCCESS)
+        {
+            completeFlashOperation(false);
+        }
+        else if (++flashOpRetries > FLASH_OP_RETRIES)
+        {
+            NRF_LOG_ERROR("Flash operation %u failed %u times; dropped", flashOps[flashOpTail].type, flashOpRetries);
+            completeFlashOperation(true);
+        }
+    }
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        if (isFlashIdle())
+        {
+            serviceStoredLog();
+        }
+    #endif
+    startFlashOperation();
+}
+
+bool addStoredMsmt(s_MsmtData *msmt, unsigned long long ticks)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        unsigned short head = storedLogPendingHead;
+        s_MsmtData stored;
+        if ((unsigned short)(head - storedLogPendingTail) >= STORED_LOG_PENDING)
+        {
+            NRF_LOG_DEBUG("Stored measurement log busy; measurement not stored");
+            return false;
+        }
+        // Records hold the epoch relative to their timeline; records repacked later already are
+        stored = *msmt;
+        baseStoredMsmtTime(&stored);
+        buildStoredLogRecord(storedLogPending[head % STORED_LOG_PENDING], &stored, ticks);
+        __DMB();    // Record contents must be visible before the head moves
+        storedLogPendingHead = head + 1;
+        if (ticks > latestTimeStamp)
+        {
+            latestTimeStamp = ticks;
+        }
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+bool getStoredMsmt(unsigned short index, s_MsmtData *msmt)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        // Until the main loop has seen a clear, the records it removes are already gone for the reader
+        bool cleared = storedLogClear;
+        unsigned short inLog = cleared ? 0 : msmtsInStoredLog;
+        unsigned short firstPending = cleared ? storedLogClearPending : storedLogPendingTail;
+        if (index < inLog)
+        {
+            uint8_t *record = getStoredLogSlotAddress(storedLogIndex[index]);
+            unpackStoredMsmt(&record[STORED_LOG_RECORD_HEADER_SIZE], msmt);
+            if (storedLogRewriting && index >= storedLogRewriteNext)
+            {
+                applyStoredMsmtFixup(msmt, &storedLogFixup);
+            }
+            applyStoredMsmtFixup(msmt, &storedLogQueuedFixup);
+            resolveStoredMsmtTime(msmt);
+            return true;
+        }
+        index = index - inLog;
+        for (; firstPending != storedLogPendingHead; firstPending++)
+        {
+            if (isPendingMsmtDeleted(firstPending))
+            {
+                continue;
+            }
+            if (index == 0)
+            {
+                unpackStoredMsmt((uint8_t *)storedLogPending[firstPending % STORED_LOG_PENDING]
+                    + STORED_LOG_RECORD_HEADER_SIZE, msmt);
+                resolveStoredMsmtTime(msmt);
+                return true;
+            }
+            index--;
+        }
+    #endif
+    return false;
+}
+
+unsigned long getStoredMsmtGeneration(void)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        return storedLogGeneration;
+    #else
+        return 0;
+    #endif
+}
+
+bool getReferencedStoredMsmt(s_StoredMsmtReference *reference, s_MsmtData *msmt)
+{
+    if (reference->generation != getStoredMsmtGeneration())
+    {
+        NRF_LOG_ERROR("Stored measurement %u was queued before records were removed; dropped", reference->index);
+        return false;
+    }
+    if (!getStoredMsmt(reference->index, msmt))
+    {
+        NRF_LOG_DEBUG("Stored measurement %u could not be read", reference->index);
+        return false;
+    }
+    return true;
+}
+
+void clearStoredMsmts(void)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        storedLogClearPending = storedLogPendingHead;
+        storedLogClear = true;
+        storedLogGeneration++;
+    #endif
+}
+
+bool deleteStoredMsmts(unsigned short start, unsigned short count)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        unsigned short end = start + count;
+        unsigned short inLog = msmtsInStoredLog;
+        unsigned short i;
+
+        // A record being rewritten can have a valid copy in two slots, and only one would be tombstoned.
+        // One range is kept free for a pending msmt deleted while it is being appended.
+        if (storedLogClear || storedLogRewriting || storedLogQueuedFixup.active ||
+            storedLogTombstoneRanges >= STORED_LOG_TOMBSTONE_RANGES - 1)
+        {
+            NRF_LOG_DEBUG("Stored measurement log busy; delete refused");
+            return false;
+        }
+        if (start < inLog)
+        {
+            unsigned short last = (end < inLog) ? end : inLog;
+            addStoredLogTombstones(storedLogIndex[start], storedLogIndex[last - 1]);
+            for (i = start; i < last; i++)
+            {
+                storedLogPageLive[storedLogIndex[i] / STORED_LOG_RECORDS_PER_PAGE]--;
+            }
+            memmove(&storedLogIndex[start], &storedLogIndex[last], (inLog - last) * sizeof(uint16_t));
+            msmtsInStoredLog = inLog - (last - start);
+            count = count - (last - start);
+            start = inLog;
+        }
+        if (count > 0)
+        {
+            // Pending msmts are only marked; they are dropped instead of appended
+            unsigned short head = storedLogPendingHead;
+            unsigned short pending = storedLogPendingTail;
+            unsigned short index = inLog;
+            for (; pending != head && count > 0; pending++)
+            {
+                if (isPendingMsmtDeleted(pending))
+                {
+                    continue;
+                }
+                if (index >= start)
+                {
+                    ((uint8_t *)storedLogPending[pending % STORED_LOG_PENDING])[1] = STORED_LOG_RECORD_DELETED;
+                    count--;
+                }
+                index++;
+            }
+        }
+        storedLogGeneration++;
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+bool fixupStoredMsmts(s_StoredMsmtFixup *fixup)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        unsigned short head = storedLogPendingHead;
+        unsigned short i = storedLogPendingTail;
+        s_MsmtData msmt;
+
+        // The pending msmts are still in RAM and are fixed there, except one whose append is under way;
+        // like the records in flash it gets the fixup from storedLogQueuedFixup.
+        if (storedLogStep == STORED_LOG_STEP_APPEND)
+        {
+            i++;
+        }
+        for (; i != head; i++)
+        {
+            uint8_t *record = (uint8_t *)storedLogPending[i % STORED_LOG_PENDING];
+            unsigned long long ticks = getStoredLogRecordTicks(record);
+            uint8_t state = record[1];
+            unpackStoredMsmt(&record[STORED_LOG_RECORD_HEADER_SIZE], &msmt);
+            applyStoredMsmtFixup(&msmt, fixup);
+            buildStoredLogRecord(storedLogPending[i % STORED_LOG_PENDING], &msmt, ticks);
+            record[1] = state;
+        }
+        if (msmtsInStoredLog > 0 || storedLogStep == STORED_LOG_STEP_APPEND)
+        {
+            composeStoredMsmtFixup(&storedLogQueuedFixup, fixup);
+            return true;
+        }
+    #endif
+    return false;
+}
+
+void loadStoredMsmtsFromFlash(void)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        unsigned short page;
+        unsigned short position;
+        unsigned short i;
+        unsigned short count = 0;
+        unsigned long lastRecordNumber = 0;
+        bool reordered = false;
+        s_MsmtData msmt;
+
+        storedLogFirstPage = getFlashDataPage() - STORED_LOG_PAGES;
+        NRF_LOG_INFO("Stored measurement log: %u bytes per record, %u records per page, %u pages from page %u, capacity %u",
+            STORED_LOG_RECORD_SIZE, STORED_LOG_RECORDS_PER_PAGE, STORED_LOG_PAGES, storedLogFirstPage, NUMBER_OF_STORED_MSMTS);
+        if (NRF_FICR->CODEPAGESIZE != STORED_LOG_PAGE_SIZE)
+        {
+            NRF_LOG_ERROR("Flash page size %u is not the %u the stored measurement log is laid out for",
+                NRF_FICR->CODEPAGESIZE, STORED_LOG_PAGE_SIZE);
+        }
+        memset(storedLogPageSequence, 0, sizeof(storedLogPageSequence));
+        memset(storedLogPageLive, 0, sizeof(storedLogPageLive));
+        msmtsInStoredLog = 0;
+        storedLogUsedPages = 0;
+        storedLogSequence = 0;
+        storedLogRewriting = false;
+        storedLogQueuedFixup.active = false;
+        storedLogStep = STORED_LOG_STEP_NONE;
+        storedLogTombstoneRanges = 0;
+        for (page = 0; page < STORED_LOG_PAGES; page++)
+        {
+            s_StoredLogPageHeader *header = (s_StoredLogPageHeader *)(uintptr_t)((storedLogFirstPage + page) * STORED_LOG_PAGE_SIZE);
+            if (header->magic == STORED_LOG_PAGE_MAGIC && header->format == STORED_LOG_FORMAT &&
+                header->specialization == SPECIALIZATION && header->recordSize == STORED_LOG_RECORD_SIZE &&
+                header->sequence != 0xFFFFFFFF)
+            {
+                storedLogPageSequence[page] = header->sequence;
+                if (header->sequence > storedLogSequence)
+                {
+                    storedLogSequence = header->sequence;
+                    storedLogHead = page;
+                }
+            }
+        }
+        if (storedLogSequence == 0)
+        {
+            NRF_LOG_DEBUG("No stored measurement log in flash");
+            numberOfStoredMsmtGroups = 0;
+            return;
+        }
+        // Walk back from the head for as long as the sequence numbers run on; that is the log.
+        // Any other page is left over from before and is erased when it is next used.
+        storedLogTail = storedLogHead;
+        storedLogUsedPages = 1;
+        while (storedLogUsedPages < STORED_LOG_PAGES)
+        {
+            page = (storedLogTail + STORED_LOG_PAGES - 1) % STORED_LOG_PAGES;
+            if (storedLogPageSequence[page] == 0 || storedLogPageSequence[page] != storedLogPageSequence[storedLogTail] - 1)
+            {
+                break;
+            }
+            storedLogTail = page;
+            storedLogUsedPages++;
+        }
+        for (page = 0; page < STORED_LOG_PAGES; page++)
+        {
+            if ((page + STORED_LOG_PAGES - storedLogTail) % STORED_LOG_PAGES >= storedLogUsedPages)
+            {
+                storedLogPageSequence[page] = 0;
+            }
+        }
+        for (i = 0; i < storedLogUsedPages; i++)
+        {
+            page = (storedLogTail + i) % STORED_LOG_PAGES;
+            for (position = 0; position < STORED_LOG_RECORDS_PER_PAGE; position++)
+            {
+                uint16_t slot = page * STORED_LOG_RECORDS_PER_PAGE + position;
+                uint8_t *record = getStoredLogSlotAddress(slot);
+                if (record[0] == 0xFF)
+                {
+                    break;  // Erased flash; end of the page
+                }
+                if (!isStoredLogRecordValid(record))
+                {
+                    NRF_LOG_DEBUG("Skipping stored measurement log slot %u", slot);
+                    continue;
+                }
+                unpackStoredMsmt(&record[STORED_LOG_RECORD_HEADER_SIZE], &msmt);
+                if (getStoredLogRecordTicks(record) > latestTimeStamp)
+                {
+                    latestTimeStamp = getStoredLogRecordTicks(record);
+                }
+                if (count > 0 && msmt.common.recordNumber <= lastRecordNumber)
+                {
+                    // A copy made by a rewrite that was cut short. It replaces the older record.
+                    unsigned long recordNumber = msmt.common.recordNumber;
+                    unsigned short j = count;
+                    while (j > 0)
+                    {
+                        j--;
+                        unpackStoredMsmt(getStoredLogSlotAddress(storedLogIndex[j]) + STORED_LOG_RECORD_HEADER_SIZE, &msmt);
+                        if (msmt.common.recordNumber <= recordNumber)
+                        {
+                            break;
+                        }
+                    }
+                    if (msmt.common.recordNumber == recordNumber)
+                    {
+                        storedLogPageLive[storedLogIndex[j] / STORED_LOG_RECORDS_PER_PAGE]--;
+                        storedLogIndex[j] = slot;
+                        storedLogPageLive[page]++;
+                        reordered = true;
+                    }
+                    continue;
+                }
+                if (count >= NUMBER_OF_STORED_MSMTS)
+                {
+                    // Evicted when the log was full but its page not yet reclaimed; the newest records are kept
+                    storedLogPageLive[storedLogIndex[0] / STORED_LOG_RECORDS_PER_PAGE]--;
+                    memmove(&storedLogIndex[0], &storedLogIndex[1], (count - 1) * sizeof(uint16_t));
+                    count--;
+                }
+                storedLogIndex[count++] = slot;
+                storedLogPageLive[page]++;
+                lastRecordNumber = msmt.common.recordNumber;
+            }
+            storedLogPosition = position;   // Ends up as the first free position of the head page
+        }
+        msmtsInStoredLog = count;
+        numberOfStoredMsmtGroups = count + (unsigned short)(storedLogPendingHead - storedLogPendingTail);
+        if (count > 0)
+        {
+            recordNumber = lastRecordNumber + 1;
+        }
+        if (reordered)
+        {
+            // The index is no longer in slot order, which delete ranges rely on. Finish the rewrite
+            // without a fixup to put it back in order.
+            storedLogFixup.active = false;
+            storedLogRewriting = true;
+            storedLogRewriteNext = 0;
+        }
+        NRF_LOG_INFO("Stored measurement log has %u records in %u pages", count, storedLogUsedPages);
+    #endif
+}
+
+bool saveKeysToFlash(ble_gap_sec_keyset_t* keys,
     unsigned char **saveDataBuffer, unsigned short int *saveDataLength,
     unsigned char* cccdSet, unsigned short* noOfCccds)
 {
     int i;
     unsigned char *keysDataBuffer = NULL;
-    char *buffer = calloc(1, 256);
-    ret_code_t err_code;
 
     uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
     uint32_t pg_num  = NRF_FICR->CODESIZE - (NRF_FICR->CODESIZE * pg_size - 0xE0000) / pg_size;
@@ -735,14 +1640,16 @@ void saveKeysToFlash(ble_gap_sec_keyset_t* keys,
                sizeof(unsigned short) +
                sizeof(unsigned short) +
                sizeof(unsigned long long) +  // latest time count (for time line check)
-               #if (HEART_RATE == 1 || SPIROMETER == 1 || USES_STORED_DATA == 0)
-                   0;
-               #else
-                   (sizeof(s_MsmtData) * numberOfStoredMsmtGroups );
-               #endif
+               sizeof(s_RacpResume) +        // where an interrupted stored data transfer to the peer resumes
+               sizeof(s_StoredTimelines);    // the timelines the stored msmts are on
 
     // The writes are done in 4-byte hunks so we have to even out the length
     size = 4 + ((size >> 2) << 2);
+    if (getFreeFlashOps() < 2 * ((size + pg_size - 1) / pg_size))    // An erase and a write per page
+    {
+        NRF_LOG_DEBUG("Flash queue full; bonding data not saved yet");
+        return false;
+    }
     keysDataBuffer = calloc(1, size);
     
     // Now load all the data we want to save into this buffer
@@ -774,68 +1681,36 @@ void saveKeysToFlash(ble_gap_sec_keyset_t* keys,
     ptr = ptr + sizeof(unsigned short);
     memcpy(ptr, &latestTimeStamp, sizeof(unsigned long long));          // Load the latest time stamp for time line change check
     ptr = ptr + sizeof(unsigned long long);
-    #if(USES_STORED_DATA == 1)
-        if (numberOfStoredMsmtGroups > 0 && numberOfStoredMsmtGroups <= NUMBER_OF_STORED_MSMTS)
-        {
-            #if (HEART_RATE != 1 && SPIROMETER != 1)
-                memcpy(ptr, storedMsmts, sizeof(s_MsmtData) * numberOfStoredMsmtGroups); // Load the stored measurements
-            #endif
-        }
-    #endif
+    memcpy(ptr, &racpResume, sizeof(s_RacpResume));                     // Load the RACP resume cursor of the bonded peer
+    ptr = ptr + sizeof(s_RacpResume);
+    memcpy(ptr, &storedTimelines, sizeof(s_StoredTimelines));           // Load the timelines of the stored measurements
+    ptr = ptr + sizeof(s_StoredTimelines);
+    // The stored measurements themselves are in the stored measurement log; see loadStoredMsmtsFromFlash()
     
     // Now we have to write the data in hunks into flash
-    // Each page is 1024 bytes, and a write is in 4-byte hunks
-    // So we will find the number of 1024 byte pages to write,
-    // and then the number of 4-byte hunks left over.
-
-    // Disable soft device so we don't have to deal with events
-    //sd_softdevice_disable();
-    nrf_sdh_disable_request();
-    
-    // Buffer to write to flash. Need to write it in four-byte hunks
+    // Each page is erased and then written with up to a page worth of 4-byte hunks.
+    // The SoftDevice stays enabled; the erases and writes are queued and done between
+    // radio events. The buffer is freed when the last write is done.
     uint32_t *ptr32 = (uint32_t *)keysDataBuffer;
     while (true)
     {
         // Where to write
-        addr = (uint32_t *)(pg_size * pg_num);
-        // Erase page:
-        while(true)
-        {
-            err_code = sd_flash_page_erase(pg_num);
-            if (err_code == NRF_SUCCESS)
-            {
-                break;
-            }
-            if (err_code != NRF_ERROR_BUSY)
-            {
-                NRF_LOG_DEBUG("Erasing data returned error %u.", err_code);
-                APP_ERROR_CHECK(err_code);
-            }
-        }
+        addr = (uint32_t *)(uintptr_t)(pg_size * pg_num);
+        queueFlashErase(pg_num, false);
         i = (size >= pg_size) ? (pg_size >> 2) : (size >> 2);     // four-byte hunks to write; size is evenly divisible by four
-        while(true)
-        {
-            err_code = sd_flash_write(addr, ptr32, i);
-            if (err_code == NRF_SUCCESS)
-            {
-                break;
-            }
-            if (err_code != NRF_ERROR_BUSY)
-            {
-                NRF_LOG_DEBUG("Writing data returned error %u.", err_code);
-                APP_ERROR_CHECK(err_code);
-            }
-        }
         size = size - pg_size;  // Subtract a page size from the total size
-        if (size <= 0)          // if zero or less, all data has been written
+        if (size <= 0)          // if zero or less, this is the last write
         {
+            queueFlashWrite(addr, ptr32, i, keysDataBuffer, false);
             break;
         }
+        queueFlashWrite(addr, ptr32, i, NULL, false);
         pg_num++;
-        ptr32 = (uint32_t *)(keysDataBuffer + pg_size);
+        ptr32 = ptr32 + (pg_size >> 2);
     }
-    free(keysDataBuffer);
-    NRF_LOG_DEBUG("Flash written");
+    startFlashOperation();
+    NRF_LOG_DEBUG("Flash write queued");
+    return true;
 }
 
 void loadKeysFromFlash(ble_gap_sec_keyset_t* keys,
@@ -856,7 +1731,7 @@ void loadKeysFromFlash(ble_gap_sec_keyset_t* keys,
 
     NRF_LOG_INFO("Total pages is %u, pg_num is %u pg_size is %u", NRF_FICR->CODESIZE, pg_num, NRF_FICR->CODEPAGESIZE);
     pg_num = pg_num - 2;
-    uint8_t *addr = (uint8_t *)(pg_size * pg_num);
+    uint8_t *addr = (uint8_t *)(uintptr_t)(pg_size * pg_num);
 
     memcpy(localNameKey, addr, sizeof(localNameKey));
     if (memcmp(localNameKey, nameKey, sizeof(nameKey)) != 0)
@@ -892,14 +1767,23 @@ void loadKeysFromFlash(ble_gap_sec_keyset_t* keys,
         addr = addr + sizeof(unsigned short);
         memcpy(&latestTimeStamp, addr, sizeof(unsigned long long));
         addr = addr + sizeof(unsigned long long);
-        #if(USES_STORED_DATA == 1)
-            if (numberOfStoredMsmtGroups > 0 && numberOfStoredMsmtGroups <= NUMBER_OF_STORED_MSMTS)
-            {
-                #if (HEART_RATE != 1 && SPIROMETER != 1)
-                    memcpy(storedMsmts, addr, numberOfStoredMsmtGroups * sizeof(s_MsmtData));// Load the stored measurements
-                #endif
-            }
-        #endif
+        memcpy(&racpResume, addr, sizeof(s_RacpResume));
+        addr = addr + sizeof(s_RacpResume);
+        unsigned long magic;
+        memcpy(&magic, addr, sizeof(unsigned long));
+        if (magic == STORED_TIMELINES_MAGIC)    // Otherwise written before there was a table; the default one stays
+        {
+            memcpy(&storedTimelines, addr, sizeof(s_StoredTimelines));
+        }
+        addr = addr + sizeof(s_StoredTimelines);
+        if (racpResume.magic != RACP_RESUME_MAGIC)  // Written before there was a cursor, or none was pending
+        {
+            memset(&racpResume, 0, sizeof(s_RacpResume));
+        }
+        else
+        {
+            NRF_LOG_INFO("Stored data transfer can resume after record number %u", racpResume.lastRecordNumber);
+        }
     }
 }
 
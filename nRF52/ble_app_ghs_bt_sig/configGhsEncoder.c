@@ -31,6 +31,8 @@ DEALINGS IN THE SOFTWARE.
 
 #ifdef _WIN32
     #define NRF_LOG_DEBUG printf
+    #define NRF_LOG_RAW_INFO printf
+    #define NRF_LOG_FLUSH()
     #include <windows.h>
 #else
     #include "nrf_log.h"
@@ -664,21 +666,18 @@ void cleanUpMsmtGroupData(s_MsmtGroupData** msmtGroupDataPtr)
     s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
     if (msmtGroupData != NULL)
     {
-        if (msmtGroupData->sGhsMsmtIndex != NULL)
+        if (msmtGroupData->isStatic)
         {
-            int i;
-            for (i = 0; i < msmtGroupData->currentGhsMsmtCount; i++)
-            {
-                if (msmtGroupData->sGhsMsmtIndex[i] != NULL)
-                {
-                    free(msmtGroupData->sGhsMsmtIndex[i]);
-                }
-            }
-            free(msmtGroupData->sGhsMsmtIndex);
+            *msmtGroupDataPtr = NULL;   // An s_MsmtGroupDataStorage; there is nothing to free
+            return;
         }
         if (msmtGroupData->data != NULL)
         {
-            free(msmtGroupData->data);
+            free(msmtGroupData->data - SEGMENT_HEADROOM);
+        }
+        if (msmtGroupData->altData != NULL)
+        {
+            free(msmtGroupData->altData - SEGMENT_HEADROOM);
         }
         free(msmtGroupData);
         *msmtGroupDataPtr = NULL;
@@ -996,7 +995,7 @@ void addId(s_MsmtGroupData** msmtGroupData, unsigned short id_index, unsigned lo
             NRF_LOG_DEBUG("Msmt index %d is invalid. Skipping", msmtIndex);
             return false;
         }
-        s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+        s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
         if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_NUMERIC)
         {
             NRF_LOG_DEBUG("Measurement is not a numeric. Skipping");
@@ -1018,6 +1017,41 @@ void addId(s_MsmtGroupData** msmtGroupData, unsigned short id_index, unsigned lo
         }
         return true;
     }
+
+    static s_GhsMsmtIndex* getNumericMsmtIndex(s_MsmtGroupData* msmtGroupData, short msmtIndex, bool isSfloat)
+    {
+        if (!checkMsmtGroupData(msmtGroupData)) return NULL;
+        if (!((msmtIndex >= 0) && (msmtIndex < msmtGroupData->currentGhsMsmtCount)))
+        {
+            NRF_LOG_DEBUG("Msmt index %d is invalid. Skipping", msmtIndex);
+            return NULL;
+        }
+        s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
+        if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_NUMERIC || sGhsMsmtIndex->isSfloat != isSfloat)
+        {
+            NRF_LOG_DEBUG("Measurement is not a numeric using %s. Skipping", isSfloat ? "SFLOAT" : "FLOAT");
+            return NULL;
+        }
+        return sGhsMsmtIndex;
+    }
+
+    bool updateDataNumericFloat(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsigned long ieeeFloat, unsigned long msmt_id)
+    {
+        s_GhsMsmtIndex* sGhsMsmtIndex = getNumericMsmtIndex(*msmtGroupDataPtr, msmtIndex, false);
+        if (sGhsMsmtIndex == NULL) return false;
+        addId(msmtGroupDataPtr, sGhsMsmtIndex->id_index, msmt_id);
+        fourByteEncode((*msmtGroupDataPtr)->data, sGhsMsmtIndex->value_index, ieeeFloat);
+        return true;
+    }
+
+    bool updateDataNumericSFloat(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsigned short ieeeSFloat, unsigned long msmt_id)
+    {
+        s_GhsMsmtIndex* sGhsMsmtIndex = getNumericMsmtIndex(*msmtGroupDataPtr, msmtIndex, true);
+        if (sGhsMsmtIndex == NULL) return false;
+        addId(msmtGroupDataPtr, sGhsMsmtIndex->id_index, msmt_id);
+        twoByteEncode((*msmtGroupDataPtr)->data, sGhsMsmtIndex->value_index, ieeeSFloat);
+        return true;
+    }
 #endif
 #if (USES_COMPOUND == 1)
     static bool createCompoundMsmt(s_GhsMsmt** ghsMsmtPtr, unsigned long type, bool isSfloat, unsigned short units, unsigned short numberOfComponents, s_Compound *compounds,
@@ -1106,7 +1140,7 @@ void addId(s_MsmtGroupData** msmtGroupData, unsigned short id_index, unsigned lo
         }
 
 
-        s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+        s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
         //bool isComplex = (sGhsMsmtIndex->msmtValueType == MSMT_VALUE_COMPOUND_COMPLEX);
         if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_COMPOUND_COMPLEX)
         {
@@ -1137,12 +1171,6 @@ void addId(s_MsmtGroupData** msmtGroupData, unsigned short id_index, unsigned lo
         return true;
     }
 
-    static bool createCompoundNumericMsmt(s_GhsMsmt** ghsMsmtPtr, unsigned long type, bool isSfloat, unsigned short units, 
-        unsigned short numberOfComponents, s_Compound *compounds, bool hasMsmtId)
-    {
-        return createCompoundMsmt(ghsMsmtPtr, type, isSfloat, units, numberOfComponents, compounds, false, hasMsmtId);
-    }
-
     bool createComplexCompoundNumericMsmt(s_GhsMsmt** ghsMsmtPtr, unsigned long type, bool isSfloat, 
         unsigned short numberOfComponents, s_Compound *compounds, bool hasMsmtId)
     {
@@ -1187,7 +1215,7 @@ bool updateDataCoded(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsign
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_CODED)
     {
         NRF_LOG_DEBUG("Measurement is not a coded enum. Skipping");
@@ -1241,7 +1269,7 @@ bool updateDataBits(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsigne
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_BITS)
     {
         NRF_LOG_DEBUG("Measurement is not a BITS enum. Skipping");
@@ -1324,7 +1352,7 @@ bool updateDataRtsa(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex, unsigne
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_RTSA)
     {
         NRF_LOG_DEBUG("Measurement is not an RTSA. Skipping");
@@ -1384,7 +1412,7 @@ bool updateDataGhsMsmtSupplementalTypes(s_MsmtGroupData** msmtGroupDataPtr, unsi
     s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
     if (!checkMsmtGroupData(msmtGroupData)) return false;
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (suppType_index >= sGhsMsmtIndex->numberOfSuppTypes)
     {
         NRF_LOG_DEBUG("suppType_index exceeds number of supplemental types allocated.");
@@ -1442,7 +1470,7 @@ bool updateDataGhsMsmtRefs(s_MsmtGroupData** msmtGroupDataPtr, short msmtIndex,
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (ref_index >= sGhsMsmtIndex->numberRefs)
     {
         NRF_LOG_DEBUG("ref_index exceeds number of src handle refs allocated.");
@@ -1476,7 +1504,7 @@ bool updateDataGhsMsmtDuration(s_MsmtGroupData** msmtGroupDataPtr, short msmtInd
         return false;
     }
 
-    s_GhsMsmtIndex* sGhsMsmtIndex = msmtGroupData->sGhsMsmtIndex[msmtIndex];
+    s_GhsMsmtIndex* sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[msmtIndex];
     if (sGhsMsmtIndex->duration_index == 0)
     {
         NRF_LOG_DEBUG("Duration is not configured. Skipping.");
@@ -1498,7 +1526,7 @@ bool updateDataDropLastMsmt(s_MsmtGroupData** msmtGroupDataPtr)
     {
         no_of_msmts = no_of_msmts - 1;
         msmtGroupData->data[msmtGroupData->no_of_msmts_index] = (unsigned char)(no_of_msmts & 0xFF);
-        msmtGroupData->dataLength = msmtGroupData->dataLength - msmtGroupData->sGhsMsmtIndex[no_of_msmts]->msmt_length;
+        msmtGroupData->dataLength = msmtGroupData->dataLength - msmtGroupData->sGhsMsmtIndex[no_of_msmts].msmt_length;
         twoByteEncode(msmtGroupData->data, LENGTH_INDEX, (msmtGroupData->dataLength - 3));
         *msmtGroupDataPtr = msmtGroupData;
         return true;
@@ -1514,7 +1542,7 @@ bool updateDataRestoreLastMsmt(s_MsmtGroupData** msmtGroupDataPtr)
     unsigned short no_of_msmts = (unsigned short)msmtGroupData->data[msmtGroupData->no_of_msmts_index];
     if (no_of_msmts < msmtGroupData->currentGhsMsmtCount)
     {
-        msmtGroupData->dataLength = msmtGroupData->dataLength + msmtGroupData->sGhsMsmtIndex[no_of_msmts]->msmt_length;
+        msmtGroupData->dataLength = msmtGroupData->dataLength + msmtGroupData->sGhsMsmtIndex[no_of_msmts].msmt_length;
         no_of_msmts = no_of_msmts + 1;
         msmtGroupData->data[msmtGroupData->no_of_msmts_index] = (unsigned char)no_of_msmts;
         twoByteEncode(msmtGroupData->data, LENGTH_INDEX, (msmtGroupData->dataLength - 3));
@@ -1736,6 +1764,18 @@ static unsigned short computeLengthOfMsmtGroup(s_MsmtGroup *msmtGroup)
     return groupLength;
 }
 
+// Allocates the s_MsmtGroupData with its sGhsMsmtIndex array right behind it so the group takes one allocation and
+// cleanUpMsmtGroupData() frees both with the one free().
+static s_MsmtGroupData* allocMsmtGroupData(unsigned short numberOfGhsMsmts)
+{
+    s_MsmtGroupData* msmtGroupData = (s_MsmtGroupData *)calloc(1, sizeof(s_MsmtGroupData) + numberOfGhsMsmts * sizeof(s_GhsMsmtIndex));
+    if (msmtGroupData != NULL && numberOfGhsMsmts > 0)
+    {
+        msmtGroupData->sGhsMsmtIndex = (s_GhsMsmtIndex *)(msmtGroupData + 1);
+    }
+    return msmtGroupData;
+}
+
 bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *msmtGroup, s_GhsTime *sGhsTime)
 {
     if (msmtGroup == NULL)
@@ -1745,36 +1785,29 @@ bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *m
     }
     unsigned short groupLength = computeLengthOfMsmtGroup(msmtGroup);
 
-    unsigned char *msmtBuf = (unsigned char*)calloc(1, groupLength);
+    // The buffer starts with headroom for the segmentation header and record number so the fragmenter
+    // can write them in place in front of each fragment
+    unsigned char *msmtBuf = (unsigned char*)calloc(1, SEGMENT_HEADROOM + groupLength);
     if (msmtBuf == NULL)
     {
         NRF_LOG_DEBUG("Could not allocate memory for group measurement buffer");
         return false;
     }
+    msmtBuf = msmtBuf + SEGMENT_HEADROOM;
     s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
     if (msmtGroupData != NULL)
     {
         cleanUpMsmtGroupData(msmtGroupDataPtr);
     }
-    msmtGroupData = (s_MsmtGroupData *)calloc(1, sizeof(s_MsmtGroupData));
+    msmtGroupData = allocMsmtGroupData(msmtGroup->currentMsmtCount);
     if (msmtGroupData == NULL)
     {
         NRF_LOG_DEBUG("Could not allocate memory for group measurement data");
-        free(msmtBuf);
+        free(msmtBuf - SEGMENT_HEADROOM);
         return false;
     }
-    if (msmtGroup->currentMsmtCount > 0)
-    {
-        msmtGroupData->sGhsMsmtIndex = (s_GhsMsmtIndex**)calloc(1, msmtGroup->currentMsmtCount * sizeof(s_GhsMsmtIndex*));
-        if (msmtGroupData->sGhsMsmtIndex == NULL)
-        {
-            NRF_LOG_DEBUG("Could not allocate memory for group measurement index pointers");
-            free(msmtBuf);
-            free(msmtGroupData);
-            return false;
-        }
-    }
     msmtGroupData->dataLength = (unsigned short)groupLength;
+    msmtGroupData->bufferLength = (unsigned short)groupLength;
     msmtGroupData->currentGhsMsmtCount = msmtGroup->currentMsmtCount;
     
     unsigned short index = 0;
@@ -1866,14 +1899,7 @@ bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *m
     // ================================ Loop: over # of ghs msmts
     for (j = 0; j < msmtGroupData->currentGhsMsmtCount; j++)
     {
-        s_GhsMsmtIndex *sGhsMsmtIndex = (s_GhsMsmtIndex *)calloc(1, sizeof(s_GhsMsmtIndex));
-        if (sGhsMsmtIndex == NULL)
-        {
-            NRF_LOG_DEBUG("Could not allocate memory for group measurement index %d", j);
-            free(msmtBuf);
-            cleanUpMsmtGroupData(&msmtGroupData);
-            return false;
-        }
+        s_GhsMsmtIndex *sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[j];
         unsigned short ghsLength = 0;
         s_GhsMsmt* ghs = msmtGroup->ghsMsmts[j];
         // Need to set index of length location now as we don't know the length yet.
@@ -2050,10 +2076,382 @@ bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *m
             #endif
         }
         sGhsMsmtIndex->msmt_length = ghsLength;
-        msmtGroupData->sGhsMsmtIndex[j] = sGhsMsmtIndex;
         twoByteEncode(msmtBuf, lengthIndex, (ghsLength - 3));  // Don't need the updated lengthIndex in the return
     }
     msmtGroupData->data = msmtBuf;
     *msmtGroupDataPtr = msmtGroupData;
     return true;
 }
+
+bool createDoubleBufferedMsmtGroupDataArray(s_MsmtGroupData** msmtGroupDataPtr, s_MsmtGroup *msmtGroup, s_GhsTime *sGhsTime)
+{
+    if (!createMsmtGroupDataArray(msmtGroupDataPtr, msmtGroup, sGhsTime))
+    {
+        return false;
+    }
+    s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
+    unsigned char *altBuf = (unsigned char*)calloc(1, SEGMENT_HEADROOM + msmtGroupData->bufferLength);
+    if (altBuf == NULL)
+    {
+        NRF_LOG_DEBUG("Could not allocate memory for the second group measurement buffer");
+        cleanUpMsmtGroupData(msmtGroupDataPtr);
+        return false;
+    }
+    msmtGroupData->altData = altBuf + SEGMENT_HEADROOM;
+    memcpy(msmtGroupData->altData, msmtGroupData->data, msmtGroupData->bufferLength);
+    return true;
+}
+
+bool swapMsmtGroupDataBuffers(s_MsmtGroupData** msmtGroupDataPtr)
+{
+    s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
+    if (!checkMsmtGroupData(msmtGroupData)) return false;
+    if (msmtGroupData->altData == NULL)
+    {
+        return false;
+    }
+    // The buffer just filled becomes the one being sent. The other one takes over its contents so the
+    // template state (dropped msmts, refs, ids) carries over to the next update.
+    unsigned char *filled = msmtGroupData->data;
+    memcpy(msmtGroupData->altData, filled, msmtGroupData->bufferLength);
+    msmtGroupData->data = msmtGroupData->altData;
+    msmtGroupData->altData = filled;
+    *msmtGroupDataPtr = msmtGroupData;
+    return true;
+}
+
+bool createMsmtGroupDataArrayFromTemplate(s_MsmtGroupData** msmtGroupDataPtr, const s_MsmtGroupTemplate *msmtGroupTemplate,
+    s_GhsTime *sGhsTime, s_MsmtGroupDataStorage *storage)
+{
+    if (msmtGroupTemplate == NULL || storage == NULL)
+    {
+        NRF_LOG_DEBUG("MsmtGroup template or storage not given.");
+        return false;
+    }
+    if (msmtGroupTemplate->dataLength > storage->bufferLength || msmtGroupTemplate->numberOfGhsMsmts > storage->numberOfGhsMsmts
+        || storage->numberOfBuffers == 0)
+    {
+        NRF_LOG_DEBUG("The storage is smaller than the template. Declare it with MSMT_GROUP_DATA_STORAGE().");
+        return false;
+    }
+    if (*msmtGroupDataPtr != NULL)
+    {
+        cleanUpMsmtGroupData(msmtGroupDataPtr);
+    }
+    s_MsmtGroupData* msmtGroupData = storage->msmtGroupData;
+    memset(msmtGroupData, 0, sizeof(s_MsmtGroupData));
+    msmtGroupData->isStatic = true;
+    msmtGroupData->sGhsMsmtIndex = storage->sGhsMsmtIndex;
+    msmtGroupData->dataLength = msmtGroupTemplate->dataLength;
+    msmtGroupData->bufferLength = msmtGroupTemplate->dataLength;
+    msmtGroupData->timestamp_index = msmtGroupTemplate->timestamp_index;
+    msmtGroupData->no_of_msmts_index = msmtGroupTemplate->no_of_msmts_index;
+    msmtGroupData->numberOfSuppTypes = msmtGroupTemplate->numberOfSuppTypes;
+    msmtGroupData->suppTypes_index = msmtGroupTemplate->suppTypes_index;
+    msmtGroupData->numberRefs = msmtGroupTemplate->numberRefs;
+    msmtGroupData->ref_index = msmtGroupTemplate->ref_index;
+    msmtGroupData->duration_index = msmtGroupTemplate->duration_index;
+
+    // Each buffer starts with headroom for the segmentation header and record number, as in createMsmtGroupDataArray()
+    memset(storage->buffers, 0, storage->numberOfBuffers * (SEGMENT_HEADROOM + storage->bufferLength));
+    msmtGroupData->data = storage->buffers + SEGMENT_HEADROOM;
+    memcpy(msmtGroupData->data, msmtGroupTemplate->data, msmtGroupTemplate->dataLength);
+    msmtGroupData->currentGhsMsmtCount = msmtGroupTemplate->numberOfGhsMsmts;
+    memcpy(msmtGroupData->sGhsMsmtIndex, msmtGroupTemplate->sGhsMsmtIndex, msmtGroupTemplate->numberOfGhsMsmts * sizeof(s_GhsMsmtIndex));
+    if (msmtGroupData->timestamp_index != 0 && sGhsTime != NULL)
+    {
+        unsigned char *timeStamp = &msmtGroupData->data[msmtGroupData->timestamp_index];
+        timeStamp[GHS_TIME_INDEX_FLAGS] = (sGhsTime->clockResolution | sGhsTime->clockType | sGhsTime->flagKnownTimeline);
+        timeStamp[GHS_TIME_INDEX_OFFSET] = (sGhsTime->offsetShift & 0xFF);
+        timeStamp[GHS_TIME_INDEX_TIME_SYNC] = sGhsTime->timeSync;
+    }
+    if (storage->numberOfBuffers > 1)
+    {
+        msmtGroupData->altData = msmtGroupData->data + storage->bufferLength + SEGMENT_HEADROOM;
+        memcpy(msmtGroupData->altData, msmtGroupData->data, msmtGroupData->bufferLength);
+    }
+    *msmtGroupDataPtr = msmtGroupData;
+    return true;
+}
+
+short getMsmtIndexOfType(s_MsmtGroupData* msmtGroupData, unsigned long type)
+{
+    short i;
+    if (!checkMsmtGroupData(msmtGroupData)) return -1;
+    unsigned short index = msmtGroupData->no_of_msmts_index + 1;   // The first msmt follows the number of msmts
+    for (i = 0; i < msmtGroupData->currentGhsMsmtCount; i++)
+    {
+        // |msmt value type|length|flags|type| so the type is five bytes in
+        const unsigned char *typeBytes = &msmtGroupData->data[index + 5];
+        unsigned long msmtType = typeBytes[0] | (typeBytes[1] << 8) | ((unsigned long)typeBytes[2] << 16) | ((unsigned long)typeBytes[3] << 24);
+        if (msmtType == type)
+        {
+            return i;
+        }
+        index = index + msmtGroupData->sGhsMsmtIndex[i].msmt_length;
+    }
+    NRF_LOG_DEBUG("No msmt of type %lu in the group", type);
+    return -1;
+}
+
+void logMsmtGroupTemplate(char *name, s_MsmtGroupData* msmtGroupData)
+{
+    unsigned short i;
+    if (!checkMsmtGroupData(msmtGroupData)) return;
+    NRF_LOG_RAW_INFO("static const unsigned char %sGroupTemplateData[%u] =\n{", name, msmtGroupData->bufferLength);
+    for (i = 0; i < msmtGroupData->bufferLength; i++)
+    {
+        NRF_LOG_RAW_INFO("%s0x%02X,", ((i % 16) == 0) ? "\n    " : " ", msmtGroupData->data[i]);
+        if ((i % 16) == 15)
+        {
+            NRF_LOG_FLUSH();    // A row at a time keeps the deferred log buffer from overflowing
+        }
+    }
+    NRF_LOG_RAW_INFO("\n};\nstatic const s_GhsMsmtIndex %sGroupTemplateIndex[%u] =\n{\n", name, msmtGroupData->currentGhsMsmtCount);
+    for (i = 0; i < msmtGroupData->currentGhsMsmtCount; i++)
+    {
+        s_GhsMsmtIndex *sGhsMsmtIndex = &msmtGroupData->sGhsMsmtIndex[i];
+        (void)sGhsMsmtIndex;    // Only read by the log calls, which may be compiled out
+        NRF_LOG_RAW_INFO("    { .msmtValueType = 0x%04X, .msmt_length = %u, .id_index = %u, .numberOfCmpds = %u,",
+            sGhsMsmtIndex->msmtValueType, sGhsMsmtIndex->msmt_length, sGhsMsmtIndex->id_index, sGhsMsmtIndex->numberOfCmpds);
+        NRF_LOG_RAW_INFO(" .numberOfBytes = %u, .value_index = %u, .isSfloat = %s,",
+            sGhsMsmtIndex->numberOfBytes, sGhsMsmtIndex->value_index, sGhsMsmtIndex->isSfloat ? "true" : "false");
+        NRF_LOG_RAW_INFO(" .numberOfSuppTypes = %u, .suppTypes_index = %u, .numberRefs = %u, .ref_index = %u, .duration_index = %u },\n",
+            sGhsMsmtIndex->numberOfSuppTypes, sGhsMsmtIndex->suppTypes_index, sGhsMsmtIndex->numberRefs,
+            sGhsMsmtIndex->ref_index, sGhsMsmtIndex->duration_index);
+        NRF_LOG_FLUSH();
+    }
+    NRF_LOG_RAW_INFO("};\nstatic const s_MsmtGroupTemplate %sGroupTemplate =\n{\n", name);
+    NRF_LOG_RAW_INFO("    .dataLength = %u, .timestamp_index = %u, .no_of_msmts_index = %u,\n",
+        msmtGroupData->bufferLength, msmtGroupData->timestamp_index, msmtGroupData->no_of_msmts_index);
+    NRF_LOG_RAW_INFO("    .numberOfSuppTypes = %u, .suppTypes_index = %u, .numberRefs = %u, .ref_index = %u, .duration_index = %u,\n",
+        msmtGroupData->numberOfSuppTypes, msmtGroupData->suppTypes_index, msmtGroupData->numberRefs,
+        msmtGroupData->ref_index, msmtGroupData->duration_index);
+    NRF_LOG_RAW_INFO("    .numberOfGhsMsmts = %u, .sGhsMsmtIndex = %sGroupTemplateIndex, .data = %sGroupTemplateData\n};\n",
+        msmtGroupData->currentGhsMsmtCount, name, name);
+    NRF_LOG_FLUSH();
+}
+
+static bool addGroupField(s_GroupFieldMap *fieldMap, unsigned char kind, unsigned short dataIndex, unsigned short recordOffset,
+    unsigned char recordWidth, unsigned char dataWidth, signed char exponent)
+{
+    if (fieldMap == NULL || fieldMap->numberOfFields >= MAX_GROUP_FIELDS)
+    {
+        NRF_LOG_DEBUG("Field map is NULL or full. Increase MAX_GROUP_FIELDS");
+        return false;
+    }
+    if (recordWidth != 1 && recordWidth != 2 && recordWidth != 4 && recordWidth != 8)
+    {
+        NRF_LOG_DEBUG("Record value width %d is not supported", recordWidth);
+        return false;
+    }
+    s_GroupField *field = &fieldMap->fields[fieldMap->numberOfFields++];
+    field->kind = kind;
+    field->dataIndex = dataIndex;
+    field->recordOffset = recordOffset;
+    field->recordWidth = recordWidth;
+    field->dataWidth = dataWidth;
+    field->exponent = exponent;
+    return true;
+}
+
+static s_GhsMsmtIndex* getGroupFieldMsmt(s_MsmtGroupData* msmtGroupData, short msmtIndex)
+{
+    if (!checkMsmtGroupData(msmtGroupData)) return NULL;
+    if (!((msmtIndex >= 0) && (msmtIndex < msmtGroupData->currentGhsMsmtCount)))
+    {
+        NRF_LOG_DEBUG("Msmt index %d is invalid. Skipping", msmtIndex);
+        return NULL;
+    }
+    return &msmtGroupData->sGhsMsmtIndex[msmtIndex];
+}
+
+// The msmt id goes in with the first value of the msmt
+static bool addGroupFieldMsmtId(s_GroupFieldMap *fieldMap, s_GhsMsmtIndex* sGhsMsmtIndex, short msmtIndex)
+{
+    if (sGhsMsmtIndex->id_index == 0)
+    {
+        return true;
+    }
+    return addGroupField(fieldMap, GROUP_FIELD_MSMT_ID, sGhsMsmtIndex->id_index, msmtIndex, 1, ID_SIZE, 0);
+}
+
+bool addGroupFieldNumeric(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, short msmtIndex, unsigned char component,
+    unsigned short recordOffset, unsigned char recordWidth, bool isSigned, signed char exponent)
+{
+    s_GhsMsmtIndex* sGhsMsmtIndex = getGroupFieldMsmt(msmtGroupData, msmtIndex);
+    if (sGhsMsmtIndex == NULL) return false;
+    unsigned char valueWidth = sGhsMsmtIndex->isSfloat ? 2 : 4;
+    unsigned short dataIndex = sGhsMsmtIndex->value_index;
+    if (sGhsMsmtIndex->msmtValueType == MSMT_VALUE_COMPOUND_COMPLEX && component < sGhsMsmtIndex->numberOfCmpds)
+    {
+        dataIndex = dataIndex + component * (valueWidth + 7);  // Same layout updateDataCompound() walks
+    }
+    else if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_NUMERIC || component != 0)
+    {
+        NRF_LOG_DEBUG("Measurement is not a numeric or has no component %d. Skipping", component);
+        return false;
+    }
+    if (component == 0 && !addGroupFieldMsmtId(fieldMap, sGhsMsmtIndex, msmtIndex)) return false;
+    unsigned char kind;
+    if (sGhsMsmtIndex->isSfloat)
+    {
+        kind = isSigned ? GROUP_FIELD_SIGNED_SFLOAT : GROUP_FIELD_SFLOAT;
+    }
+    else
+    {
+        kind = isSigned ? GROUP_FIELD_SIGNED_FLOAT : GROUP_FIELD_FLOAT;
+    }
+    return addGroupField(fieldMap, kind, dataIndex, recordOffset, recordWidth, valueWidth, exponent);
+}
+
+bool addGroupFieldBits(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, short msmtIndex,
+    unsigned short recordOffset, unsigned char recordWidth)
+{
+    unsigned short i;
+    s_GhsMsmtIndex* sGhsMsmtIndex = getGroupFieldMsmt(msmtGroupData, msmtIndex);
+    if (sGhsMsmtIndex == NULL) return false;
+    if (sGhsMsmtIndex->msmtValueType != MSMT_VALUE_BITS)
+    {
+        NRF_LOG_DEBUG("Measurement is not a BITs. Skipping");
+        return false;
+    }
+    // The value follows the supported and state masks; see updateDataBits()
+    unsigned short dataIndex = sGhsMsmtIndex->value_index + 2 * sGhsMsmtIndex->numberOfBytes;
+    for (i = 0; i < fieldMap->numberOfFields; i++)
+    {
+        if (fieldMap->fields[i].dataIndex == dataIndex)
+        {
+            return addGroupField(fieldMap, GROUP_FIELD_BITS_OR, dataIndex, recordOffset, recordWidth, sGhsMsmtIndex->numberOfBytes, 0);
+        }
+    }
+    if (!addGroupFieldMsmtId(fieldMap, sGhsMsmtIndex, msmtIndex)) return false;
+    return addGroupField(fieldMap, GROUP_FIELD_BITS, dataIndex, recordOffset, recordWidth, sGhsMsmtIndex->numberOfBytes, 0);
+}
+
+bool addGroupFieldRef(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, short msmtIndex, unsigned short ref_index,
+    short refMsmtIndex)
+{
+    s_GhsMsmtIndex* sGhsMsmtIndex = getGroupFieldMsmt(msmtGroupData, msmtIndex);
+    if (sGhsMsmtIndex == NULL) return false;
+    if (ref_index >= sGhsMsmtIndex->numberRefs)
+    {
+        NRF_LOG_DEBUG("ref_index exceeds number of src handle refs allocated.");
+        return false;
+    }
+    return addGroupField(fieldMap, GROUP_FIELD_MSMT_ID, sGhsMsmtIndex->ref_index + ref_index * ID_SIZE, refMsmtIndex, 1, ID_SIZE, 0);
+}
+
+bool addGroupFieldTimeStamp(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, unsigned short epochOffset,
+    unsigned short timelineOffset)
+{
+    if (!checkMsmtGroupData(msmtGroupData)) return false;
+    if (msmtGroupData->timestamp_index == 0)
+    {
+        NRF_LOG_DEBUG("Time stamps not supported.");
+        return false;
+    }
+    if (!addGroupField(fieldMap, GROUP_FIELD_EPOCH, msmtGroupData->timestamp_index + GHS_TIME_INDEX_EPOCH,
+        epochOffset, sizeof(unsigned long long), 6, 0)) return false;
+    return addGroupField(fieldMap, GROUP_FIELD_TIMELINE, msmtGroupData->timestamp_index + GHS_TIME_INDEX_FLAGS,
+        timelineOffset, sizeof(unsigned char), 1, 0);
+}
+
+bool updateGroup(s_MsmtGroupData** msmtGroupDataPtr, const s_GroupFieldMap *fieldMap, const void *record, unsigned long *msmt_id)
+{
+    s_MsmtGroupData* msmtGroupData = *msmtGroupDataPtr;
+    if (!checkMsmtGroupData(msmtGroupData) || fieldMap == NULL || record == NULL) return false;
+    const unsigned char *recordBytes = (const unsigned char *)record;
+    unsigned char *data = msmtGroupData->data;
+    unsigned short dataLength = msmtGroupData->dataLength;  // Locals so the byte stores below do not force reloads
+    unsigned short numberOfFields = fieldMap->numberOfFields;
+    unsigned short i;
+    unsigned char j;
+    for (i = 0; i < numberOfFields; i++)
+    {
+        const s_GroupField field = fieldMap->fields[i];
+        if (field.dataIndex >= dataLength)
+        {
+            continue;   // Belongs to a msmt dropped by updateDataDropLastMsmt()
+        }
+        unsigned long long value = 0;
+        if (field.kind == GROUP_FIELD_MSMT_ID)
+        {
+            value = *msmt_id + field.recordOffset;
+        }
+        else if (field.recordWidth == 1)
+        {
+            value = recordBytes[field.recordOffset];
+        }
+        else if (field.recordWidth == 2)
+        {
+            unsigned short v;
+            memcpy(&v, &recordBytes[field.recordOffset], 2);
+            value = v;
+        }
+        else if (field.recordWidth == 4)
+        {
+            unsigned long v;
+            memcpy(&v, &recordBytes[field.recordOffset], 4);
+            value = v;
+        }
+        else
+        {
+            memcpy(&value, &recordBytes[field.recordOffset], 8);
+        }
+        unsigned char *dest = &data[field.dataIndex];
+        unsigned long long signBit;
+        switch (field.kind)
+        {
+            case GROUP_FIELD_SIGNED_FLOAT:
+            case GROUP_FIELD_SIGNED_SFLOAT:
+                signBit = 1ULL << (field.recordWidth * 8 - 1);
+                value = (value ^ signBit) - signBit;    // Sign extend so the mask below leaves the two's complement
+                if (field.kind == GROUP_FIELD_SIGNED_SFLOAT)
+                {
+                    value = MDER_SFLOAT_FROM_INTEGERS(field.exponent, value);
+                    break;
+                }
+                // fall through
+            case GROUP_FIELD_FLOAT:
+                value = MDER_FLOAT_FROM_INTEGERS(field.exponent, value);
+                break;
+            case GROUP_FIELD_SFLOAT:
+                value = MDER_SFLOAT_FROM_INTEGERS(field.exponent, value);
+                break;
+            case GROUP_FIELD_BITS_OR:
+                for (j = 0; j < field.dataWidth; j++)
+                {
+                    dest[j] |= (value & 0xFF);
+                    value = (value >> 8);
+                }
+                continue;
+            case GROUP_FIELD_TIMELINE:
+                value = (value == GHS_TIME_FLAG_ON_CURRENT_TIMELINE) ? (dest[0] | GHS_TIME_FLAG_ON_CURRENT_TIMELINE) : (dest[0] & 0xDF);
+                break;
+            default:
+                break;
+        }
+        switch (field.dataWidth)   // Little endian. The widths are fixed by the map so this beats a byte loop
+        {
+            case 6:
+                dest[5] = ((value >> 40) & 0xFF);
+                dest[4] = ((value >> 32) & 0xFF);
+                // fall through
+            case 4:
+                dest[3] = ((value >> 24) & 0xFF);
+                // fall through
+            case 3:
+                dest[2] = ((value >> 16) & 0xFF);
+                // fall through
+            case 2:
+                dest[1] = ((value >> 8) & 0xFF);
+                // fall through
+            default:
+                dest[0] = (value & 0xFF);
+                break;
+        }
+    }
+    *msmt_id = *msmt_id + data[msmtGroupData->no_of_msmts_index];
+    return true;
+}
@@ -18,10 +18,13 @@ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR TH
 DEALINGS IN THE SOFTWARE.
 */
 
+#include <stddef.h>
+#include <string.h>
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 #include "nrf_soc.h"
+#include "app_util_platform.h"
 
 #include "ble_types.h"
 #include "ble_gatts.h"
@@ -31,6 +34,15 @@ DEALINGS IN THE SOFTWARE.
 #include "configGhsEncoder.h"
 #include "msmt_queue.h"
 #include "handleSpecializations.h"
+#include "btle_utils.h"
+#if (USES_MSMT_GROUP_TEMPLATES == 1)
+    #include "msmtGroupTemplates.h"
+#endif
+#if (USES_MSMT_GROUP_TEMPLATES == 0 && LOG_MSMT_GROUP_TEMPLATES == 1)
+    #define LOG_MSMT_GROUP_TEMPLATE(name, msmtGroupData) logMsmtGroupTemplate(name, msmtGroupData)
+#else
+    #define LOG_MSMT_GROUP_TEMPLATE(name, msmtGroupData)
+#endif
 
 /**
  * We have put as much of the specialization configuration code in this file. The first method to
@@ -75,19 +87,15 @@ s_SystemInfo *systemInfo                        = NULL;     // We need to keep t
 unsigned short pairing                          = SUPPORT_PAIRING;        // Value of 1 indicates that pairing/bonding is required.
 unsigned char batteryCharValue                  = 0x63;
 unsigned short numberOfStoredMsmtGroups         = 0;
-bool stored_msmts_same                          = true;
 unsigned long long latestTimeStamp              = 0;
+s_RacpResume racpResume;
+s_StoredTimelines storedTimelines               = { .magic = STORED_TIMELINES_MAGIC, .current = 1,
+    .timeline = { [STORED_TIMELINE_RETIRED] = { 0LL, 0, STORED_TIMELINE_SYNC_NONE, STORED_TIMELINE_LIVE },
+                  [1] = { 0LL, 0, STORED_TIMELINE_SYNC_NONE, STORED_TIMELINE_LIVE } } };
+bool storedTimelinesChanged                     = false;    // storedTimelines differs from the copy saved with the bonding data
 unsigned long msmt_id                           = 1;
 unsigned long recordNumber                      = 0;
 
-#if (USES_STORED_DATA >= 1)
-    s_MsmtData storedMsmts[NUMBER_OF_STORED_MSMTS];     // Maximum number of stored msmts NUMBER_OF_STORED_MSMTS you want to support.
-                                                        // The s_MsmtData struct contains all the information that we will get from
-                                                        // the sensor. It is specified in the handleSpecializations.h file and is
-                                                        // different for each specialization. You can create whatever structure you
-                                                        // need depending upon your use case, but you will need to modify the code
-                                                        // in this file accordingly.
-#endif
 bool reportStatus = true;                           // used in BP for device status.
 /*
  * The epoch defines our base value which does not change during the connection unless it is
@@ -254,7 +262,6 @@ unsigned short security_char_length = 2;
 extern s_Queue *queue;
 
 extern volatile s_global_send global_send;
-extern nrf_mutex_t q_mutex;
 
 void ble_disconnected_handler(void *);
 unsigned long long getEpochFromBytes(unsigned char *bytes);
@@ -333,6 +340,10 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
                                                             // values.
     s_MsmtGroupData *msmtGroupOptimizedBpData       = NULL; // This structure would be the optimized version of the above data array. We do not
                                                             // use it in the BP example
+    #if (USES_MSMT_GROUP_TEMPLATES == 1)
+        MSMT_GROUP_DATA_STORAGE(bp, 2);                     // The RAM msmtGroupBpData points into when it is made from bpGroupTemplate: the
+                                                            // struct and two byte arrays as it is double buffered. No heap is used.
+    #endif
     short bp_index                                  = -1;   // The bp_index is the placing (order) of the bp measurement in the data array. This value is
                                                             // is returned by the 'addGhsMsmtToGroup() method. If the bp measurement is the first
                                                             // measurement you add to the group, the value will be 0. If it is the second, the
@@ -359,6 +370,7 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
                                                             // measurement LAST. Then we call the drop method. When status events are received from our
                                                             // fake sensor, we call the update method and update the status msmt with those values. We 
                                                             // call the drop method on the next measurement not to have status events.
+    static s_GroupFieldMap bpFieldMap;                      // Where updateGroup() puts each value of the s_MsmtData in the data array
 #endif
 
 #if (PULSE_OX == 1)
@@ -384,12 +396,18 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
     s_MsmtGroupData *msmtGroupSpotData              = NULL;
     s_MsmtGroupData *msmtGroupContData              = NULL;
     s_MsmtGroupData *msmtGroupOptimizedContData     = NULL;
+    #if (USES_MSMT_GROUP_TEMPLATES == 1)
+        MSMT_GROUP_DATA_STORAGE(spot, 2);
+        MSMT_GROUP_DATA_STORAGE(cont, 2);
+    #endif
     short spo2_index                                = -1;
     short pr_index                                  = -1;
     short qual_index                                = -1;
     short spo2_cont_index                           = -1;
     short pr_cont_index                             = -1;
     short qual_cont_index                           = -1;
+    static s_GroupFieldMap spotFieldMap;
+    static s_GroupFieldMap contFieldMap;
 #endif
 #if (GLUCOSE == 1)
     unsigned short BLE_APPEARANCE = BLE_APPEARANCE_GENERIC_GLUCOSE_METER;
@@ -413,6 +431,9 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
     unsigned char regCertDataList[22]               = { 0, 2, 0, 0x12, 2, 1, 0, 8, 5, 0, 0, 1, 0, 2, 0x80, 0x11, 2, 2, 0, 2, 0x80, 0 };
 
     s_MsmtGroupData *msmtGroupGlucData              = NULL;
+    #if (USES_MSMT_GROUP_TEMPLATES == 1)
+        MSMT_GROUP_DATA_STORAGE(gluc, 1);
+    #endif
     short conc_index                                = -1;
     short meds_index                                = -1;
     short carbs_index                               = -1;
@@ -439,7 +460,11 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
     static char *UDI_ISSUER_OID                     = "";
     static char *UDI_AUTH_OID                       = "";
     s_MsmtGroupData *msmtGroupHrData                = NULL;
+    #if (USES_MSMT_GROUP_TEMPLATES == 1)
+        MSMT_GROUP_DATA_STORAGE(hr, 2);
+    #endif
     short hr_index                                  = -1;
+    static s_GroupFieldMap hrFieldMap;
 #endif
 /**
  * It's hard to generate Spirometry data that makes even remote sense, especially the waveforms. So in this case we use data
@@ -632,6 +657,10 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
     s_MsmtGroupData *settingsGroupData              = NULL;
     s_MsmtGroupData *msmtGroupScaleData             = NULL;
     s_MsmtGroupData *msmtGroupOptimizedScaleData    = NULL;
+    #if (USES_MSMT_GROUP_TEMPLATES == 1)
+        MSMT_GROUP_DATA_STORAGE(settings, 1);
+        MSMT_GROUP_DATA_STORAGE(scale, 2);
+    #endif
     unsigned short height_ref                       = 0;
     short mass_index                                = -1;
     short height_index                              = -1;
@@ -661,8 +690,12 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
 
     s_MsmtGroupData *msmtGroupTempData              = NULL;
     s_MsmtGroupData *msmtGroupOptimizedTempData     = NULL;
+    #if (USES_MSMT_GROUP_TEMPLATES == 1)
+        MSMT_GROUP_DATA_STORAGE(temp, 2);
+    #endif
     short temp_index                                = -1;
     short ambient_index                             = -1;
+    static s_GroupFieldMap tempFieldMap;
 #endif
 
 /** ================================================ SEQUENCE ===========================
@@ -712,11 +745,10 @@ unsigned char *getBtAddress(void)
  */
 void configureSpecializations(void)
 {
-    bool result;
     msmt_id = 1;
 
-    // NOTE: We are bad boys and do not check the 'result' value. If false, something went bad, almost always due to
-    // implementation bugs.
+    // NOTE: We are bad boys and do not check the return values of the create/set methods. If one is false, something
+    // went bad, almost always due to implementation bugs.
 
     // Now to configure our GHS PHD information
     // Create the time info data buffer,  but first establish our GhsTime which we
@@ -728,7 +760,7 @@ void configureSpecializations(void)
                         // 1L for GHS_TIME_FLAG_SUPPORTS_SECONDS
         // Method allocates the s_GhsTime structure and populates it with the information
         // it can at the moment.
-        result = createGhsTime(&sGhsTime,           // Structure to be allocated. The initial pointer must be NULL. Note that
+        createGhsTime(&sGhsTime,                    // Structure to be allocated. The initial pointer must be NULL. Note that
                                                     // we pass in a pointer to the pointer so when the method completes, the
                                                     // structure will be populated.
                       GHS_TIME_OFFSET_UNSUPPORTED,  // We do not support an offset to UTC. Most devices don't!
@@ -740,7 +772,7 @@ void configureSpecializations(void)
                                                     // stamp must be able to report their current time. Given that, the client
                                                     // can ALWAYs correct the times to the correct time IF the client is synchronized,
                                                     // which we assume is the case, even if the device is never synchronized.
-        result = createTimeInfo(&sTimeInfo,         // A pointer to an s_TimeInfo structure which we will use to create the sTimeInfoData
+        createTimeInfo(&sTimeInfo,                  // A pointer to an s_TimeInfo structure which we will use to create the sTimeInfoData
                                                     // struct containing the data array to be sent to the client when the client asks
                                                     // for the current time info. It needs to be NULL when passed in. Space is allocated
                                                     // for the structure and is populated by this method.
@@ -748,7 +780,7 @@ void configureSpecializations(void)
                                                     // support a time clock at all, this parameter shall be NULL.
                             true);                 // When 'true' we want the client to set the time. This value is ignored for relative times
                                                     // and no times.
-        result = createCurrentTimeDataBuffer(&sTimeInfoData, sTimeInfo);  // This method creates the time info data array structure from 
+        createCurrentTimeDataBuffer(&sTimeInfoData, sTimeInfo);           // This method creates the time info data array structure from 
                                                                       // the s_TimeInfo struct. We will need to populate the current time
                                                                       // part of this array when the client asks for it. That is done by
                                                                       // various update methods.
@@ -759,28 +791,36 @@ void configureSpecializations(void)
     // Create the system info data buffer. Here is where we set info like the serial number, specialization, firmware, ect. The idea is to
     // create the system info data buf to get sent to client when it asks for it. The nice thing here is that these values are static, so once
     // created, we are done. No updaters are needed.
-    result = createSystemInfo(&systemInfo, 1);              // Allocates and populates the s_SystemInfo struct. We pass in a pointer
+    createSystemInfo(&systemInfo, 1);                       // Allocates and populates the s_SystemInfo struct. We pass in a pointer
                                                             // to a pointer intialized to NULL. The second parameter is the number of specializations
                                                             // supported by the device. In most cases it will be 1.
-    result = addSpecialization(&systemInfo, SPECIALIZATION, 2); // Add the specialization and specialization version to system info
-    result = setSystemIdentifierByte(&systemInfo, systemId);    // Add the system id to the system info
-    result = setRequiredSystemInfoStrings(&systemInfo, MANUFACTURER_NAME, MODEL_NUMBER);    // Add the manufacturer name and model number
+    addSpecialization(&systemInfo, SPECIALIZATION, 2); // Add the specialization and specialization version to system info
+    setSystemIdentifierByte(&systemInfo, systemId);             // Add the system id to the system info
+    setRequiredSystemInfoStrings(&systemInfo, MANUFACTURER_NAME, MODEL_NUMBER);             // Add the manufacturer name and model number
                                                                                             // These fields are generally required in most circumstances
                                                                                             // but if this method is not called there will be no failure.
                                                                                             // PLease add these fields!
-    result = setRegulationStatus(&systemInfo,     // Set the regulation status.
+    setRegulationStatus(&systemInfo,              // Set the regulation status.
                                  true,            // If true, a regulation status entry will be added.
                                  false);          // If true, the regulation status is reported as regulated. Ignored if no regulation status is present.
-    result = setOptionalSystemInfoStrings(&systemInfo,       // Sets the serial number and the firmware, hardware, and software versions.
+    setOptionalSystemInfoStrings(&systemInfo,                // Sets the serial number and the firmware, hardware, and software versions.
                                         SERIAL_NUMBER,       // serial number
                                         FIRMWARE_VERSION,    // firmware version
                                         HARDWARE_VERSION,    // hardware version
                                         SOFTWARE_VERSION);   // software version
-    result = setUdi(&systemInfo, UDI_LABEL, UDI_DEV_ID, UDI_ISSUER_OID, UDI_AUTH_OID);
+    setUdi(&systemInfo, UDI_LABEL, UDI_DEV_ID, UDI_ISSUER_OID, UDI_AUTH_OID);
     systemInfo->regCertDataList = regCertDataList;
     systemInfo->regCertDataListLength = 22;
 
-    #if (BP_CUFF == 1)
+    #if (BP_CUFF == 1 && USES_MSMT_GROUP_TEMPLATES == 1)
+        // The data array is copied from the template in ROM that the code below logs. The indices are looked up by
+        // type so they are the ones addGhsMsmtToGroup() returned there.
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupBpData, &bpGroupTemplate, sGhsTime, &bpGroupStorage);
+        bp_index = getMsmtIndexOfType(msmtGroupBpData, MDC_PRESS_BLD_NONINV);
+        pr_index = getMsmtIndexOfType(msmtGroupBpData, MDC_PULS_RATE_NON_INV);
+        status_index = getMsmtIndexOfType(msmtGroupBpData, MDC_BLOOD_PRESSURE_MEASUREMENT_STATUS);
+        reportStatus = true;
+    #elif (BP_CUFF == 1)
         // Create the msmt data group      These structures will be used to create the data array to be sent on the wire and then be freed.
         s_MsmtGroup *msmtGroup = NULL;  // structure to hold the msmt group set up
         s_GhsMsmt *bp = NULL;           // structure to hold the blood pressure set up
@@ -793,10 +833,10 @@ void configureSpecializations(void)
         compounds[0].subUnits = MDC_DIM_MMHG;
         compounds[1].subUnits = MDC_DIM_MMHG;
         compounds[2].subUnits = MDC_DIM_MMHG;
-        result = createMsmtGroup(&msmtGroup,    // Now allocate the measurement group and configure it
+        createMsmtGroup(&msmtGroup,             // Now allocate the measurement group and configure it
                                  (USES_TIMESTAMP == 1),          // When true we will use time stamps
                                  3);             // We will have (up to) three measurements in the group, bp, pr, and status
-        result = createComplexCompoundNumericMsmt(&bp,                     // Configure the blood pressure measurement which is a compound
+        createComplexCompoundNumericMsmt(&bp,                              // Configure the blood pressure measurement which is a compound
                                            MDC_PRESS_BLD_NONINV,    // Provide the overall type for the compound
                                            false,                    // When true, the measurement values are going to use 2-byte SFLOATs instead
                                                                     // of 4-byte FLOATs. This resolution is good enough for the typical bp measurements.
@@ -805,7 +845,7 @@ void configureSpecializations(void)
                                            compounds,               // The array of compounds (has the sub types). The values are added in updaters
                                                                     // when we get the data from the sensor.
                                            true);
-        result = setGhsMsmtSupplementalTypes(&bp, 1);   // We are going to add a supplemental type to the blood pressure measurement. This supplemental
+        setGhsMsmtSupplementalTypes(&bp, 1);            // We are going to add a supplemental type to the blood pressure measurement. This supplemental
                                                         // type will indicate the measurement is taken on the upper arm. After we create the data array
                                                         // We will update the array with the MDC code MDC_UPEXT_ARM_UPPER. We will do it here since it is
                                                         // assumed that it does not change during the connection.
@@ -813,14 +853,14 @@ void configureSpecializations(void)
                                                         // the returned bp_index. The application will need that value in order to update the data array
                                                         // with the bp values received from the sensor.
 
-        result = createNumericMsmt(&pr,                     // Now we add the pulse rate which is a simple numeric. Much simpler.
+        createNumericMsmt(&pr,                              // Now we add the pulse rate which is a simple numeric. Much simpler.
                                    MDC_PULS_RATE_NON_INV,   // This is the MDC code giving the type of measurement
                                    false,                   // When true, the measurement values are going to be 2-byte SFLOATS
                                    MDC_DIM_BEAT_PER_MIN, true);   // The MDC code for the measurement units - beats per minute.
         pr_index = addGhsMsmtToGroup(pr, &msmtGroup);       // Add this measurement to the group. Again the application will need the pr_index
                                                             // in order to update the data array with pr data from the sensor
 
-        result = createBitsEnumMsmt(&status,                                 // The status measurement which is a special measurement type that
+        createBitsEnumMsmt(&status,                                          // The status measurement which is a special measurement type that
                                                                             // that can contain up to 16 simultaneous events. Each event is represented
                                                                             // by a bit in a 16-bit number. For the bp standard, only six different
                                                                             // status events are defined and they are all events, not states.
@@ -830,7 +870,7 @@ void configureSpecializations(void)
                                      BP_STATUS_ALL_SUPPORTED,               // This value gives which of the bits are supported. For the BP standard
                                                                             // only bits 0 - 5 are defined. We are not using Mder bit encoding here.
                                      2, false);                             // The size of the bits measurement is two bytes.
-        result = setGhsMsmtRefs(&status, 2);           // This method add references to status measurement. The reference will point to the
+        setGhsMsmtRefs(&status, 2);                    // This method add references to status measurement. The reference will point to the
                                                                 // measurement(s) this status event effects. In this case that would be the bp and pr.
                                                                 // So when we update the status event, we will call an update method to add the reference
                                                                 // (msmt_id) of the BP and PR measurements that were associated with these status events.
@@ -838,31 +878,59 @@ void configureSpecializations(void)
                                                                 // update the data array with the events and the references.
         reportStatus = true;                                    // First msmt report the status, then flip.
 
-        result = createMsmtGroupDataArray(&msmtGroupBpData,     // Now we create the measurement group data array structure.
+        createDoubleBufferedMsmtGroupDataArray(&msmtGroupBpData, // Now we create the measurement group data array structure. It is double
+                                                                // buffered so the next live msmt can be encoded while this one is sent.
                                           msmtGroup,            // Pass in the measurement group to populate this data rray structure
                                           sGhsTime);             // Pass in the s_GhsTime structure to populate the static parts of the time stamp
                                                                 // If there is no time stamp, this parameter is NULL. Here we have time stamps.
-        result = updateDataGhsMsmtSupplementalTypes(&msmtGroupBpData, bp_index,
+        updateDataGhsMsmtSupplementalTypes(&msmtGroupBpData, bp_index,
                                                                        MDC_UPEXT_ARM_UPPER, 0); // As stated we are going to add the code for the location
                                                                                                 // of the BP cuff once now, as we are not expecting it to
                                                                                                 // change during the connection. Of course, most devices
                                                                                                 // probably wont add this information unless, for some reason
                                                                                                 // it could change and be indicated by a UI.
+        LOG_MSMT_GROUP_TEMPLATE("bp", msmtGroupBpData);  // The source of bpGroupTemplate
 
 
         cleanUpMsmtGroup(&msmtGroup); // Now that we have gotten our data array we do not need the configuration structure anymore. Calling this cleanup
                                       // method also frees the memory allocated for all the measurement set up structures that we added to the group. So
                                       // we do not need to free them UNLESS we did not add them to the msmtGroup.
-//        result = updateDataDropLastMsmt(&msmtGroupBpData);  // This special method configures our data array such that when sent, the last measurement, which
+//        updateDataDropLastMsmt(&msmtGroupBpData);           // This special method configures our data array such that when sent, the last measurement, which
                                                    // is the status measurement, will not be sent over the airwaves. This is because, in practice, status
                                                    // events are anticipated to be the exception and not the rule. So instead of sending a status event with
                                                    // a value of all 0s (no events) we remove sending the event from the group. The measurement is still
                                                    // there and should we need it, the application calls updateDataRestoreLastMsmt(&msmtGroupBpData)
                                                    // and then adds the status event data into the data array by calling the appropriate update routine.
     #endif  // BP cuff
+    #if (BP_CUFF == 1)
+        // Now the field map that lets encodeSpecializationMsmts() fill the data array from an s_MsmtData with one updateGroup()
+        // call. Each entry gives the value in the s_MsmtData and the exponent it is sent with. Our fake sensor reports whole
+        // integers so the exponent is 0. A sensor reporting 123.2 as 1232 would use -1; the value is mantissa * 10 ** exponent.
+        addGroupFieldNumeric(&bpFieldMap, msmtGroupBpData, bp_index, 0, offsetof(s_MsmtData, systolic), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&bpFieldMap, msmtGroupBpData, bp_index, 1, offsetof(s_MsmtData, diastolic), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&bpFieldMap, msmtGroupBpData, bp_index, 2, offsetof(s_MsmtData, mean), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&bpFieldMap, msmtGroupBpData, pr_index, 0, offsetof(s_MsmtData, pulseRate), sizeof(unsigned short), false, 0);
+        addGroupFieldRef(&bpFieldMap, msmtGroupBpData, status_index, 0, bp_index);   // The status refers to the bp and the pr
+        addGroupFieldRef(&bpFieldMap, msmtGroupBpData, status_index, 1, pr_index);
+        addGroupFieldBits(&bpFieldMap, msmtGroupBpData, status_index, offsetof(s_MsmtData, status_cuff_too_loose), sizeof(unsigned short));
+        addGroupFieldBits(&bpFieldMap, msmtGroupBpData, status_index, offsetof(s_MsmtData, status_improper_position), sizeof(unsigned short));
+        addGroupFieldBits(&bpFieldMap, msmtGroupBpData, status_index, offsetof(s_MsmtData, status_irregular_pulse), sizeof(unsigned short));
+        addGroupFieldBits(&bpFieldMap, msmtGroupBpData, status_index, offsetof(s_MsmtData, status_movement), sizeof(unsigned short));
+        addGroupFieldTimeStamp(&bpFieldMap, msmtGroupBpData, offsetof(s_MsmtData, common.sGhsTime.epoch),
+            offsetof(s_MsmtData, common.sGhsTime.flagKnownTimeline));
+    #endif
 
 
-    #if (PULSE_OX == 1)
+    #if (PULSE_OX == 1 && USES_MSMT_GROUP_TEMPLATES == 1)
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupSpotData, &spotGroupTemplate, sGhsTime, &spotGroupStorage);
+        spo2_index = getMsmtIndexOfType(msmtGroupSpotData, MDC_PULS_OXIM_SAT_O2);
+        pr_index = getMsmtIndexOfType(msmtGroupSpotData, MDC_PULS_OXIM_PULS_RATE);
+        qual_index = getMsmtIndexOfType(msmtGroupSpotData, MDC_SAT_O2_QUAL);
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupContData, &contGroupTemplate, NULL, &contGroupStorage);
+        spo2_cont_index = getMsmtIndexOfType(msmtGroupContData, MDC_PULS_OXIM_SAT_O2);
+        pr_cont_index = getMsmtIndexOfType(msmtGroupContData, MDC_PULS_OXIM_PULS_RATE);
+        qual_cont_index = getMsmtIndexOfType(msmtGroupContData, MDC_SAT_O2_QUAL);
+    #elif (PULSE_OX == 1)
         // Pulse Ox
         // device and sensor status measurement
         #define PO_DEV_STATUS_EXT_DISPLAY_ONGOING 1
@@ -887,16 +955,17 @@ void configureSpecializations(void)
         s_GhsMsmt *spo2 = NULL;
         s_GhsMsmt *pr = NULL;
         s_GhsMsmt *qual = NULL;
-        result = createMsmtGroup(&msmtGroup, (USES_TIMESTAMP == 1), 3); // 3 msmts - SpO2, PR, Qual
-        result = setHeaderSupplementalTypes(&msmtGroup, 1);
-        result = createNumericMsmt(&spo2, MDC_PULS_OXIM_SAT_O2, false, MDC_DIM_PERCENT, false);
+        createMsmtGroup(&msmtGroup, (USES_TIMESTAMP == 1), 3); // 3 msmts - SpO2, PR, Qual
+        setHeaderSupplementalTypes(&msmtGroup, 1);
+        createNumericMsmt(&spo2, MDC_PULS_OXIM_SAT_O2, false, MDC_DIM_PERCENT, false);
         spo2_index = addGhsMsmtToGroup(spo2, &msmtGroup);
-        result = createNumericMsmt(&pr, MDC_PULS_OXIM_PULS_RATE, false, MDC_DIM_BEAT_PER_MIN, false);
+        createNumericMsmt(&pr, MDC_PULS_OXIM_PULS_RATE, false, MDC_DIM_BEAT_PER_MIN, false);
         pr_index = addGhsMsmtToGroup(pr, &msmtGroup);
-        result = createNumericMsmt(&qual, MDC_SAT_O2_QUAL, false, MDC_DIM_PERCENT, false);
+        createNumericMsmt(&qual, MDC_SAT_O2_QUAL, false, MDC_DIM_PERCENT, false);
         qual_index = addGhsMsmtToGroup(qual, &msmtGroup);
-        result = createMsmtGroupDataArray(&msmtGroupSpotData, msmtGroup, sGhsTime);
+        createDoubleBufferedMsmtGroupDataArray(&msmtGroupSpotData, msmtGroup, sGhsTime);
         updateDataHeaderSupplementalTypes(&msmtGroupSpotData, MDC_MODALITY_SPOT, 0);
+        LOG_MSMT_GROUP_TEMPLATE("spot", msmtGroupSpotData);  // The source of spotGroupTemplate
         cleanUpMsmtGroup(&msmtGroup); // cleans up any allocated data -  we only need the data array now
 
         spo2 = NULL;
@@ -904,56 +973,83 @@ void configureSpecializations(void)
         qual = NULL;
 
         // Now for the continuous
-        result = createMsmtGroup(&msmtGroup, false, 3); // 3 msmts - SpO2, PR, Qual
-        result = createNumericMsmt(&spo2, MDC_PULS_OXIM_SAT_O2, false, MDC_DIM_PERCENT, false);
+        createMsmtGroup(&msmtGroup, false, 3); // 3 msmts - SpO2, PR, Qual
+        createNumericMsmt(&spo2, MDC_PULS_OXIM_SAT_O2, false, MDC_DIM_PERCENT, false);
         spo2_cont_index = addGhsMsmtToGroup(spo2, &msmtGroup);
-        result = createNumericMsmt(&pr, MDC_PULS_OXIM_PULS_RATE, false, MDC_DIM_BEAT_PER_MIN, false);
+        createNumericMsmt(&pr, MDC_PULS_OXIM_PULS_RATE, false, MDC_DIM_BEAT_PER_MIN, false);
         pr_cont_index = addGhsMsmtToGroup(pr, &msmtGroup);
-        result = createNumericMsmt(&qual, MDC_SAT_O2_QUAL, false, MDC_DIM_PERCENT, false);
+        createNumericMsmt(&qual, MDC_SAT_O2_QUAL, false, MDC_DIM_PERCENT, false);
         qual_cont_index = addGhsMsmtToGroup(qual, &msmtGroup);
-        result = createMsmtGroupDataArray(&msmtGroupContData, msmtGroup, NULL);
+        createDoubleBufferedMsmtGroupDataArray(&msmtGroupContData, msmtGroup, NULL);
+        LOG_MSMT_GROUP_TEMPLATE("cont", msmtGroupContData);  // The source of contGroupTemplate
         cleanUpMsmtGroup(&msmtGroup); // cleans up any allocated data - we only need the data array now
     #endif  // Pulse ox
-    #if (GLUCOSE == 1)
+    #if (PULSE_OX == 1)
+        addGroupFieldNumeric(&spotFieldMap, msmtGroupSpotData, spo2_index, 0, offsetof(s_MsmtData, spo2), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&spotFieldMap, msmtGroupSpotData, pr_index, 0, offsetof(s_MsmtData, pulseRate), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&spotFieldMap, msmtGroupSpotData, qual_index, 0, offsetof(s_MsmtData, pulseQuality), sizeof(unsigned short), false, -2);
+        addGroupFieldTimeStamp(&spotFieldMap, msmtGroupSpotData, offsetof(s_MsmtData, common.sGhsTime.epoch),
+            offsetof(s_MsmtData, common.sGhsTime.flagKnownTimeline));
+        addGroupFieldNumeric(&contFieldMap, msmtGroupContData, spo2_cont_index, 0, offsetof(s_MsmtData, spo2), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&contFieldMap, msmtGroupContData, pr_cont_index, 0, offsetof(s_MsmtData, pulseRate), sizeof(unsigned short), false, 0);
+        addGroupFieldNumeric(&contFieldMap, msmtGroupContData, qual_cont_index, 0, offsetof(s_MsmtData, pulseQuality), sizeof(unsigned short), false, -2);
+    #endif
+    #if (GLUCOSE == 1 && USES_MSMT_GROUP_TEMPLATES == 1)
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupGlucData, &glucGroupTemplate, sGhsTime, &glucGroupStorage);
+        conc_index = getMsmtIndexOfType(msmtGroupGlucData, MDC_CONC_GLU_UNDETERMINED_PLASMA);
+        meds_index = getMsmtIndexOfType(msmtGroupGlucData, MDC_CTXT_MEDICATION);
+        carbs_index = getMsmtIndexOfType(msmtGroupGlucData, MDC_CTXT_GLU_CARB);
+        exer_index = getMsmtIndexOfType(msmtGroupGlucData, MDC_CTXT_GLU_EXERCISE);
+    #elif (GLUCOSE == 1)
         s_MsmtGroup *glucoseGroup = NULL;
         s_GhsMsmt *conc = NULL;
         s_GhsMsmt *meds = NULL;
         s_GhsMsmt *carbs = NULL;
         s_GhsMsmt *exer = NULL;
-        result = createMsmtGroup(&glucoseGroup, (USES_TIMESTAMP == 1), 4); // 4 msmts
-        result = createNumericMsmt(&conc, MDC_CONC_GLU_UNDETERMINED_PLASMA, false, MDC_DIM_MILLI_G_PER_DL, false);
-        result = setGhsMsmtSupplementalTypes(&conc, 4);
+        createMsmtGroup(&glucoseGroup, (USES_TIMESTAMP == 1), 4); // 4 msmts
+        createNumericMsmt(&conc, MDC_CONC_GLU_UNDETERMINED_PLASMA, false, MDC_DIM_MILLI_G_PER_DL, false);
+        setGhsMsmtSupplementalTypes(&conc, 4);
         conc_index = addGhsMsmtToGroup(conc, &glucoseGroup);
-        result = createNumericMsmt(&meds, MDC_CTXT_MEDICATION, false, MDC_DIM_INTL_UNIT, false);
-        result = setGhsMsmtSupplementalTypes(&meds, 1);
+        createNumericMsmt(&meds, MDC_CTXT_MEDICATION, false, MDC_DIM_INTL_UNIT, false);
+        setGhsMsmtSupplementalTypes(&meds, 1);
         meds_index = addGhsMsmtToGroup(meds, &glucoseGroup);
-        result = createNumericMsmt(&carbs, MDC_CTXT_GLU_CARB, false, MDC_DIM_G, false);
-        result = setGhsMsmtSupplementalTypes(&carbs, 1);
+        createNumericMsmt(&carbs, MDC_CTXT_GLU_CARB, false, MDC_DIM_G, false);
+        setGhsMsmtSupplementalTypes(&carbs, 1);
         carbs_index = addGhsMsmtToGroup(carbs, &glucoseGroup);
-        result = createNumericMsmt(&exer, MDC_CTXT_GLU_EXERCISE, false, MDC_DIM_PERCENT, false);
+        createNumericMsmt(&exer, MDC_CTXT_GLU_EXERCISE, false, MDC_DIM_PERCENT, false);
         // TODO - make this observational with an updateData...
-        result = setGhsMsmtDuration(&exer);
+        setGhsMsmtDuration(&exer);
         exer_index = addGhsMsmtToGroup(exer, &glucoseGroup);
-        result = createMsmtGroupDataArray(&msmtGroupGlucData, glucoseGroup, sGhsTime);
+        createMsmtGroupDataArray(&msmtGroupGlucData, glucoseGroup, sGhsTime);
         s_MderFloat mder;
         mder.exponent = 0;
         mder.mantissa = 3600;
         mder.mderFloatType = MDER_FLOAT;
         mder.specialValue = MDER_NUMBER;
         updateDataGhsMsmtDuration(&msmtGroupGlucData, exer_index, &mder);
+        LOG_MSMT_GROUP_TEMPLATE("gluc", msmtGroupGlucData);  // The source of glucGroupTemplate
         cleanUpMsmtGroup(&glucoseGroup);
     #endif
-    #if (HEART_RATE == 1)
+    #if (HEART_RATE == 1 && USES_MSMT_GROUP_TEMPLATES == 1)
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupHrData, &hrGroupTemplate, NULL, &hrGroupStorage);
+        hr_index = getMsmtIndexOfType(msmtGroupHrData, MDC_ECG_HEART_RATE);
+    #elif (HEART_RATE == 1)
         s_MsmtGroup *hrGroup = NULL;
         s_GhsMsmt *hrMsmt = NULL;
         createMsmtGroup(&hrGroup, (USES_TIMESTAMP == 1), 1);
         createNumericMsmt(&hrMsmt, MDC_ECG_HEART_RATE, false, MDC_DIM_BEAT_PER_MIN, false);
         hr_index = addGhsMsmtToGroup(hrMsmt, &hrGroup);
-        createMsmtGroupDataArray(&msmtGroupHrData, hrGroup, NULL);
+        createDoubleBufferedMsmtGroupDataArray(&msmtGroupHrData, hrGroup, NULL);
+        LOG_MSMT_GROUP_TEMPLATE("hr", msmtGroupHrData);  // The source of hrGroupTemplate
         cleanUpMsmtGroup(&hrGroup);        
     #endif
+    #if (HEART_RATE == 1)
+        addGroupFieldNumeric(&hrFieldMap, msmtGroupHrData, hr_index, 0, offsetof(s_MsmtData, heartRate), sizeof(unsigned char), false, 0);
+    #endif
 
     #if (SPIROMETER == 1)
+        // The spirometer groups are always built here. The streaming group is mostly room for the samples and the
+        // session values depend on msmt_id, so there is little a template in ROM would save.
         spiro_sequence = 0;
         // Going to load all the data here and send it in chunks on the 'live' command and then stop.
         // The only update will be the time stamps
@@ -1005,8 +1101,8 @@ void configureSpecializations(void)
         s_GhsMsmt *fev1AtsGrade = NULL;
 
         // session
-        result = createMsmtGroup(&spiroSessionGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
-        result = createCodedMsmt(&session, MDC_DIAG_SESSION_SPIRO, true);
+        createMsmtGroup(&spiroSessionGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
+        createCodedMsmt(&session, MDC_DIAG_SESSION_SPIRO, true);
         session_index = addGhsMsmtToGroup(session, &spiroSessionGroup);
         createMsmtGroupDataArray(&msmtGroupSpiroSessionData, spiroSessionGroup, sGhsTime);
         session_id = msmt_id;
@@ -1014,26 +1110,26 @@ void configureSpecializations(void)
         cleanUpMsmtGroup(&spiroSessionGroup);
 
         // settings
-        result = createMsmtGroup(&spiroSettingsGroup,
+        createMsmtGroup(&spiroSettingsGroup,
                                     (USES_TIMESTAMP == 1),       // has time stamps
                                         5);     // number of measurements
 
-        result = setHeaderOptions(&spiroSettingsGroup,
+        setHeaderOptions(&spiroSettingsGroup,
                                     true,       // are settings
                                     false,      // has person id
                                     0);         // person id
-        result = setHeaderRefs(&spiroSettingsGroup, 1);
-        result = createNumericMsmt(&age, MDC_HF_AGE, false, MDC_DIM_YR, true);
-        result = createNumericMsmt(&weight, MDC_MASS_BODY_ACTUAL, false, MDC_DIM_KILO_G, true);
-        result = createNumericMsmt(&height, MDC_LEN_BODY_ACTUAL, false, MDC_DIM_CENTI_M, true);
-        result = createCodedMsmt(&ethnicity, MDC_ETHNICITY, true);
-        result = createCodedMsmt(&sex, MDC_BIRTH_SEX, true);
+        setHeaderRefs(&spiroSettingsGroup, 1);
+        createNumericMsmt(&age, MDC_HF_AGE, false, MDC_DIM_YR, true);
+        createNumericMsmt(&weight, MDC_MASS_BODY_ACTUAL, false, MDC_DIM_KILO_G, true);
+        createNumericMsmt(&height, MDC_LEN_BODY_ACTUAL, false, MDC_DIM_CENTI_M, true);
+        createCodedMsmt(&ethnicity, MDC_ETHNICITY, true);
+        createCodedMsmt(&sex, MDC_BIRTH_SEX, true);
         age_index = addGhsMsmtToGroup(age, &spiroSettingsGroup);
         weight_index = addGhsMsmtToGroup(weight, &spiroSettingsGroup);
         height_index = addGhsMsmtToGroup(height, &spiroSettingsGroup);
         ethnicity_index = addGhsMsmtToGroup(ethnicity, &spiroSettingsGroup);
         sex_index = addGhsMsmtToGroup(sex, &spiroSettingsGroup);
-        result = createMsmtGroupDataArray(&msmtGroupSpiroSettingsData, spiroSettingsGroup, sGhsTime);
+        createMsmtGroupDataArray(&msmtGroupSpiroSettingsData, spiroSettingsGroup, sGhsTime);
         updateDataHeaderRefs(&msmtGroupSpiroSettingsData, session_id, 0);
 
         s_MderFloat mder;
@@ -1060,15 +1156,15 @@ void configureSpecializations(void)
         cleanUpMsmtGroup(&spiroSettingsGroup);
 
         // sub session
-        result = createMsmtGroup(&spiroSubSessionGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
+        createMsmtGroup(&spiroSubSessionGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
         setHeaderRefs(&spiroSubSessionGroup, 1 );
-        result = createCodedMsmt(&sub_session, MDC_DIAG_SUB_SESSION_SPIRO_MANEUVER, true);
+        createCodedMsmt(&sub_session, MDC_DIAG_SUB_SESSION_SPIRO_MANEUVER, true);
         sub_session_index = addGhsMsmtToGroup(sub_session, &spiroSubSessionGroup);
         createMsmtGroupDataArray(&msmtGroupSpiroSubSessionData, spiroSubSessionGroup, sGhsTime);
         cleanUpMsmtGroup(&spiroSubSessionGroup);
 
         // streaming data
-        result = createMsmtGroup(&spiroStreamingGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
+        createMsmtGroup(&spiroStreamingGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
         setHeaderRefs(&spiroStreamingGroup, 1 );
         s_MderFloat period;
         period.exponent = -3;
@@ -1085,8 +1181,8 @@ void configureSpecializations(void)
         offset.mantissa = 0;  // raw data will be milliliters
         offset.mderFloatType = MDER_FLOAT;
         offset.specialValue = MDER_NUMBER;
-      //  result = createRtsaMsmt(&volume, MDC_VOL_AWAY, MDC_DIM_MILLI_L, &period, &scaleFactor, &offset, NO_OF_SAMPLES, SAMPLE_SIZE);
-        result = createRtsaMsmt(&flow, MDC_FLOW_AWAY, MDC_DIM_MILLI_L_PER_SEC, &period, &scaleFactor, &offset, NO_OF_SAMPLES, SAMPLE_SIZE, true);
+      //  createRtsaMsmt(&volume, MDC_VOL_AWAY, MDC_DIM_MILLI_L, &period, &scaleFactor, &offset, NO_OF_SAMPLES, SAMPLE_SIZE);
+        createRtsaMsmt(&flow, MDC_FLOW_AWAY, MDC_DIM_MILLI_L_PER_SEC, &period, &scaleFactor, &offset, NO_OF_SAMPLES, SAMPLE_SIZE, true);
         flow->rtsa->scaledMin = 0;
         flow->rtsa->scaledMax = 100;
       //  volume_index = addGhsMsmtToGroup(volume, &spiroStreamingGroup);
@@ -1097,16 +1193,16 @@ void configureSpecializations(void)
 
 
         // maneuver results
-        result = createMsmtGroup(&spiroManeuvGroup, (USES_TIMESTAMP == 1), 8); // 8 msmts for now
+        createMsmtGroup(&spiroManeuvGroup, (USES_TIMESTAMP == 1), 8); // 8 msmts for now
         setHeaderRefs(&spiroManeuvGroup, 1);
-        result = createNumericMsmt(&fev1, MDC_VOL_AWAY_EXP_FORCED_1S, false, MDC_DIM_L, true);
-        result = createNumericMsmt(&fev6, MDC_VOL_AWAY_EXP_FORCED_6S, false, MDC_DIM_L, true);
-        result = createNumericMsmt(&fvc, MDC_VOL_AWAY_EXP_FORCED_CAPACITY, false, MDC_DIM_L, true);
-        result = createNumericMsmt(&pef, MDC_FLOW_AWAY_EXP_FORCED_PEAK, false, MDC_DIM_L_PER_SEC, true);
-        result = createNumericMsmt(&fet, MDC_VOL_AWAY_EXP_FORCED_TIME, false, MDC_DIM_SEC, true);
-        result = createNumericMsmt(&fev1z, MDC_VOL_AWAY_FEV1_Z_SCORE, false, MDC_DIM_DIMLESS, true);
-        result = createNumericMsmt(&fev1_lln, MDC_VOL_AWAY_FEV1_LLN, false, MDC_DIM_L, true);
-        result = createNumericMsmt(&fev1_percent_pred,  MDC_VOL_AWAY_FEV1_PERCENT_PRED, false, MDC_DIM_PERCENT, true);
+        createNumericMsmt(&fev1, MDC_VOL_AWAY_EXP_FORCED_1S, false, MDC_DIM_L, true);
+        createNumericMsmt(&fev6, MDC_VOL_AWAY_EXP_FORCED_6S, false, MDC_DIM_L, true);
+        createNumericMsmt(&fvc, MDC_VOL_AWAY_EXP_FORCED_CAPACITY, false, MDC_DIM_L, true);
+        createNumericMsmt(&pef, MDC_FLOW_AWAY_EXP_FORCED_PEAK, false, MDC_DIM_L_PER_SEC, true);
+        createNumericMsmt(&fet, MDC_VOL_AWAY_EXP_FORCED_TIME, false, MDC_DIM_SEC, true);
+        createNumericMsmt(&fev1z, MDC_VOL_AWAY_FEV1_Z_SCORE, false, MDC_DIM_DIMLESS, true);
+        createNumericMsmt(&fev1_lln, MDC_VOL_AWAY_FEV1_LLN, false, MDC_DIM_L, true);
+        createNumericMsmt(&fev1_percent_pred,  MDC_VOL_AWAY_FEV1_PERCENT_PRED, false, MDC_DIM_PERCENT, true);
 
         fev1_index = addGhsMsmtToGroup(fev1, &spiroManeuvGroup);
         fev6_index = addGhsMsmtToGroup(fev6, &spiroManeuvGroup);
@@ -1133,11 +1229,11 @@ void configureSpecializations(void)
         // It makes not sense to create this data array here as the number of references will be unknown until
         // the session ends. Then we pick the best 3 best FVC and FEV1 values and use that. Then we fill in
         // the refs which ideally will have up to three entries in addition to the session_id.
-        result = createMsmtGroup(&spiroSummaryGroup, (USES_TIMESTAMP == 1), 2); // 1 msmts
+        createMsmtGroup(&spiroSummaryGroup, (USES_TIMESTAMP == 1), 2); // 1 msmts
         setHeaderRefs(&spiroSummaryGroup, 1);
-        result = createCodedMsmt(&fvcAtsGrade, MDC_SPIRO_FVC_ATS_QUAL, true);
+        createCodedMsmt(&fvcAtsGrade, MDC_SPIRO_FVC_ATS_QUAL, true);
         setGhsMsmtRefs(&fvcAtsGrade, 2);
-        result = createCodedMsmt(&fev1AtsGrade, MDC_SPIRO_FEV1_ATS_QUAL, true);
+        createCodedMsmt(&fev1AtsGrade, MDC_SPIRO_FEV1_ATS_QUAL, true);
         setGhsMsmtRefs(&fev1AtsGrade, 2);
         fvcAtsGrade_index = addGhsMsmtToGroup(fvcAtsGrade, &spiroSummaryGroup);
         fev1AtsGrade_index = addGhsMsmtToGroup(fev1AtsGrade, &spiroSummaryGroup);
@@ -1145,14 +1241,27 @@ void configureSpecializations(void)
         cleanUpMsmtGroup(&spiroSummaryGroup);
 
         // session end
-        result = createMsmtGroup(&spiroSessionEndGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
+        createMsmtGroup(&spiroSessionEndGroup, (USES_TIMESTAMP == 1), 1); // 1 msmt
         setHeaderRefs(&spiroSessionEndGroup, 1);
-        result = createCodedMsmt(&sessionEnd, MDC_DIAG_SESSION_SPIRO, true);
+        createCodedMsmt(&sessionEnd, MDC_DIAG_SESSION_SPIRO, true);
         session_end_index = addGhsMsmtToGroup(sessionEnd, &spiroSessionEndGroup);
         createMsmtGroupDataArray(&msmtGroupSpiroSessionEndData, spiroSessionEndGroup, sGhsTime);
         cleanUpMsmtGroup(&spiroSessionEndGroup);
     #endif
-    #if (SCALE == 1)
+    #if (SCALE == 1 && USES_MSMT_GROUP_TEMPLATES == 1)
+        createMsmtGroupDataArrayFromTemplate(&settingsGroupData, &settingsGroupTemplate, sGhsTime, &settingsGroupStorage);
+        height_index = getMsmtIndexOfType(settingsGroupData, MDC_LEN_BODY_ACTUAL);
+        s_MderFloat mder;
+        mder.specialValue = MDER_NUMBER;
+        mder.exponent = -1;
+        mder.mantissa = HEIGHT;
+        mder.mderFloatType = MDER_SFLOAT;
+        height_ref = msmt_id;               // Save the msmt_id value so the BMI msmts can point to it.
+        updateDataNumeric(&settingsGroupData, height_index, &mder, msmt_id++);
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupScaleData, &scaleGroupTemplate, sGhsTime, &scaleGroupStorage);
+        mass_index = getMsmtIndexOfType(msmtGroupScaleData, MDC_MASS_BODY_ACTUAL);
+        bmi_index = getMsmtIndexOfType(msmtGroupScaleData, MDC_RATIO_MASS_BODY_LEN_SQ);
+    #elif (SCALE == 1)
         s_MsmtGroup *msmtGroup = NULL;
         s_MsmtGroup *settingsGroup = NULL;
         s_GhsMsmt *mass = NULL;
@@ -1160,11 +1269,12 @@ void configureSpecializations(void)
         s_GhsMsmt *bmi = NULL;
 
         // Create the msmt data group for the settings measurements, in this case the height.
-        result = createMsmtGroup(&settingsGroup, false, 1); // 1 msmt height
-        result = setHeaderOptions(&settingsGroup, true, true, 2);  // indicate these are settings and include a person Id
-        result = createNumericMsmt(&height, MDC_LEN_BODY_ACTUAL, false, MDC_DIM_CENTI_M, true);
+        createMsmtGroup(&settingsGroup, false, 1); // 1 msmt height
+        setHeaderOptions(&settingsGroup, true, true, 2);           // indicate these are settings and include a person Id
+        createNumericMsmt(&height, MDC_LEN_BODY_ACTUAL, false, MDC_DIM_CENTI_M, true);
         height_index = addGhsMsmtToGroup(height, &settingsGroup);
-        result = createMsmtGroupDataArray(&settingsGroupData, settingsGroup, sGhsTime);
+        createMsmtGroupDataArray(&settingsGroupData, settingsGroup, sGhsTime);
+        LOG_MSMT_GROUP_TEMPLATE("settings", settingsGroupData);  // The source of settingsGroupTemplate
         // Populate the settings measurement data array with the settings height value. This need only be done once
         // unless, for some reason, the setting changes. Here we assume it is not to change while connected.
         s_MderFloat mder;
@@ -1174,33 +1284,45 @@ void configureSpecializations(void)
         mder.mantissa = HEIGHT;
         mder.mderFloatType = MDER_SFLOAT;
         height_ref = msmt_id;               // Save the msmt_id value so the BMI msmts can point to it.
-        result = updateDataNumeric(&settingsGroupData, height_index, &mder, msmt_id++); // Create final measurement - this is a setting.
+        updateDataNumeric(&settingsGroupData, height_index, &mder, msmt_id++); // Create final measurement - this is a setting.
         cleanUpMsmtGroup(&settingsGroup); // cleans up any allocated data -  we only need the data array now
 
         // Create the measurement group for the mass and bmi.
-        result = createMsmtGroup(&msmtGroup, (USES_TIMESTAMP == 1), 2); // 2 msmts mass, BMI
-        result = setHeaderOptions(&msmtGroup, false, true, 2);  // include a person Id
-        result = createNumericMsmt(&mass, MDC_MASS_BODY_ACTUAL, false, MDC_DIM_KILO_G, true); // Create a numeric msmt for the body mass
+        createMsmtGroup(&msmtGroup, (USES_TIMESTAMP == 1), 2); // 2 msmts mass, BMI
+        setHeaderOptions(&msmtGroup, false, true, 2);           // include a person Id
+        createNumericMsmt(&mass, MDC_MASS_BODY_ACTUAL, false, MDC_DIM_KILO_G, true); // Create a numeric msmt for the body mass
         mass_index = addGhsMsmtToGroup(mass, &msmtGroup);       // add it to the group
-        result = createNumericMsmt(&bmi, MDC_RATIO_MASS_BODY_LEN_SQ, false, MDC_DIM_KG_PER_M_SQ, false); // Create a numeric msmt for the BMI
-        result = setGhsMsmtRefs(&bmi, 2);              // Make room for two references in the BMI; one to height, the other to mass
+        createNumericMsmt(&bmi, MDC_RATIO_MASS_BODY_LEN_SQ, false, MDC_DIM_KG_PER_M_SQ, false); // Create a numeric msmt for the BMI
+        setGhsMsmtRefs(&bmi, 2);                       // Make room for two references in the BMI; one to height, the other to mass
         bmi_index = addGhsMsmtToGroup(bmi, &msmtGroup);         // add the msmt to the group
-        result = createMsmtGroupDataArray(&msmtGroupScaleData, msmtGroup, sGhsTime); // Create the data packet and support info
+        createDoubleBufferedMsmtGroupDataArray(&msmtGroupScaleData, msmtGroup, sGhsTime); // Create the data packet and support info
+        LOG_MSMT_GROUP_TEMPLATE("scale", msmtGroupScaleData);  // The source of scaleGroupTemplate
         cleanUpMsmtGroup(&msmtGroup); // cleans up any allocated data -  we only need the data array now
     #endif  // Ear thermometer
-    #if (THERMOMETER == 1)
+    #if (THERMOMETER == 1 && USES_MSMT_GROUP_TEMPLATES == 1)
+        createMsmtGroupDataArrayFromTemplate(&msmtGroupTempData, &tempGroupTemplate, sGhsTime, &tempGroupStorage);
+        temp_index = getMsmtIndexOfType(msmtGroupTempData, MDC_TEMP_EAR);
+        ambient_index = getMsmtIndexOfType(msmtGroupTempData, MDC_TEMP_ROOM);
+    #elif (THERMOMETER == 1)
         // Create the msmt data group 
         s_MsmtGroup *msmtGroup = NULL;
         s_GhsMsmt *temp = NULL;
         s_GhsMsmt *ambient = NULL;
-        result = createMsmtGroup(&msmtGroup, (USES_TIMESTAMP == 1), 2); // 2 msmts - body temp & ambient temp
-        result = createNumericMsmt(&temp, MDC_TEMP_EAR, false, MDC_DIM_FAHR, false);
+        createMsmtGroup(&msmtGroup, (USES_TIMESTAMP == 1), 2); // 2 msmts - body temp & ambient temp
+        createNumericMsmt(&temp, MDC_TEMP_EAR, false, MDC_DIM_FAHR, false);
         temp_index = addGhsMsmtToGroup(temp, &msmtGroup);
-        result = createNumericMsmt(&ambient, MDC_TEMP_ROOM, false, MDC_DIM_FAHR, false);
+        createNumericMsmt(&ambient, MDC_TEMP_ROOM, false, MDC_DIM_FAHR, false);
         ambient_index = addGhsMsmtToGroup(ambient, &msmtGroup);
-        result = createMsmtGroupDataArray(&msmtGroupTempData, msmtGroup, sGhsTime);
+        createDoubleBufferedMsmtGroupDataArray(&msmtGroupTempData, msmtGroup, sGhsTime);
+        LOG_MSMT_GROUP_TEMPLATE("temp", msmtGroupTempData);  // The source of tempGroupTemplate
         cleanUpMsmtGroup(&msmtGroup); // cleans up any allocated data -  we only need the data array now
     #endif  // Ear thermometer
+    #if (THERMOMETER == 1)
+        addGroupFieldNumeric(&tempFieldMap, msmtGroupTempData, temp_index, 0, offsetof(s_MsmtData, temp), sizeof(unsigned short), false, -2);
+        addGroupFieldNumeric(&tempFieldMap, msmtGroupTempData, ambient_index, 0, offsetof(s_MsmtData, ambient), sizeof(unsigned short), false, -2);
+        addGroupFieldTimeStamp(&tempFieldMap, msmtGroupTempData, offsetof(s_MsmtData, common.sGhsTime.epoch),
+            offsetof(s_MsmtData, common.sGhsTime.flagKnownTimeline));
+    #endif
 }
 
 /**
@@ -1213,162 +1335,67 @@ void configureSpecializations(void)
 bool encodeSpecializationMsmts(s_MsmtData *msmt)
 {
     #if (BP_CUFF == 1)
-        s_MderFloat mder[3];                            // Since it the Blood Pressure we need to provide the three values
-                                                        // obtained from the sensors. This stage is a little tricky, as we
-                                                        // need to pass precision information and maintain that throughout the
-                                                        // transfer. The IEEE 11073 20601 SFLOAT and FLOATs are used. The
-                                                        // library will do this for you but you need to populate an s_MderFloat
-                                                        // struct for each value. We can see how that is done below.
         if (!prepareMeasurements(msmtGroupBpData, msmt->common.recordNumber)) return false;    // This method initalizes a structure needed for the send
                                                                     // method. This includes the length of the data array
                                                                     // and the characteristic it is to be notified on. The necessary
                                                                     // information is contained in the data array structure msmtGroupBpData.
                                                                     // The structure populated is the s_global_send structure.
                                                                     // Recall that this model is synchronous.
-
-        mder[0].mderFloatType = MDER_FLOAT;     // Now to create the Mder Floats. We are using 2-byte SFLOAT
-        mder[0].specialValue = MDER_NUMBER;     // This SFLOAT is going to be number versus a special value as a NAN, PINF r NINF
-        mder[0].exponent = 0;                   // The exponent of 0 means this is an integer with no decimal precison
-        mder[0].mantissa = msmt->systolic;        // This is the mantissa which is this case is the value retrieved from our fake sensors.
-                                                // Now if our sensors sent a systolic value with tenths precision, it would probably send
-                                                // an integer like 1232 to represent 123.2 since it is much easier to do. Then you would
-                                                // enter -1 in the exponent and 1232 in the mantissa. In the end, the value is given by
-                                                // mantissa * 10 ** exponent. However, the exponent has a further meaning of precision
-                                                // such that one can send either 2, 2.0, 2.00, etc. They are all the same value but indicate
-                                                // different sensor precisions.
-        mder[1].mderFloatType = MDER_FLOAT;
-        mder[1].specialValue = MDER_NUMBER;
-        mder[1].exponent = 0;
-        mder[1].mantissa = msmt->diastolic;       // Same as for systolic but for diastolic
-        mder[2].mderFloatType = MDER_FLOAT;
-        mder[2].specialValue = MDER_NUMBER;
-        mder[2].exponent = 0;
-        mder[2].mantissa = msmt->mean;            // Same as for systolic but for mean.
-
-        updateDataGhsMsmtRefs(&msmtGroupBpData, // This method may seem a little out of place, but it is to add the references to the
-                                                        // bp and pr measurements for the status event. Every GHS measurement has a unique
-                                                        // instance number over a connection, here given by msmt_id. The current msmt_id value
-                                                        // is going to be for the blood pressure measurement coming up so we add that value 
-                                                        // here to the status measurement
-                                      status_index,     // This status_index states we will add the msmt_id to status measurement reference list.
-                                      msmt_id,          // This is the reference instance
-                                      0);               // This is the index of the reference we are adding. At the start we allocated space
-                                                        // for two reference numbers. Here we are doing the first one. If the number is out of
-                                                        // bounds it wont get added.
-
-        updateDataCompound(&msmtGroupBpData,    // Now we update the data array with the blood pressure values. The method expects the
-                                                // measurement to be updated to be the configured compound thus 'updateDataCOMPOUND'
-                           bp_index,            // The bp_index indicates that the value update is to be done to the blood pressure. The
-                                                // method will check that the measurement is, in fact, a compound.
-                           mder,                // This is the array of s_MderFloats containing the bp values with their precision
-                           msmt_id++);          // This is the instance number for the bp measurement. We increment msmt_id to use in the
-                                                // next measurement
-        mder[0].mantissa = msmt->pulseRate;       // Now for the pulse rate. We will reuse the first of our s_MderFloats. All the supporting
-                                                // parameters are the same. We need only set the mantissa.
-
-        updateDataGhsMsmtRefs(&msmtGroupBpData, status_index, msmt_id, 1); // Now since the current msmt_id is going to be the instance
-                                                                                   // number for the pulse rate, we add that value to the status
-                                                                                   // measurement reference list. But it is now the second entry.
-        updateDataNumeric(&msmtGroupBpData,     // Now we update the pulse rate in the data array which is a numeric
-                          pr_index,             // Tells the updater which measurement in the group the pulse rate is
-                          &mder[0],             // The value of the pulse rate with precision
-                          msmt_id++);           // The instance number for the pulse rate which is then incremented.
-        if (msmt->hasStatus)
+        if (msmt->hasStatus && !reportStatus)   // Only send the status msmt if there is one. This is done here rather than when
+        {                                       // the msmt is queued so it only changes the buffer being updated, never the one
+            updateDataRestoreLastMsmt(&msmtGroupBpData);    // being sent.
+            reportStatus = true;
+        }
+        else if (!msmt->hasStatus && reportStatus)
         {
-            updateDataBits(&msmtGroupBpData,    // Now we update the status measurement which is a 16-bit event/state measurement
-                                                // Note we could check that the status flags are all zero. In that case we simply
-                                                // could skip sending this measurement. But in this demo we just toggle between
-                                                // sending the status and not sending it. Our fake data generator always generate status
-                                                // values. Hopefully a real device won't send status events all the time.
-                         status_index,                      // This status_index indicates that these updates are for the status measurement
-                         (msmt->status_cuff_too_loose         // These are the possible status flags that could have been set in our bp measurement.
-                        | msmt->status_improper_position
-                        | msmt->status_irregular_pulse
-                        | msmt->status_movement),
-                         msmt_id++);             // The instance number for the sensor status which is then incremented.
+            updateDataDropLastMsmt(&msmtGroupBpData);
+            reportStatus = false;
         }
-        updateTimeStampEpoch(&msmtGroupBpData,   // Now we call the update method to populate the time stamp. In our fake
-            msmt->common.sGhsTime.epoch);        // data generator we get the current clock tick, add it to the base-epoch
-                                                 // and place that into the bp measurement structure.
-        updateTimeStampTimeline(&msmtGroupBpData,       // In this app so far a change in the timeline will only happen for stored data.
-            msmt->common.sGhsTime.flagKnownTimeline);   // when the DK powercycles. The timeline of the stored data will be lost
-                                                        // This method will capture the time line change.
+
+        updateGroup(&msmtGroupBpData,   // Now we place the sensor values into the data array. The field map made in configureSpecializations()
+                    &bpFieldMap,        // says where each value of our s_MsmtData goes and how it is encoded, so this one call does what
+                    msmt,               // an updateDataCompound(), updateDataNumeric(), updateDataBits(), the status refs and the time stamp
+                    &msmt_id);          // updates did. The bp, pr and status msmts get the next msmt_ids in that order. The status values
+                                        // are skipped when the status msmt has been dropped above.
         NRF_LOG_DEBUG("Bp msmt to send");       // Now we have the data array to send to the client. In the main for-loop the send-Flag has been
                                                 // set which will cause this data to be sent.
     #endif
     #if (PULSE_OX == 1)
-        s_MderFloat mder;
-        mder.mderFloatType = MDER_FLOAT;
-        mder.specialValue = MDER_NUMBER;
         if (msmt->isContinuous)
         {
             s_MsmtGroupData *bytes = msmtGroupContData;
             if (!prepareMeasurements(bytes, 0)) return false;
-
-            mder.exponent = 0;
-            mder.mantissa = msmt->spo2;
-            updateDataNumeric(&bytes, spo2_cont_index, &mder, msmt_id++);
-            mder.mantissa = msmt->pulseRate;
-            updateDataNumeric(&bytes, pr_cont_index, &mder, msmt_id++);
-            mder.mantissa = msmt->pulseQuality;
-            mder.exponent = -2;
-            updateDataNumeric(&bytes, qual_cont_index, &mder, msmt_id++);
+            updateGroup(&bytes, &contFieldMap, msmt, &msmt_id);
             NRF_LOG_DEBUG("Continuous msmt to send");
         }
         else
         {
             if (!prepareMeasurements(msmtGroupSpotData, msmt->common.recordNumber)) return false;
-
-            mder.exponent = 0;
-            mder.mantissa = msmt->spo2;
-            updateDataNumeric(&msmtGroupSpotData, spo2_index, &mder, msmt_id++);
-            mder.mantissa = msmt->pulseRate;
-            updateDataNumeric(&msmtGroupSpotData, pr_index, &mder, msmt_id++);
-            mder.mantissa = msmt->pulseQuality;
-            mder.exponent = -2;
-            updateDataNumeric(&msmtGroupSpotData, qual_index, &mder, msmt_id++);
+            updateGroup(&msmtGroupSpotData, &spotFieldMap, msmt, &msmt_id);
             NRF_LOG_DEBUG("Spot msmt to send");
-            updateTimeStampEpoch(&msmtGroupSpotData, msmt->common.sGhsTime.epoch);
-            updateTimeStampTimeline(&msmtGroupSpotData, msmt->common.sGhsTime.flagKnownTimeline);
         }
     #endif
     #if (GLUCOSE == 1)
-        s_MderFloat mder;
         if (!prepareMeasurements(msmtGroupGlucData, msmt->common.recordNumber)) return false;
 
-        mder.specialValue = MDER_NUMBER;
-        mder.exponent = -1;
-        mder.mantissa = msmt->conc;
-        mder.mderFloatType = MDER_FLOAT;
-        unsigned short ref = msmt_id;
-        updateDataNumeric(&msmtGroupGlucData, conc_index, &mder, msmt_id++);
+        // The exponents are fixed so only the exponent part of each FLOAT folds at compile time
+        updateDataNumericFloat(&msmtGroupGlucData, conc_index, MDER_FLOAT_FROM_INTEGERS(-1, msmt->conc), msmt_id++);
         updateDataGhsMsmtSupplementalTypes(&msmtGroupGlucData, conc_index, msmt->meal_context, 0);
         updateDataGhsMsmtSupplementalTypes(&msmtGroupGlucData, conc_index, msmt->body_site, 1);
         updateDataGhsMsmtSupplementalTypes(&msmtGroupGlucData, conc_index, msmt->health, 2);
         updateDataGhsMsmtSupplementalTypes(&msmtGroupGlucData, conc_index, msmt->tester, 3);
-        mder.exponent = 0;
-        mder.mantissa = msmt->carbs;
-        updateDataNumeric(&msmtGroupGlucData, carbs_index, &mder, msmt_id++);
+        updateDataNumericFloat(&msmtGroupGlucData, carbs_index, MDER_FLOAT_FROM_INTEGERS(0, msmt->carbs), msmt_id++);
         updateDataGhsMsmtSupplementalTypes(&msmtGroupGlucData, carbs_index, msmt->carbs_type, 0);
-        mder.exponent = -1;
-        mder.mantissa = msmt->meds;
-        updateDataNumeric(&msmtGroupGlucData, meds_index, &mder, msmt_id++);
+        updateDataNumericFloat(&msmtGroupGlucData, meds_index, MDER_FLOAT_FROM_INTEGERS(-1, msmt->meds), msmt_id++);
         updateDataGhsMsmtSupplementalTypes(&msmtGroupGlucData, meds_index, msmt->medication_type, 0);
-        mder.exponent = 0;
-        mder.mantissa = msmt->exer;
-        updateDataNumeric(&msmtGroupGlucData, exer_index, &mder, msmt_id++);
+        updateDataNumericFloat(&msmtGroupGlucData, exer_index, MDER_FLOAT_FROM_INTEGERS(0, msmt->exer), msmt_id++);
         updateTimeStampEpoch(&msmtGroupGlucData, msmt->common.sGhsTime.epoch);
         updateTimeStampTimeline(&msmtGroupGlucData, msmt->common.sGhsTime.flagKnownTimeline);
         NRF_LOG_DEBUG("Bp msmt to send");
     #endif
     #if (HEART_RATE == 1)
-        s_MderFloat mder;
         if (!prepareMeasurements(msmtGroupHrData, 0)) return false;
-        mder.specialValue = MDER_NUMBER;
-        mder.exponent = 0;
-        mder.mantissa = msmt->heartRate;
-        mder.mderFloatType = MDER_FLOAT;
-        updateDataNumeric(&msmtGroupHrData, hr_index, &mder, msmt_id++);
+        updateGroup(&msmtGroupHrData, &hrFieldMap, msmt, &msmt_id);
     #endif
     // We are not generating the measurements on the fly as in the other cases, it is all pre done
     // except for the time stamps.
@@ -1420,40 +1447,27 @@ bool encodeSpecializationMsmts(s_MsmtData *msmt)
             NRF_LOG_DEBUG("Sending Spirometer Maneuver data");
             updateTimeStampEpoch(&msmtGroupSpiroManeuvData, session->common.sGhsTime.epoch);
             updateDataHeaderRefs(&msmtGroupSpiroManeuvData, sub_session_id, 0);
-            s_MderFloat mder;
-            mder.exponent = -3;
-            mder.mantissa = fev1Val;
-            mder.mderFloatType = MDER_FLOAT;
-            mder.specialValue = MDER_NUMBER;
             fev1_ids[fev1_id_index] = msmt_id;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fev1_index, &mder, msmt_id++);
-            mder.mantissa = fev6Val;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fev6_index, &mder, msmt_id++);
-            mder.mantissa = fvcVal;
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fev1_index, MDER_FLOAT_FROM_INTEGERS(-3, fev1Val), msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fev6_index, MDER_FLOAT_FROM_INTEGERS(-3, fev6Val), msmt_id++);
             fvc_ids[fvc_id_index] = msmt_id;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fvc_index, &mder, msmt_id++);
-            mder.mantissa = pefVal;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, pef_index, &mder, msmt_id++);
-            mder.mantissa = fetVal;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fet_index, &mder, msmt_id++);
-            mder.mantissa = fev1z_val;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fev1z_index, &mder, msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fvc_index, MDER_FLOAT_FROM_INTEGERS(-3, fvcVal), msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, pef_index, MDER_FLOAT_FROM_INTEGERS(-3, pefVal), msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fet_index, MDER_FLOAT_FROM_INTEGERS(-3, fetVal), msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fev1z_index, MDER_FLOAT_FROM_INTEGERS(-3, fev1z_val), msmt_id++);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1z_index, fev1_ids[fev1_id_index], 0);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1z_index, settings_id[0], 1);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1z_index, settings_id[1], 2);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1z_index, settings_id[2], 3);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1z_index, settings_id[3], 4);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1z_index, settings_id[4], 5);
-            mder.mantissa = fev1_lln_val;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fev1_lln_index, &mder, msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fev1_lln_index, MDER_FLOAT_FROM_INTEGERS(-3, fev1_lln_val), msmt_id++);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_lln_index, settings_id[0], 0);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_lln_index, settings_id[1], 1);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_lln_index, settings_id[2], 2);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_lln_index, settings_id[3], 3);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_lln_index, settings_id[4], 4);
-            mder.mantissa = fev1_percent_pred_val;
-            mder.exponent = -1;
-            updateDataNumeric(&msmtGroupSpiroManeuvData, fev1_percent_pred_index, &mder, msmt_id++);
+            updateDataNumericFloat(&msmtGroupSpiroManeuvData, fev1_percent_pred_index, MDER_FLOAT_FROM_INTEGERS(-1, fev1_percent_pred_val), msmt_id++);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_percent_pred_index, fev1_ids[fev1_id_index], 0);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_percent_pred_index, settings_id[0], 1);
             updateDataGhsMsmtRefs(&msmtGroupSpiroManeuvData, fev1_percent_pred_index, settings_id[1], 2);
@@ -1503,36 +1517,20 @@ bool encodeSpecializationMsmts(s_MsmtData *msmt)
     #endif
     #if (THERMOMETER == 1)
         if (!prepareMeasurements(msmtGroupTempData, msmt->common.recordNumber)) return false;
-        s_MderFloat mder;
-        mder.mderFloatType = MDER_FLOAT;
-        mder.specialValue = MDER_NUMBER;
-        mder.exponent = -2;
-        mder.mantissa = msmt->temp;
-        updateDataNumeric(&msmtGroupTempData, temp_index, &mder, msmt_id++);
-        mder.exponent = -2;
-        mder.mantissa = msmt->ambient;
-        updateDataNumeric(&msmtGroupTempData, ambient_index, &mder, msmt_id++);
-        updateTimeStampEpoch(&msmtGroupTempData, msmt->common.sGhsTime.epoch);
-        updateTimeStampTimeline(&msmtGroupTempData, msmt->common.sGhsTime.flagKnownTimeline);
+        updateGroup(&msmtGroupTempData, &tempFieldMap, msmt, &msmt_id);
         NRF_LOG_DEBUG("Temperature msmt to send");
     #endif  // Ear thermometer
     #if (SCALE == 1)
         if (scale_sequence > 0)
         {
             if (!prepareMeasurements(msmtGroupScaleData, msmt->common.recordNumber)) return false;
-            s_MderFloat mder;
-            mder.mderFloatType = MDER_FLOAT;
-            mder.specialValue = MDER_NUMBER;
-            mder.exponent = -2;
-            mder.mantissa = msmt->mass;
             updateDataGhsMsmtRefs(&msmtGroupScaleData, bmi_index, msmt_id, 0);      // Add the references, this is the body mass
             updateDataGhsMsmtRefs(&msmtGroupScaleData, bmi_index, height_ref, 1);   // and this is the height
-            updateDataNumeric(&msmtGroupScaleData, mass_index, &mder, msmt_id++);
+            updateDataNumericFloat(&msmtGroupScaleData, mass_index, MDER_FLOAT_FROM_INTEGERS(-2, msmt->mass), msmt_id++);
             unsigned long bmi = (unsigned long)msmt->mass;
             unsigned long div = HEIGHT * HEIGHT / 100;
             bmi = (bmi) * 10000 /div; // kg/m*m    mass * 100 *100 / (mm * mm )
-            mder.mantissa = bmi;
-            updateDataNumeric(&msmtGroupScaleData, bmi_index, &mder, msmt_id);  // Not using msmt_id - don't increment
+            updateDataNumericFloat(&msmtGroupScaleData, bmi_index, MDER_FLOAT_FROM_INTEGERS(-2, bmi), msmt_id);  // Not using msmt_id - don't increment
             updateTimeStampEpoch(&msmtGroupScaleData, msmt->common.sGhsTime.epoch);
             updateTimeStampTimeline(&msmtGroupScaleData, msmt->common.sGhsTime.flagKnownTimeline);
             NRF_LOG_DEBUG("Weight msmt to send with mass %lu div %lu bmi %lu", msmt->mass, div, bmi);
@@ -1550,6 +1548,225 @@ bool encodeSpecializationMsmts(s_MsmtData *msmt)
     return true;
 }
 
+#if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+/*
+ * Stored measurements are kept in flash in packed form so that thousands of them fit (see btle_utils.c).
+ * The common part comes first: the record number, the 48-bit epoch, the time flags, the time sync and the
+ * offset. The low bits of the time flags hold the storedTimelines entry the measurement is on and the
+ * epoch is kept relative to the base of that timeline; resolveStoredMsmtTime() adds the base and the time
+ * sync of the timeline once read. Set time only changes the entry of the current timeline, so addStoredMsmt()
+ * takes the base off a new msmt with baseStoredMsmtTime() before it is packed. The clock
+ * type and resolution are the same for every measurement and are taken from sGhsTime on unpacking. The specialization values follow, little endian. STORED_MSMT_PACKED_SIZE
+ * in handleSpecializations.h is the length of what is written here; if you change your s_MsmtData struct,
+ * change these methods and that size with it.
+ */
+#define STORED_MSMT_COMMON_PACKED_SIZE 13
+
+static unsigned short twoByteDecode(unsigned char *buf, int index)
+{
+    return (unsigned short)(buf[index] | (buf[index + 1] << 8));
+}
+
+static unsigned long fourByteDecode(unsigned char *buf, int index)
+{
+    return (unsigned long)buf[index] | ((unsigned long)buf[index + 1] << 8)
+        | ((unsigned long)buf[index + 2] << 16) | ((unsigned long)buf[index + 3] << 24);
+}
+
+static int packStoredMsmtCommon(s_MsmtCommon *common, unsigned char *buf)
+{
+    int i;
+    unsigned long long epoch = common->sGhsTime.epoch;
+    int index = fourByteEncode(buf, 0, common->recordNumber);
+    for (i = 0; i < 6; i++)
+    {
+        buf[index++] = (unsigned char)(epoch & 0xFF);
+        epoch = (epoch >> 8);
+    }
+    buf[index++] = (common->timeline & STORED_TIMELINE_ID_MASK) | common->sGhsTime.flagSupportsOffset;
+    buf[index++] = common->sGhsTime.timeSync;
+    buf[index++] = (unsigned char)(common->sGhsTime.offsetShift & 0xFF);
+    return index;
+}
+
+static int unpackStoredMsmtCommon(unsigned char *buf, s_MsmtCommon *common)
+{
+    common->hasTimeStamp = true;
+    common->isStoredData = true;
+    common->recordNumber = fourByteDecode(buf, 0);
+    common->sGhsTime.epoch = getEpochFromBytes(&buf[4]);
+    common->timeline = buf[10] & STORED_TIMELINE_ID_MASK;
+    common->sGhsTime.flagKnownTimeline = (common->timeline == storedTimelines.current) ? GHS_TIME_FLAG_ON_CURRENT_TIMELINE : 0;
+    common->sGhsTime.flagSupportsOffset = buf[10] & GHS_TIME_FLAG_SUPPORTS_TIMEZONE;
+    common->sGhsTime.timeSync = buf[11];
+    common->sGhsTime.offsetShift = (buf[12] == GHS_TIME_OFFSET_UNSUPPORTED) ? GHS_TIME_OFFSET_UNSUPPORTED : (short)(signed char)buf[12];
+    common->sGhsTime.clockType = sGhsTime->clockType;
+    common->sGhsTime.clockResolution = sGhsTime->clockResolution;
+    return STORED_MSMT_COMMON_PACKED_SIZE;
+}
+
+void packStoredMsmt(s_MsmtData *msmt, unsigned char *buf)
+{
+    int index = packStoredMsmtCommon(&msmt->common, buf);
+    #if (BP_CUFF == 1)
+        index = twoByteEncode(buf, index, msmt->systolic);
+        index = twoByteEncode(buf, index, msmt->diastolic);
+        index = twoByteEncode(buf, index, msmt->mean);
+        index = twoByteEncode(buf, index, msmt->pulseRate);
+        // Each status field holds its own BP_STATUS_* bit when set, so they all fit in one byte
+        buf[index++] = (msmt->hasStatus ? 0x80 : 0) | (unsigned char)(msmt->status_movement | msmt->status_cuff_too_loose
+            | msmt->status_irregular_pulse | msmt->status_pulse_under_limit | msmt->status_pulse_over_limit
+            | msmt->status_improper_position);
+    #endif
+    #if (PULSE_OX == 1)
+        buf[index++] = msmt->isContinuous ? 1 : 0;
+        index = twoByteEncode(buf, index, msmt->spo2);
+        index = twoByteEncode(buf, index, msmt->pulseRate);
+        index = twoByteEncode(buf, index, msmt->pulseQuality);
+    #endif
+    #if (GLUCOSE == 1)
+        index = fourByteEncode(buf, index, msmt->meal_context);
+        index = fourByteEncode(buf, index, msmt->tester);
+        index = fourByteEncode(buf, index, msmt->body_site);
+        index = fourByteEncode(buf, index, msmt->health);
+        index = fourByteEncode(buf, index, msmt->medication_type);
+        index = fourByteEncode(buf, index, msmt->carbs_type);
+        index = twoByteEncode(buf, index, msmt->conc);
+        index = twoByteEncode(buf, index, msmt->carbs);
+        index = twoByteEncode(buf, index, msmt->meds);
+        index = twoByteEncode(buf, index, msmt->exer);
+        index = twoByteEncode(buf, index, msmt->duration);
+    #endif
+    #if (SCALE == 1)
+        index = twoByteEncode(buf, index, msmt->mass);
+    #endif
+    #if (THERMOMETER == 1)
+        index = twoByteEncode(buf, index, msmt->temp);
+        index = twoByteEncode(buf, index, msmt->ambient);
+    #endif
+}
+
+void unpackStoredMsmt(unsigned char *buf, s_MsmtData *msmt)
+{
+    memset(msmt, 0, sizeof(s_MsmtData));
+    int index = unpackStoredMsmtCommon(buf, &msmt->common);
+    #if (BP_CUFF == 1)
+        msmt->systolic = twoByteDecode(buf, index);
+        msmt->diastolic = twoByteDecode(buf, index + 2);
+        msmt->mean = twoByteDecode(buf, index + 4);
+        msmt->pulseRate = twoByteDecode(buf, index + 6);
+        msmt->hasStatus = ((buf[index + 8] & 0x80) == 0x80);
+        msmt->status_movement = buf[index + 8] & BP_STATUS_MOVEMENT;
+        msmt->status_cuff_too_loose = buf[index + 8] & BP_STATUS_CUFF_TOO_LOOSE;
+        msmt->status_irregular_pulse = buf[index + 8] & BP_STATUS_IRREGULAR_PULSE;
+        msmt->status_pulse_under_limit = buf[index + 8] & BP_STATUS_PULSE_UNDER_LIMIT;
+        msmt->status_pulse_over_limit = buf[index + 8] & BP_STATUS_PULSE_OVER_LIMIT;
+        msmt->status_improper_position = buf[index + 8] & BP_STATUS_IMPROPER_POSITION;
+    #endif
+    #if (PULSE_OX == 1)
+        msmt->isContinuous = (buf[index] == 1);
+        msmt->spo2 = twoByteDecode(buf, index + 1);
+        msmt->pulseRate = twoByteDecode(buf, index + 3);
+        msmt->pulseQuality = twoByteDecode(buf, index + 5);
+    #endif
+    #if (GLUCOSE == 1)
+        msmt->meal_context = fourByteDecode(buf, index);
+        msmt->tester = fourByteDecode(buf, index + 4);
+        msmt->body_site = fourByteDecode(buf, index + 8);
+        msmt->health = fourByteDecode(buf, index + 12);
+        msmt->medication_type = fourByteDecode(buf, index + 16);
+        msmt->carbs_type = fourByteDecode(buf, index + 20);
+        msmt->conc = twoByteDecode(buf, index + 24);
+        msmt->carbs = twoByteDecode(buf, index + 26);
+        msmt->meds = twoByteDecode(buf, index + 28);
+        msmt->exer = twoByteDecode(buf, index + 30);
+        msmt->duration = twoByteDecode(buf, index + 32);
+    #endif
+    #if (SCALE == 1)
+        msmt->mass = twoByteDecode(buf, index);
+    #endif
+    #if (THERMOMETER == 1)
+        msmt->temp = twoByteDecode(buf, index);
+        msmt->ambient = twoByteDecode(buf, index + 2);
+    #endif
+}
+
+// Adds the base and time sync of the timeline of an unpacked msmt. Fixups are applied before this
+void resolveStoredMsmtTime(s_MsmtData *msmt)
+{
+    s_StoredTimeline *timeline = &storedTimelines.timeline[msmt->common.timeline];
+    msmt->common.sGhsTime.epoch = (msmt->common.sGhsTime.epoch + timeline->base) & 0xFFFFFFFFFFFFULL;
+    if (timeline->timeSync != STORED_TIMELINE_SYNC_NONE)
+    {
+        msmt->common.sGhsTime.timeSync = timeline->timeSync;
+    }
+}
+
+// The inverse of resolveStoredMsmtTime() for a new msmt: its epoch is on the current clock, which already
+// includes every set time folded into the base of its timeline, so the base is taken off before it is stored
+void baseStoredMsmtTime(s_MsmtData *msmt)
+{
+    s_StoredTimeline *timeline = &storedTimelines.timeline[msmt->common.timeline];
+    msmt->common.sGhsTime.epoch = (msmt->common.sGhsTime.epoch - timeline->base) & 0xFFFFFFFFFFFFULL;
+}
+
+// Msmts on a retired timeline take the time it gives them; the base of STORED_TIMELINE_RETIRED is 0
+void applyStoredMsmtFixup(s_MsmtData *msmt, s_StoredMsmtFixup *fixup)
+{
+    if (!fixup->active || (fixup->retire & (1 << msmt->common.timeline)) == 0)
+    {
+        return;
+    }
+    resolveStoredMsmtTime(msmt);
+    msmt->common.timeline = STORED_TIMELINE_RETIRED;
+    msmt->common.sGhsTime.flagKnownTimeline = 0;
+}
+
+// Makes fixup do what applying fixup and then 'then' does
+void composeStoredMsmtFixup(s_StoredMsmtFixup *fixup, s_StoredMsmtFixup *then)
+{
+    fixup->retire = (fixup->active ? fixup->retire : 0) | then->retire;
+    fixup->active = true;
+}
+
+// The msmts of the retired timelines have all moved, so their entries can be used again
+void storedMsmtFixupDone(s_StoredMsmtFixup *fixup)
+{
+    unsigned char i;
+    for (i = 0; i < STORED_TIMELINES; i++)
+    {
+        if ((fixup->retire & (1 << i)) != 0 && storedTimelines.timeline[i].state == STORED_TIMELINE_RETIRING)
+        {
+            storedTimelines.timeline[i].state = STORED_TIMELINE_FREE;
+            storedTimelinesChanged = true;
+        }
+    }
+}
+
+// Starts moving the msmts of the given timelines to STORED_TIMELINE_RETIRED
+static void retireStoredTimelines(unsigned char retire)
+{
+    s_StoredMsmtFixup fixup = { .active = true, .retire = retire };
+    if (!fixupStoredMsmts(&fixup))
+    {
+        storedMsmtFixupDone(&fixup);    // None of them are in flash
+    }
+}
+
+static unsigned char findFreeStoredTimeline(void)
+{
+    unsigned char i;
+    for (i = 0; i < STORED_TIMELINES; i++)
+    {
+        if (i != STORED_TIMELINE_RETIRED && storedTimelines.timeline[i].state == STORED_TIMELINE_FREE)
+        {
+            return i;
+        }
+    }
+    return STORED_TIMELINE_RETIRED;
+}
+#endif
+
 /**
  * This method generates fake data on the push of button 4 on the DK and stores it. There is no
  * stored data option for the Spirometer...it's too hard to generate fake spirometer data that is
@@ -1561,329 +1778,363 @@ bool encodeSpecializationMsmts(s_MsmtData *msmt)
 #if (USES_STORED_DATA >= 1)
 bool generateAndAddStoredMsmt(unsigned long long timeStampMsmt, unsigned long timeStamp, unsigned short numberOfStoredMsmtGroups)
 {
+    s_MsmtData msmt;
+
+    memset(&msmt, 0, sizeof(s_MsmtData));
+    msmt.common.timeline = storedTimelines.current;
     #if (BP_CUFF == 1)
-        storedMsmts[numberOfStoredMsmtGroups].common.hasTimeStamp = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.isStoredData = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.recordNumber = recordNumber++;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.epoch = epoch + timeStampMsmt;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.offsetShift = sGhsTime->offsetShift;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.timeSync = sGhsTime->timeSync;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockType = sGhsTime->clockType;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockResolution = sGhsTime->clockResolution;
-        storedMsmts[numberOfStoredMsmtGroups].systolic = 95 + (timeStamp & 0x0F);
-        storedMsmts[numberOfStoredMsmtGroups].diastolic = 55 + (timeStamp & 0x0F);
-        storedMsmts[numberOfStoredMsmtGroups].mean = 
-            (storedMsmts[numberOfStoredMsmtGroups].systolic +
-             storedMsmts[numberOfStoredMsmtGroups].diastolic) / 2;
-        storedMsmts[numberOfStoredMsmtGroups].pulseRate = 40 + (timeStamp & 0x07);
-        storedMsmts[numberOfStoredMsmtGroups].hasStatus = ((storedMsmts[numberOfStoredMsmtGroups].mean & 0x01) == 0x01);
-        if (storedMsmts[numberOfStoredMsmtGroups].hasStatus)
+        msmt.common.hasTimeStamp = true;
+        msmt.common.isStoredData = true;
+        msmt.common.recordNumber = recordNumber++;
+        msmt.common.sGhsTime.epoch = epoch + timeStampMsmt;
+        msmt.common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
+        msmt.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
+        msmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
+        msmt.common.sGhsTime.clockType = sGhsTime->clockType;
+        msmt.common.sGhsTime.clockResolution = sGhsTime->clockResolution;
+        msmt.systolic = 95 + (timeStamp & 0x0F);
+        msmt.diastolic = 55 + (timeStamp & 0x0F);
+        msmt.mean = 
+            (msmt.systolic +
+             msmt.diastolic) / 2;
+        msmt.pulseRate = 40 + (timeStamp & 0x07);
+        msmt.hasStatus = ((msmt.mean & 0x01) == 0x01);
+        if (msmt.hasStatus)
         {
             unsigned short stat = (timeStamp & 0x3F);
-            storedMsmts[numberOfStoredMsmtGroups].status_cuff_too_loose = (stat & BP_STATUS_CUFF_TOO_LOOSE);
-            storedMsmts[numberOfStoredMsmtGroups].status_improper_position = (stat & BP_STATUS_IMPROPER_POSITION);
-            storedMsmts[numberOfStoredMsmtGroups].status_irregular_pulse = (stat & BP_STATUS_IRREGULAR_PULSE);
-            storedMsmts[numberOfStoredMsmtGroups].status_movement = (stat & BP_STATUS_MOVEMENT);
+            msmt.status_cuff_too_loose = (stat & BP_STATUS_CUFF_TOO_LOOSE);
+            msmt.status_improper_position = (stat & BP_STATUS_IMPROPER_POSITION);
+            msmt.status_irregular_pulse = (stat & BP_STATUS_IRREGULAR_PULSE);
+            msmt.status_movement = (stat & BP_STATUS_MOVEMENT);
         }
         NRF_LOG_INFO("Measurement added: sys %u, dia %u, mean %u, PR %u, timestamp %llu", 
-                storedMsmts[numberOfStoredMsmtGroups].systolic,
-                storedMsmts[numberOfStoredMsmtGroups].diastolic,
-                storedMsmts[numberOfStoredMsmtGroups].mean,
-                storedMsmts[numberOfStoredMsmtGroups].pulseRate, 
-                storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.epoch, timeStamp);
-        return true;
+                msmt.systolic,
+                msmt.diastolic,
+                msmt.mean,
+                msmt.pulseRate, 
+                msmt.common.sGhsTime.epoch, timeStamp);
+        return addStoredMsmt(&msmt, timeStampMsmt);
     #endif
     #if (PULSE_OX == 1)
-        storedMsmts[numberOfStoredMsmtGroups].common.hasTimeStamp = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.isStoredData = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.recordNumber = recordNumber++;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.epoch = epoch + timeStampMsmt;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.offsetShift = sGhsTime->offsetShift;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.timeSync = sGhsTime->timeSync;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockType = sGhsTime->clockType;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockResolution = sGhsTime->clockResolution;
-
-        storedMsmts[numberOfStoredMsmtGroups].spo2 = 95 + (timeStamp & 0x03);
-        storedMsmts[numberOfStoredMsmtGroups].pulseRate = 45 + (timeStamp & 0x07);
-        storedMsmts[numberOfStoredMsmtGroups].pulseQuality = 523 + (timeStamp & 0xFF);
+        msmt.common.hasTimeStamp = true;
+        msmt.common.isStoredData = true;
+        msmt.common.recordNumber = recordNumber++;
+        msmt.common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
+        msmt.common.sGhsTime.epoch = epoch + timeStampMsmt;
+        msmt.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
+        msmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
+        msmt.common.sGhsTime.clockType = sGhsTime->clockType;
+        msmt.common.sGhsTime.clockResolution = sGhsTime->clockResolution;
+
+        msmt.spo2 = 95 + (timeStamp & 0x03);
+        msmt.pulseRate = 45 + (timeStamp & 0x07);
+        msmt.pulseQuality = 523 + (timeStamp & 0xFF);
 
         NRF_LOG_INFO("Measurement added: SpO2 %u%, PR %u, Pulsatile X 100 %u%, timestamp %lu", 
-            storedMsmts[numberOfStoredMsmtGroups].spo2, 
-            storedMsmts[numberOfStoredMsmtGroups].pulseRate,
-            storedMsmts[numberOfStoredMsmtGroups].pulseQuality, timeStamp);
-        return true;
+            msmt.spo2, 
+            msmt.pulseRate,
+            msmt.pulseQuality, timeStamp);
+        return addStoredMsmt(&msmt, timeStampMsmt);
     #endif
     #if (GLUCOSE == 1)
 
-        storedMsmts[numberOfStoredMsmtGroups].common.hasTimeStamp = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.isStoredData = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.recordNumber = recordNumber++;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.epoch = epoch + timeStampMsmt;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.offsetShift = sGhsTime->offsetShift;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.timeSync = sGhsTime->timeSync;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockType = sGhsTime->clockType;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockResolution = sGhsTime->clockResolution;
-        storedMsmts[numberOfStoredMsmtGroups].conc = (95 + (timeStamp & 0x1F)) * 10;
-        storedMsmts[numberOfStoredMsmtGroups].body_site = MDC_CTXT_GLU_SAMPLELOCATION_FINGER + (timeStamp & 0x03) * 4;
-        storedMsmts[numberOfStoredMsmtGroups].meal_context = MDC_CTXT_GLU_MEAL_PREPRANDIAL + (timeStamp & 0x03) * 4;
-        storedMsmts[numberOfStoredMsmtGroups].health = MDC_CTXT_GLU_HEALTH_MINOR + (timeStamp & 0x03) * 4;
-        storedMsmts[numberOfStoredMsmtGroups].tester = MDC_CTXT_GLU_TESTER_SELF + (timeStamp & 0x04);
-        storedMsmts[numberOfStoredMsmtGroups].carbs = 150 + (timeStamp & 0x7F);
-        storedMsmts[numberOfStoredMsmtGroups].carbs_type = MDC_CTXT_GLU_CARB_BREAKFAST + (timeStamp & 0x03) * 4;
-        storedMsmts[numberOfStoredMsmtGroups].meds = 100 + (timeStamp & 0x0F); // IU times 10
-        storedMsmts[numberOfStoredMsmtGroups].medication_type = MDC_CTXT_MEDICATION_RAPIDACTING + (timeStamp & 0x03) * 4;
-        storedMsmts[numberOfStoredMsmtGroups].exer = 60 + (timeStamp & 0x1F);
+        msmt.common.hasTimeStamp = true;
+        msmt.common.isStoredData = true;
+        msmt.common.recordNumber = recordNumber++;
+        msmt.common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
+        msmt.common.sGhsTime.epoch = epoch + timeStampMsmt;
+        msmt.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
+        msmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
+        msmt.common.sGhsTime.clockType = sGhsTime->clockType;
+        msmt.common.sGhsTime.clockResolution = sGhsTime->clockResolution;
+        msmt.conc = (95 + (timeStamp & 0x1F)) * 10;
+        msmt.body_site = MDC_CTXT_GLU_SAMPLELOCATION_FINGER + (timeStamp & 0x03) * 4;
+        msmt.meal_context = MDC_CTXT_GLU_MEAL_PREPRANDIAL + (timeStamp & 0x03) * 4;
+        msmt.health = MDC_CTXT_GLU_HEALTH_MINOR + (timeStamp & 0x03) * 4;
+        msmt.tester = MDC_CTXT_GLU_TESTER_SELF + (timeStamp & 0x04);
+        msmt.carbs = 150 + (timeStamp & 0x7F);
+        msmt.carbs_type = MDC_CTXT_GLU_CARB_BREAKFAST + (timeStamp & 0x03) * 4;
+        msmt.meds = 100 + (timeStamp & 0x0F); // IU times 10
+        msmt.medication_type = MDC_CTXT_MEDICATION_RAPIDACTING + (timeStamp & 0x03) * 4;
+        msmt.exer = 60 + (timeStamp & 0x1F);
         NRF_LOG_INFO("Measurement added: conc %u, carbs %u, meds %u, exer %u, timestamp %lu", 
-                storedMsmts[numberOfStoredMsmtGroups].conc,
-                storedMsmts[numberOfStoredMsmtGroups].carbs,
-                storedMsmts[numberOfStoredMsmtGroups].meds,
-                storedMsmts[numberOfStoredMsmtGroups].exer, 
+                msmt.conc,
+                msmt.carbs,
+                msmt.meds,
+                msmt.exer, 
                 timeStamp);
-        return true;
+        return addStoredMsmt(&msmt, timeStampMsmt);
     #endif
    #if (SCALE == 1)
-        storedMsmts[numberOfStoredMsmtGroups].common.hasTimeStamp = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.isStoredData = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.recordNumber = recordNumber++;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.epoch = epoch + timeStampMsmt;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.offsetShift = sGhsTime->offsetShift;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockType = sGhsTime->clockType;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockResolution = sGhsTime->clockResolution;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.timeSync = sGhsTime->timeSync;
-        storedMsmts[numberOfStoredMsmtGroups].mass = 6800 + (timeStamp & 0xFF);
+        msmt.common.hasTimeStamp = true;
+        msmt.common.isStoredData = true;
+        msmt.common.recordNumber = recordNumber++;
+        msmt.common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
+        msmt.common.sGhsTime.epoch = epoch + timeStampMsmt;
+        msmt.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
+        msmt.common.sGhsTime.clockType = sGhsTime->clockType;
+        msmt.common.sGhsTime.clockResolution = sGhsTime->clockResolution;
+        msmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
+        msmt.mass = 6800 + (timeStamp & 0xFF);
 
         NRF_LOG_INFO("Measurement added: Weight %u%, timestamp %lu", 
-            storedMsmts[numberOfStoredMsmtGroups].mass, timeStamp);
-        return true;
+            msmt.mass, timeStamp);
+        return addStoredMsmt(&msmt, timeStampMsmt);
     #endif
     #if (THERMOMETER == 1)
-        storedMsmts[numberOfStoredMsmtGroups].common.hasTimeStamp = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.isStoredData = true;
-        storedMsmts[numberOfStoredMsmtGroups].common.recordNumber = recordNumber++;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.epoch = epoch + timeStampMsmt;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.offsetShift = sGhsTime->offsetShift;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.timeSync = sGhsTime->timeSync;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockType = sGhsTime->clockType;
-        storedMsmts[numberOfStoredMsmtGroups].common.sGhsTime.clockResolution = sGhsTime->clockResolution;
-        storedMsmts[numberOfStoredMsmtGroups].temp = 9800 + (timeStamp & 0xFF);
-        storedMsmts[numberOfStoredMsmtGroups].ambient = 7200 + (timeStamp & 0x1FF);
+        msmt.common.hasTimeStamp = true;
+        msmt.common.isStoredData = true;
+        msmt.common.recordNumber = recordNumber++;
+        msmt.common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
+        msmt.common.sGhsTime.epoch = epoch + timeStampMsmt;
+        msmt.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
+        msmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
+        msmt.common.sGhsTime.clockType = sGhsTime->clockType;
+        msmt.common.sGhsTime.clockResolution = sGhsTime->clockResolution;
+        msmt.temp = 9800 + (timeStamp & 0xFF);
+        msmt.ambient = 7200 + (timeStamp & 0x1FF);
 
         NRF_LOG_INFO("Measurement added: Temperature %u%, ambient temperature %u, timestamp %lu", 
-            storedMsmts[numberOfStoredMsmtGroups].temp, storedMsmts[numberOfStoredMsmtGroups].ambient, timeStamp);
-        return true;
+            msmt.temp, msmt.ambient, timeStamp);
+        return addStoredMsmt(&msmt, timeStampMsmt);
     #endif
     return false;
     // No stored data generated for Spirometer
 }
 
-// It is assumed this method is called only if the operation is supported.
-unsigned short getNumberOfStoredRecords(unsigned char* cmd, unsigned short len)
+// Returns the record number or the epoch of a stored record, whichever RACP operand type is asked for
+static unsigned long long getStoredRecordKey(unsigned short index, unsigned char operandType)
 {
-    if (numberOfStoredMsmtGroups == 0)
+    s_MsmtData msmt;
+    if (!getStoredMsmt(index, &msmt))
     {
-        return numberOfStoredMsmtGroups;
+        return 0;
     }
-    s_MsmtCommon *common = &storedMsmts[0].common;
-    switch(cmd[1])
+    return (operandType == RACP_RECORD_NUM) ? msmt.common.recordNumber : msmt.common.sGhsTime.epoch;
+}
+
+/*
+ * Binary search of the stored records from low up to high for the first one whose key is >= value,
+ * or > value if after is set. Record numbers only ever increase though deleted records leave gaps. The
+ * epochs increase with them within the records of one timeline as set time moves all of them by the
+ * same amount. Returns high if there is no such record. Each probe unpacks one record.
+ */
+static unsigned short searchStoredRecords(unsigned short low, unsigned short high, unsigned char operandType,
+    unsigned long long value, bool after)
+{
+    while (low < high)
     {
-        case RACP_ALL:
-            return numberOfStoredMsmtGroups;
-        
-        case RACP_GTE:
+        unsigned short mid = low + (high - low) / 2;
+        unsigned long long key = getStoredRecordKey(mid, operandType);
+        if (key < value || (after && key == value))
         {
-            if (cmd[2] == RACP_RECORD_NUM && len >= 7)
-            {
-                unsigned long recordNumber = (unsigned long)cmd[3] + ((unsigned long)cmd[4] << 8)
-                    + ((unsigned long)cmd[5] << 16) + ((unsigned long)cmd[6] << 24);
-                if (recordNumber < common->recordNumber)
-                {
-                    return numberOfStoredMsmtGroups;
-                }
-                else if (recordNumber > storedMsmts[numberOfStoredMsmtGroups - 1].common.recordNumber)
-                {
-                    return 0;
-                }
-                return numberOfStoredMsmtGroups - (recordNumber - common->recordNumber);
-            }      
-            if (cmd[2] == RACP_TIMESTAMP && len >= 9)
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Decodes a record number or timestamp operand. Returns false if the command is too short for it
+static bool getRacpOperand(unsigned char* cmd, unsigned short len, unsigned short offset, unsigned long long *value)
+{
+    if (cmd[2] == RACP_RECORD_NUM && len >= offset + 4)
+    {
+        *value = (unsigned long long)cmd[offset] + ((unsigned long long)cmd[offset + 1] << 8)
+            + ((unsigned long long)cmd[offset + 2] << 16) + ((unsigned long long)cmd[offset + 3] << 24);
+        return true;
+    }
+    if (cmd[2] == RACP_TIMESTAMP && len >= offset + 6)
+    {
+        *value = getEpochFromBytes(&cmd[offset]);
+        return true;
+    }
+    return false;
+}
+
+// Returns the index of the first stored record with a record number above recordNumber
+unsigned short findStoredRecordAfter(unsigned long recordNumber)
+{
+    return searchStoredRecords(0, numberOfStoredMsmtGroups, RACP_RECORD_NUM, recordNumber, true);
+}
+
+/*
+ * Fills runs with the index of the first stored record of each timeline, in order, and returns how
+ * many there are. Timelines follow each other by record number, so the first record numbers of the
+ * timelines in storedTimelines locate them. The records of retired timelines come first and are
+ * searched as one run.
+ */
+static unsigned short getStoredTimelineRuns(unsigned short *runs)
+{
+    unsigned short count = 1;
+    unsigned short i;
+    unsigned short j;
+    runs[0] = 0;
+    for (i = 0; i < STORED_TIMELINES; i++)
+    {
+        if (i == STORED_TIMELINE_RETIRED || storedTimelines.timeline[i].state == STORED_TIMELINE_FREE)
+        {
+            continue;
+        }
+        unsigned short run = searchStoredRecords(0, numberOfStoredMsmtGroups, RACP_RECORD_NUM,
+                                                 storedTimelines.timeline[i].firstRecord, false);
+        j = 0;
+        while (j < count && runs[j] < run)
+        {
+            j++;
+        }
+        if (j < count && runs[j] == run)
+        {
+            continue;   // A timeline without records shares its start with the next one
+        }
+        memmove(&runs[j + 1], &runs[j], (count - j) * sizeof(unsigned short));
+        runs[j] = run;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Selects the stored records with a time stamp from lower up to upper. The epochs are only sorted
+ * within a timeline, so the records of each timeline are searched on their own. The selection goes
+ * from the first match on the oldest timeline with one to the last match on the newest timeline
+ * with one. That is exactly the matching records unless the timelines overlap in time.
+ */
+static unsigned short findStoredRecordsByTime(bool hasLower, unsigned long long lower,
+    bool hasUpper, unsigned long long upper, unsigned short *start)
+{
+    unsigned short runs[STORED_TIMELINES + 1];
+    unsigned short count = getStoredTimelineRuns(runs);
+    unsigned short end = 0;
+    unsigned short i;
+    bool found = false;
+    for (i = 0; i < count; i++)
+    {
+        unsigned short runEnd = (i + 1 < count) ? runs[i + 1] : numberOfStoredMsmtGroups;
+        unsigned short first = hasLower ? searchStoredRecords(runs[i], runEnd, RACP_TIMESTAMP, lower, false) : runs[i];
+        unsigned short last = hasUpper ? searchStoredRecords(first, runEnd, RACP_TIMESTAMP, upper, true) : runEnd;
+        if (last > first)
+        {
+            if (!found)
             {
-                unsigned long long epoch = getEpochFromBytes(&cmd[3]);  // Should check for length
-                unsigned short i;
-                if (epoch < common->sGhsTime.epoch)
-                {
-                    return numberOfStoredMsmtGroups;
-                }
-                else if (epoch > storedMsmts[numberOfStoredMsmtGroups - 1].common.sGhsTime.epoch)
-                {
-                    return 0;
-                }
-                for (i = 0; i < numberOfStoredMsmtGroups; i++)
-                {
-                    if (epoch < storedMsmts[i].common.sGhsTime.epoch)
-                    {
-                        return numberOfStoredMsmtGroups - i;
-                    }
-                }
-                return 0;
+                *start = first;
+                found = true;
             }
-            return 0;
+            end = last;
         }
-        
-        case RACP_FIRST:
-        case RACP_LAST:
-            return 1;
-        
-        default:
-            return 0;
     }
+    return found ? (end - *start) : 0;
 }
 
-// Return index. -1 indicates no records found
-long getStartIndexInStoredRecords(unsigned char* cmd, unsigned short len)
+/*
+ * Finds the stored records selected by a RACP operator and operand. The selection is always a run of
+ * consecutive records; its first index is returned in start and its length is returned. The operand
+ * starts at cmd[3]; RACP_RANGE has the lower bound followed by the upper bound, both inclusive.
+ * It is assumed this method is called only if the operation is supported.
+ */
+unsigned short findStoredRecords(unsigned char* cmd, unsigned short len, unsigned short *start)
 {
+    unsigned long long value;
+    unsigned long long upper;
+    unsigned short end = numberOfStoredMsmtGroups;
+    unsigned short operandSize = (cmd[2] == RACP_RECORD_NUM) ? 4 : 6;
+
+    *start = 0;
     if (numberOfStoredMsmtGroups == 0)
     {
-        return -1;
+        return 0;
+    }
+    if (cmd[2] == RACP_TIMESTAMP && (cmd[1] == RACP_GTE || cmd[1] == RACP_LTE || cmd[1] == RACP_RANGE))
+    {
+        if (!getRacpOperand(cmd, len, 3, &value) ||
+            (cmd[1] == RACP_RANGE && (!getRacpOperand(cmd, len, 3 + operandSize, &upper) || upper < value)))
+        {
+            return 0;
+        }
+        return findStoredRecordsByTime(cmd[1] != RACP_LTE, value, cmd[1] != RACP_GTE,
+                                       (cmd[1] == RACP_RANGE) ? upper : value, start);
     }
-    s_MsmtCommon *common = &storedMsmts[0].common;
     switch(cmd[1])
     {
         case RACP_ALL:
-            return 0;
-        
+            break;
+
         case RACP_GTE:
-        {
-            if (cmd[2] == RACP_RECORD_NUM && len >= 7)
+            if (!getRacpOperand(cmd, len, 3, &value))
             {
-                unsigned long recordNumber = (unsigned long)cmd[3] + ((unsigned long)cmd[4] << 8)
-                    + ((unsigned long)cmd[5] << 16) + ((unsigned long)cmd[6] << 24);
-                if (recordNumber < common->recordNumber)
-                {
-                    return 0;
-                }
-                else if (recordNumber > storedMsmts[numberOfStoredMsmtGroups - 1].common.recordNumber)
-                {
-                    return -1;
-                }
-                return (recordNumber - common->recordNumber);
+                return 0;
             }
+            *start = searchStoredRecords(0, numberOfStoredMsmtGroups, cmd[2], value, false);
+            break;
 
-            if (cmd[2] == RACP_TIMESTAMP && len >= 9)
+        case RACP_LTE:
+            if (!getRacpOperand(cmd, len, 3, &value))
             {
-                unsigned long long epoch = getEpochFromBytes(&cmd[2]);  // Should check for length
-                unsigned short i;
-                if (epoch <= common->sGhsTime.epoch)
-                {
-                    return 0;
-                }
-                else if (epoch > storedMsmts[numberOfStoredMsmtGroups - 1].common.sGhsTime.epoch)
-                {
-                    return -1;
-                }
-                for (i = 0; i < numberOfStoredMsmtGroups; i++)
-                {
-                    if (epoch < storedMsmts[i].common.sGhsTime.epoch)
-                    {
-                        return i;
-                    }
-                }
                 return 0;
             }
-            return -1;
-        }
-        
+            end = searchStoredRecords(0, numberOfStoredMsmtGroups, cmd[2], value, true);
+            break;
+
+        case RACP_RANGE:
+            if (!getRacpOperand(cmd, len, 3, &value) || !getRacpOperand(cmd, len, 3 + operandSize, &upper) || upper < value)
+            {
+                return 0;
+            }
+            *start = searchStoredRecords(0, numberOfStoredMsmtGroups, cmd[2], value, false);
+            end = searchStoredRecords(*start, numberOfStoredMsmtGroups, cmd[2], upper, true);
+            break;
+
         case RACP_FIRST:
-            return 0;
-        
+            end = 1;
+            break;
+
         case RACP_LAST:
-            return numberOfStoredMsmtGroups - 1;
+            *start = numberOfStoredMsmtGroups - 1;
+            break;
 
         default:
-            return -1;
+            return 0;
     }
+    return (end > *start) ? (end - *start) : 0;
 }
 
 /**
  * This method queues the stored measurement to be sent. In the main loop, the queue is read
  * and if not busy sending data, the send_flag is set and the measurement de-queued.
+ * Only a reference to the stored record is queued; it is unpacked from flash when it is encoded, see
+ * getReferencedStoredMsmt().
+ * The queue is single producer and the live data timer also enqueues, so the enqueue here is done
+ * in a critical region to keep the timer from entering the producer side at the same time.
  */
 void sendStoredSpecializationMsmts(unsigned short stored_count)
 {
-    // Set up parameters for notification of this PDU - likely in fragments
-    #if (BP_CUFF == 1)
-        NRF_LOG_DEBUG("Stored Measurements added to queue: sys %u, dia %u, mean %u, PR %u, has status %u, count %d", 
-            storedMsmts[stored_count].systolic,
-            storedMsmts[stored_count].diastolic,
-            storedMsmts[stored_count].mean,
-            storedMsmts[stored_count].pulseRate,
-            storedMsmts[stored_count].hasStatus,
-            stored_count);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            if (storedMsmts[stored_count].hasStatus && !reportStatus)
-            {
-                updateDataRestoreLastMsmt(&msmtGroupBpData);
-                reportStatus = true;
-            }
-            else if (!storedMsmts[stored_count].hasStatus && reportStatus)
-            {
-                updateDataDropLastMsmt(&msmtGroupBpData);
-                reportStatus = false;
-            }
-            enqueue(queue, &storedMsmts[stored_count], sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
-    #endif
-    #if (PULSE_OX == 1)
-        NRF_LOG_DEBUG("Stored Measurements added to queue: spo2 %u, pr %u, qual %u, count %d", 
-            storedMsmts[stored_count].spo2,
-            storedMsmts[stored_count].pulseRate,
-            storedMsmts[stored_count].pulseQuality,
-            stored_count);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            enqueue(queue, &storedMsmts[stored_count], sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
-    #endif
-    #if (GLUCOSE == 1)
-        NRF_LOG_DEBUG("Stored Measurements added to queue: conc %u, carbs %u, meds %u, exer %u, count %d", 
-            storedMsmts[stored_count].conc,
-            storedMsmts[stored_count].carbs,
-            storedMsmts[stored_count].meds,
-            storedMsmts[stored_count].exer,
-            stored_count);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
+    #if (BP_CUFF == 1 || PULSE_OX == 1 || GLUCOSE == 1 || SCALE == 1 || THERMOMETER == 1)
+        s_StoredMsmtReference reference;
+
+        if (stored_count >= numberOfStoredMsmtGroups)
         {
-            enqueue(queue, &storedMsmts[stored_count], sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
+            NRF_LOG_DEBUG("Stored measurement %u could not be read", stored_count);
+            return;
         }
+        memset(&reference, 0, sizeof(s_StoredMsmtReference));
+        reference.isStoredData = true;
+        reference.index = stored_count;
+        reference.generation = getStoredMsmtGeneration();
+        NRF_LOG_DEBUG("Stored measurement %u added to queue", stored_count);
+        CRITICAL_REGION_ENTER();
+        enqueue(queue, &reference, sizeof(s_StoredMsmtReference));    // For the scale the first one in a connection triggers the settings
+        CRITICAL_REGION_EXIT();
     #endif
     #if (SCALE == 1)
-        NRF_LOG_DEBUG("Stored Measurements added to queue: mass %u, count %d", 
-            storedMsmts[stored_count].mass, stored_count);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
+        if (scale_sequence == 0)
         {
-            if (scale_sequence == 0)
-            {
-                enqueue(queue, &storedMsmts[stored_count], sizeof(s_MsmtData)); // This is to trigger the setting
-            }
-            enqueue(queue, &storedMsmts[stored_count], sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
-    #endif
-    #if (THERMOMETER == 1)
-        NRF_LOG_DEBUG("Stored Measurements added to queue: temp %u, count %d", 
-            storedMsmts[stored_count].temp, stored_count);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            enqueue(queue, &storedMsmts[stored_count], sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
+            // The settings group is not a stored record. Give back the count and the index it used so that this
+            // record is queued again when the settings have been sent; otherwise the last record is never sent.
+            global_send.number_of_groups++;
+            global_send.next_group--;
         }
     #endif
 }
@@ -1894,8 +2145,7 @@ void sendStoredSpecializationMsmts(unsigned short stored_count)
 
 void deleteStoredSpecializationMsmts(void)
 {
-    memset(&storedMsmts, 0, NUMBER_OF_STORED_MSMTS * sizeof(s_MsmtData));
-    stored_msmts_same = false;
+    clearStoredMsmts();
 }
 #endif
 
@@ -1947,29 +2197,13 @@ void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned
                 bpMsmt.status_irregular_pulse = (stat & BP_STATUS_IRREGULAR_PULSE);
                 bpMsmt.status_movement = (stat & BP_STATUS_MOVEMENT);
             }
-            if (bpMsmt.hasStatus && !reportStatus)
-            {
-                updateDataRestoreLastMsmt(&msmtGroupBpData);
-                reportStatus = true;
-            }
-            else if (!bpMsmt.hasStatus && reportStatus)
-            {
-                updateDataDropLastMsmt(&msmtGroupBpData);
-                reportStatus = false;
-            }
-            //reportStatus = !reportStatus;
-
             NRF_LOG_INFO("Measurement added to queue: sys %u, dia %u, mean %u, PR %u, status: %u", 
                 bpMsmt.systolic,
                 bpMsmt.diastolic,
                 bpMsmt.mean,
                 bpMsmt.pulseRate,
                 bpMsmt.hasStatus);
-            if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-            {
-                enqueue(queue, &bpMsmt, sizeof(s_MsmtData));
-                sd_mutex_release(&q_mutex);
-            }
+            enqueue(queue, &bpMsmt, sizeof(s_MsmtData));
         }
         else
         {
@@ -2001,20 +2235,13 @@ void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned
             poMsmt.common.hasTimeStamp = false;
             poMsmt.isContinuous = true;
         }
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            enqueue(queue, &poMsmt, sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
+        enqueue(queue, &poMsmt, sizeof(s_MsmtData));
     #endif
     #if (HEART_RATE == 1)
         s_MsmtData hrMsmt;
+        memset(&hrMsmt, 0, sizeof(s_MsmtData));    // Not a stored msmt reference
         hrMsmt.heartRate = 55 + ((timeStamp >> 9) & 0x07);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            enqueue(queue, &hrMsmt, sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
+        enqueue(queue, &hrMsmt, sizeof(s_MsmtData));
     #endif
     #if (SPIROMETER == 1)
         if (spiro_sequence >= 10) return;
@@ -2023,11 +2250,7 @@ void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned
         session.common.sGhsTime.epoch = epoch + timeStampMsmt;
         session.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
         session.common.sGhsTime.timeSync = sGhsTime->timeSync;
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            enqueue(queue, &session, sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
+        enqueue(queue, &session, sizeof(s_MsmtData));
     #endif
     #if (SCALE == 1)
         s_MsmtData scaleMsmt;
@@ -2039,15 +2262,11 @@ void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned
         scaleMsmt.common.sGhsTime.offsetShift = sGhsTime->offsetShift;
         scaleMsmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
         NRF_LOG_INFO("Measurement added to queue: weight %u", scaleMsmt.mass);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
+        if (scale_sequence == 0)
         {
-            if (scale_sequence == 0)
-            {
-                enqueue(queue, &scaleMsmt, sizeof(s_MsmtData)); // This is to trigger the setting
-            }
-            enqueue(queue, &scaleMsmt, sizeof(s_MsmtData)); // This is the live measurement
-            sd_mutex_release(&q_mutex);
+            enqueue(queue, &scaleMsmt, sizeof(s_MsmtData)); // This is to trigger the setting
         }
+        enqueue(queue, &scaleMsmt, sizeof(s_MsmtData)); // This is the live measurement
     #endif
     #if (THERMOMETER == 1)
         s_MsmtData tempMsmt;
@@ -2060,11 +2279,7 @@ void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned
         tempMsmt.common.sGhsTime.flagKnownTimeline = GHS_TIME_FLAG_ON_CURRENT_TIMELINE;
         tempMsmt.common.sGhsTime.timeSync = sGhsTime->timeSync;
         NRF_LOG_INFO("Measurement added to queue: body temp %u ambient temp %u", tempMsmt.temp, tempMsmt.ambient);
-        if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-        {
-            enqueue(queue, &tempMsmt, sizeof(s_MsmtData));
-            sd_mutex_release(&q_mutex);
-        }
+        enqueue(queue, &tempMsmt, sizeof(s_MsmtData));
     #endif
     // No live data for glucose meter
 }
@@ -2074,8 +2289,6 @@ void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned
  */
 void handleSpecializationsOnSetTime(unsigned short numberOfStoredMsmtGroups, long long diff, unsigned short timeSync)
 {
-    int i;
-    unsigned long long udiff = -diff;
     #if (BP_CUFF == 1)
         updateTimeStampTimeSync(&msmtGroupBpData, timeSync);    // When the device receives a set time in the set time is the
                                                                 // synchronization method of the PHG. We update the sync part
@@ -2099,35 +2312,78 @@ void handleSpecializationsOnSetTime(unsigned short numberOfStoredMsmtGroups, lon
     #if (THERMOMETER == 1)
         updateTimeStampTimeSync(&msmtGroupTempData, timeSync);
     #endif
-    // If we have stored data and the time has been set, the timeline has been changed. Here
-    // we adjust the time stamps of all our stored data to the new timeline. THat will
-    // involve updating the epoch field of the stored time stamp by the difference and
-    // and changing the time sync to that specified in the set time.
+    // If we have stored data and the time has been set, the timeline has been changed. The time
+    // stamps of all our stored data on the current timeline move by the difference and take the
+    // time sync specified in the set time. They are kept relative to the base of the timeline, so
+    // only its entry in storedTimelines changes; nothing in flash is rewritten. The table is saved
+    // with the bonding data.
     #if (USES_STORED_DATA >= 1)
         NRF_LOG_INFO("Doing date time adjustment of %lld on stored data", diff);
-        for (i = 0; i < numberOfStoredMsmtGroups; i++)
+        storedTimelines.timeline[storedTimelines.current].base = storedTimelines.timeline[storedTimelines.current].base + diff;
+        storedTimelines.timeline[storedTimelines.current].timeSync = (unsigned char)timeSync;
+        storedTimelinesChanged = true;
+    #endif
+}
+
+void setNotOnCurrentTimeline(void)
+{
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        // The clock restarted, so new msmts go on a new timeline. The stored msmts stay on theirs
+        // with the base and time sync it has now; set time no longer moves them.
+        unsigned char id = findFreeStoredTimeline();
+        unsigned char oldest = STORED_TIMELINE_RETIRED;
+        unsigned char i;
+        if (id == STORED_TIMELINE_RETIRED)
+        {
+            // The clock restarted again before the last retired timeline was moved
+            NRF_LOG_WARNING("No free stored msmt timeline; stored msmts stay on the current one");
+            return;
+        }
+        storedTimelines.timeline[id].base = 0LL;
+        storedTimelines.timeline[id].firstRecord = recordNumber;
+        storedTimelines.timeline[id].timeSync = STORED_TIMELINE_SYNC_NONE;
+        storedTimelines.timeline[id].state = STORED_TIMELINE_LIVE;
+        storedTimelines.current = id;
+        storedTimelinesChanged = true;
+        NRF_LOG_INFO("Stored msmts from record number %u are on timeline %u", recordNumber, id);
+
+        // Keep an entry free for the next restart by retiring the oldest timeline when the table is full
+        if (findFreeStoredTimeline() == STORED_TIMELINE_RETIRED)
         {
-             NRF_LOG_DEBUG("msmt %u timeline %u", i, storedMsmts[i].common.sGhsTime.flagKnownTimeline);
-             if (storedMsmts[i].common.sGhsTime.flagKnownTimeline == GHS_TIME_FLAG_ON_CURRENT_TIMELINE)
-             {
-                 storedMsmts[i].common.sGhsTime.epoch = (diff < 0) ? storedMsmts[i].common.sGhsTime.epoch - udiff
-                            : storedMsmts[i].common.sGhsTime.epoch + diff;
-                 storedMsmts[i].common.sGhsTime.timeSync = timeSync;
-                 stored_msmts_same = false; // This will assure flash gets written
-                 NRF_LOG_DEBUG("Updated time on msmt %u ", i);
-             }
+            for (i = 0; i < STORED_TIMELINES; i++)
+            {
+                if (i != STORED_TIMELINE_RETIRED && i != id && storedTimelines.timeline[i].state == STORED_TIMELINE_LIVE &&
+                    (oldest == STORED_TIMELINE_RETIRED || storedTimelines.timeline[i].firstRecord < storedTimelines.timeline[oldest].firstRecord))
+                {
+                    oldest = i;
+                }
+            }
+            if (oldest != STORED_TIMELINE_RETIRED)
+            {
+                storedTimelines.timeline[oldest].state = STORED_TIMELINE_RETIRING;
+                retireStoredTimelines(1 << oldest);
+            }
         }
     #endif
 }
 
-void setNotOnCurrentTimeline(void)
+// Called once the stored msmts are loaded. A timeline whose msmts were being moved when the power went
+// is moved again; the msmts moved already are no longer on it.
+void resumeStoredTimelines(void)
 {
-    int i;
-    #if (USES_STORED_DATA >= 1)
-        for (i = 0; i < numberOfStoredMsmtGroups; i ++)
+    #if (USES_STORED_DATA >= 1 && HEART_RATE != 1 && SPIROMETER != 1)
+        unsigned char retire = 0;
+        unsigned char i;
+        for (i = 0; i < STORED_TIMELINES; i++)
+        {
+            if (storedTimelines.timeline[i].state == STORED_TIMELINE_RETIRING)
+            {
+                retire = retire | (1 << i);
+            }
+        }
+        if (retire != 0)
         {
-            storedMsmts[i].common.sGhsTime.flagKnownTimeline = 0;
-            stored_msmts_same = false;
+            retireStoredTimelines(retire);
         }
     #endif
 }
@@ -0,0 +1,1093 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Host stand-in for the SoftDevice BLE stack, the app timer and the DK buttons, with a central on the other
+ * end of a simulated link, so main.c runs unchanged on a PC. main() is built as firmwareMain() and runs on
+ * its own stack; sd_app_evt_wait() switches back to the test, which moves simulated time on to whatever
+ * next wakes the application: a BLE or flash event, a timer or a button. Code run from a timer or button
+ * stands in for the interrupt it would run from on the target. The time the application itself takes is
+ * not simulated.
+ *
+ * The link runs in connection events. In each the central first answers what the application sent or
+ * asked for in the previous one (indication confirmations, data length, PHY and connection parameter
+ * updates, pairing) and sends its next ATT request, one at a time. The application's indication and then
+ * its queued notifications go out after that, as many LL packets as the event length, the central's limit
+ * and the data length allow. A notification takes ceil((length + 7) / data length) packets for its ATT and
+ * L2CAP headers. Notifications the central has completely are reported in a BLE_GATTS_EVT_HVN_TX_COMPLETE
+ * at the end of the event. A notification is refused with NRF_ERROR_RESOURCES when the queue is full and an
+ * indication with NRF_ERROR_BUSY while one is outstanding. In that case the link is run on until the
+ * confirmation is in, since main.c retries busy indications in a loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_sim.h"
+#include "bsp_btn_ble.h"
+#include "nrf_sdh.h"
+#include "nrf_sdh_ble.h"
+#include "nrf_sdm.h"
+#include "nrf_soc.h"
+#include "sdk_stubs.h"
+
+#define SIM_CONN_HANDLE         0
+#define SIM_FIRMWARE_STACK      (1024 * 1024)
+#define SIM_TIMERS              8
+#define SIM_HVN_QUEUE_MAX       32
+#define SIM_CENTRAL_OPS         16
+#define SIM_ATT_HEADER          3       // Opcode and handle
+#define SIM_L2CAP_HEADER        4
+#define SIM_T_IFS_US            150
+#define SIM_NEVER               UINT64_MAX
+
+int firmwareMain(void);
+
+typedef struct s_SimEvt
+{
+    struct s_SimEvt *next;
+    uint16_t len;
+    ble_evt_t evt;                          // Followed by the rest of a write's data
+} s_SimEvt;
+
+typedef struct
+{
+    uint16_t handle;
+    uint8_t type;
+    uint16_t len;
+    uint16_t octetsLeft;                    // L2CAP octets not yet on air
+    uint8_t data[NRF_SDH_BLE_GATT_MAX_MTU_SIZE];
+} s_SimPdu;
+
+typedef enum
+{
+    SIM_OP_EXCHANGE_MTU,
+    SIM_OP_PAIR,
+    SIM_OP_WRITE
+} e_SimOp;
+
+typedef struct
+{
+    e_SimOp op;
+    uint16_t handle;
+    uint16_t len;
+    uint8_t data[32];
+} s_SimCentralOp;
+
+typedef enum
+{
+    SIM_INDICATION_NONE,
+    SIM_INDICATION_QUEUED,                  // Not yet on air
+    SIM_INDICATION_SENT                     // Waiting for the confirmation
+} e_SimIndication;
+
+static s_SimLink link;
+static s_SimStats stats;
+static sim_hvx_handler_t centralHvxHandler = NULL;
+static uint64_t nowUs = 0;
+
+static ucontext_t simContext;
+static ucontext_t firmwareContext;
+static bool inFirmware = false;
+
+static s_SimEvt *evtHead = NULL;
+static s_SimEvt *evtTail = NULL;
+
+static app_timer_t *timers[SIM_TIMERS];
+static unsigned short timerCount = 0;
+
+static bsp_event_callback_t bspHandler = NULL;
+
+// SoftDevice configuration
+static uint8_t configuredHvnQueueSize = 1;
+
+// Connection state
+static bool advertising = false;
+static bool connected = false;
+static bool encrypted = false;
+static uint64_t nextEventUs = SIM_NEVER;
+static uint32_t intervalUs = 0;
+static uint16_t attMtu = BLE_GATT_ATT_MTU_DEFAULT;
+static uint16_t txOctets = 27;
+static bool phy2M = false;
+static uint16_t cccdValues[256];            // By CCCD handle, as the central wrote them
+
+// Procedures the central completes in the next connection event
+static bool dataLengthPending = false;
+static uint16_t dataLengthRequested = 0;
+static bool phyPending = false;
+static bool phyRequested2M = false;
+static bool connParamsPending = false;
+static ble_gap_conn_params_t connParamsRequested;
+static bool pairingPending = false;
+
+// The central's ATT requests; one is outstanding at a time
+static s_SimCentralOp centralOps[SIM_CENTRAL_OPS];
+static unsigned short centralOpHead = 0;
+static unsigned short centralOpCount = 0;
+static bool attBusy = false;
+static bool writeDone = true;
+static uint16_t writeStatus = BLE_GATT_STATUS_SUCCESS;
+static bool paired = false;
+
+// What the application has handed over for the central
+static s_SimPdu hvnQueue[SIM_HVN_QUEUE_MAX];
+static unsigned short hvnHead = 0;
+static unsigned short hvnCount = 0;
+static s_SimPdu indication;
+static e_SimIndication indicationState = SIM_INDICATION_NONE;
+
+static void simError(const char *message, unsigned long value)
+{
+    fprintf(stderr, "sim: %s (%lu) at %.3f ms\n", message, value, nowUs / 1000.0);
+    stats.errors++;
+}
+
+static ble_evt_t *queueEvent(uint16_t evt_id, uint16_t extra)
+{
+    s_SimEvt *evt = calloc(1, sizeof(s_SimEvt) + extra);
+    if (evt == NULL)
+    {
+        fprintf(stderr, "sim: out of memory\n");
+        exit(2);
+    }
+    evt->len = sizeof(ble_evt_t) + extra;
+    evt->evt.header.evt_id = evt_id;
+    evt->evt.header.evt_len = evt->len;
+    if (evtTail == NULL)
+    {
+        evtHead = evt;
+    }
+    else
+    {
+        evtTail->next = evt;
+    }
+    evtTail = evt;
+    return &evt->evt;
+}
+
+static uint64_t ticksToUs(uint32_t ticks)
+{
+    return ((uint64_t)ticks * 1000000 + APP_TIMER_CLOCK_FREQ - 1) / APP_TIMER_CLOCK_FREQ;
+}
+
+// Air time of an LL data packet; the MIC is there once the link is encrypted
+static uint32_t packetUs(uint16_t payload, uint32_t *p_bytes)
+{
+    uint32_t bytes = (phy2M ? 2 : 1) + 4 + 2 + payload + ((encrypted && payload > 0) ? 4 : 0) + 3;
+    if (p_bytes != NULL)
+    {
+        *p_bytes = bytes;
+    }
+    return phy2M ? bytes * 4 : bytes * 8;
+}
+
+//=========================================================================== The central
+
+static void centralOp(e_SimOp op, uint16_t handle, uint8_t const *p_data, uint16_t len)
+{
+    s_SimCentralOp *p_op;
+    if (centralOpCount >= SIM_CENTRAL_OPS || len > sizeof(p_op->data))
+    {
+        simError("central request queue full or request too long", len);
+        return;
+    }
+    p_op = &centralOps[(centralOpHead + centralOpCount) % SIM_CENTRAL_OPS];
+    p_op->op = op;
+    p_op->handle = handle;
+    p_op->len = len;
+    if (len > 0)
+    {
+        memcpy(p_op->data, p_data, len);
+    }
+    centralOpCount++;
+}
+
+static void centralSendOp(s_SimCentralOp const *p_op)
+{
+    ble_evt_t *evt;
+    switch (p_op->op)
+    {
+        case SIM_OP_EXCHANGE_MTU:
+            evt = queueEvent(BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST, 0);
+            evt->evt.gatts_evt.conn_handle = SIM_CONN_HANDLE;
+            evt->evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu = link.mtu;
+            attBusy = true;
+            break;
+
+        case SIM_OP_PAIR:
+            evt = queueEvent(BLE_GAP_EVT_SEC_PARAMS_REQUEST, 0);
+            evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.bond = 1;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.io_caps = BLE_GAP_IO_CAPS_NONE;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.min_key_size = 7;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.max_key_size = 16;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.kdist_own.enc = 1;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.kdist_own.id = 1;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.kdist_peer.enc = 1;
+            evt->evt.gap_evt.params.sec_params_request.peer_params.kdist_peer.id = 1;
+            break;
+
+        case SIM_OP_WRITE:
+        {
+            s_HostGattCharacteristic const *characteristic = hostGattByHandle(p_op->handle);
+            uint16_t extra = (p_op->len > 1) ? p_op->len - 1 : 0;
+            if (characteristic == NULL)
+            {
+                simError("central write to an unknown handle", p_op->handle);
+                writeStatus = 0x01;     // Invalid handle
+                writeDone = true;
+                break;
+            }
+            if (characteristic->handles.cccd_handle == p_op->handle)
+            {
+                // The SoftDevice answers CCCD writes itself
+                cccdValues[p_op->handle % 256] = p_op->data[0] | (p_op->len > 1 ? p_op->data[1] << 8 : 0);
+                evt = queueEvent(BLE_GATTS_EVT_WRITE, extra);
+                evt->evt.gatts_evt.conn_handle = SIM_CONN_HANDLE;
+                evt->evt.gatts_evt.params.write.handle = p_op->handle;
+                evt->evt.gatts_evt.params.write.op = BLE_GATTS_OP_WRITE_REQ;
+                evt->evt.gatts_evt.params.write.len = p_op->len;
+                memcpy(evt->evt.gatts_evt.params.write.data, p_op->data, p_op->len);
+                writeStatus = BLE_GATT_STATUS_SUCCESS;
+                writeDone = true;
+            }
+            else if (characteristic->writeAuthorized)
+            {
+                evt = queueEvent(BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, extra);
+                evt->evt.gatts_evt.conn_handle = SIM_CONN_HANDLE;
+                evt->evt.gatts_evt.params.authorize_request.type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+                evt->evt.gatts_evt.params.authorize_request.request.write.handle = p_op->handle;
+                evt->evt.gatts_evt.params.authorize_request.request.write.uuid.uuid = characteristic->uuid;
+                evt->evt.gatts_evt.params.authorize_request.request.write.op = BLE_GATTS_OP_WRITE_REQ;
+                evt->evt.gatts_evt.params.authorize_request.request.write.len = p_op->len;
+                memcpy(evt->evt.gatts_evt.params.authorize_request.request.write.data, p_op->data, p_op->len);
+                attBusy = true;
+            }
+            else
+            {
+                simError("central write to a value the application does not authorize", p_op->handle);
+                writeStatus = 0x03;     // Write not permitted
+                writeDone = true;
+            }
+        }
+        break;
+    }
+}
+
+//=========================================================================== The link
+
+static void dropConnection(uint8_t reason)
+{
+    ble_evt_t *evt = queueEvent(BLE_GAP_EVT_DISCONNECTED, 0);
+    evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+    evt->evt.gap_evt.params.disconnected.reason = reason;
+    connected = false;
+    nextEventUs = SIM_NEVER;
+    hvnCount = 0;
+    indicationState = SIM_INDICATION_NONE;
+    centralOpCount = 0;
+    attBusy = false;
+    writeDone = true;
+    dataLengthPending = phyPending = connParamsPending = pairingPending = false;
+}
+
+static void deliverToCentral(s_SimPdu const *p_pdu)
+{
+    if (p_pdu->type == BLE_GATT_HVX_NOTIFICATION)
+    {
+        stats.notifications++;
+    }
+    else
+    {
+        stats.indications++;
+    }
+    if (centralHvxHandler != NULL)
+    {
+        centralHvxHandler(p_pdu->handle, p_pdu->type, p_pdu->data, p_pdu->len);
+    }
+}
+
+static void connectionEvent(void)
+{
+    ble_evt_t *evt;
+    uint32_t budgetUs = (link.eventLengthUs < intervalUs) ? link.eventLengthUs : intervalUs;
+    uint32_t usedUs = 0;
+    unsigned short packets = 0;
+    uint8_t completed = 0;
+
+    stats.connectionEvents++;
+    nextEventUs = nowUs + intervalUs;
+
+    // The central's side: answers to the last event and its next request
+    if (indicationState == SIM_INDICATION_SENT)
+    {
+        evt = queueEvent(BLE_GATTS_EVT_HVC, 0);
+        evt->evt.gatts_evt.conn_handle = SIM_CONN_HANDLE;
+        evt->evt.gatts_evt.params.hvc.handle = indication.handle;
+        indicationState = SIM_INDICATION_NONE;
+    }
+    if (dataLengthPending)
+    {
+        txOctets = (dataLengthRequested < link.dataLength) ? dataLengthRequested : link.dataLength;
+        evt = queueEvent(BLE_GAP_EVT_DATA_LENGTH_UPDATE, 0);
+        evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+        evt->evt.gap_evt.params.data_length_update.effective_params.max_tx_octets = txOctets;
+        evt->evt.gap_evt.params.data_length_update.effective_params.max_rx_octets = txOctets;
+        evt->evt.gap_evt.params.data_length_update.effective_params.max_tx_time_us = packetUs(txOctets, NULL);
+        evt->evt.gap_evt.params.data_length_update.effective_params.max_rx_time_us = packetUs(txOctets, NULL);
+        dataLengthPending = false;
+    }
+    if (phyPending)
+    {
+        phy2M = phyRequested2M && link.phy2M;
+        evt = queueEvent(BLE_GAP_EVT_PHY_UPDATE, 0);
+        evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+        evt->evt.gap_evt.params.phy_update.status = 0;
+        evt->evt.gap_evt.params.phy_update.tx_phy = phy2M ? BLE_GAP_PHY_2MBPS : BLE_GAP_PHY_1MBPS;
+        evt->evt.gap_evt.params.phy_update.rx_phy = evt->evt.gap_evt.params.phy_update.tx_phy;
+        phyPending = false;
+    }
+    if (connParamsPending)
+    {
+        uint32_t minUs = connParamsRequested.min_conn_interval * 1250UL;
+        uint32_t maxUs = connParamsRequested.max_conn_interval * 1250UL;
+        intervalUs = (link.minConnIntervalUs > minUs) ? link.minConnIntervalUs : minUs;
+        intervalUs = (intervalUs > maxUs) ? maxUs : intervalUs;
+        nextEventUs = nowUs + intervalUs;
+        evt = queueEvent(BLE_GAP_EVT_CONN_PARAM_UPDATE, 0);
+        evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+        evt->evt.gap_evt.params.conn_param_update.conn_params = connParamsRequested;
+        evt->evt.gap_evt.params.conn_param_update.conn_params.min_conn_interval = (uint16_t)(intervalUs / 1250);
+        evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval = (uint16_t)(intervalUs / 1250);
+        connParamsPending = false;
+    }
+    if (pairingPending)
+    {
+        encrypted = true;
+        paired = true;
+        evt = queueEvent(BLE_GAP_EVT_CONN_SEC_UPDATE, 0);
+        evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+        evt = queueEvent(BLE_GAP_EVT_AUTH_STATUS, 0);
+        evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+        evt->evt.gap_evt.params.auth_status.auth_status = BLE_GAP_SEC_STATUS_SUCCESS;
+        pairingPending = false;
+    }
+    if (!attBusy && centralOpCount > 0)
+    {
+        s_SimCentralOp op = centralOps[centralOpHead];
+        centralOpHead = (centralOpHead + 1) % SIM_CENTRAL_OPS;
+        centralOpCount--;
+        centralSendOp(&op);
+    }
+
+    // The application's side: the indication first, then the notifications in order
+    for (;;)
+    {
+        s_SimPdu *pdu = (indicationState == SIM_INDICATION_QUEUED) ? &indication : (hvnCount > 0 ? &hvnQueue[hvnHead] : NULL);
+        uint16_t payload;
+        uint32_t bytes;
+        uint32_t costUs;
+        if (pdu == NULL || (link.maxPacketsPerEvent > 0 && packets >= link.maxPacketsPerEvent))
+        {
+            break;
+        }
+        payload = (pdu->octetsLeft < txOctets) ? pdu->octetsLeft : txOctets;
+        costUs = packetUs(payload, &bytes) + SIM_T_IFS_US + packetUs(0, NULL) + SIM_T_IFS_US;
+        if (packets > 0 && usedUs + costUs > budgetUs)
+        {
+            break;
+        }
+        usedUs = usedUs + costUs;
+        packets++;
+        stats.packets++;
+        stats.bytesOnAir = stats.bytesOnAir + bytes;
+        pdu->octetsLeft = pdu->octetsLeft - payload;
+        if (pdu->octetsLeft > 0)
+        {
+            continue;
+        }
+        deliverToCentral(pdu);
+        if (pdu == &indication)
+        {
+            indicationState = SIM_INDICATION_SENT;
+        }
+        else
+        {
+            hvnHead = (hvnHead + 1) % SIM_HVN_QUEUE_MAX;
+            hvnCount--;
+            completed++;
+        }
+    }
+    if (completed > 0)
+    {
+        evt = queueEvent(BLE_GATTS_EVT_HVN_TX_COMPLETE, 0);
+        evt->evt.gatts_evt.conn_handle = SIM_CONN_HANDLE;
+        evt->evt.gatts_evt.params.hvn_tx_complete.count = completed;
+    }
+}
+
+//=========================================================================== Time
+
+// Runs the handlers of the timers that are due. Returns true if any ran
+static bool runTimers(void)
+{
+    bool ran = false;
+    unsigned short i;
+    for (i = 0; i < timerCount; i++)
+    {
+        app_timer_t *timer = timers[i];
+        if (timer->active && timer->expiry_us <= nowUs)
+        {
+            if (timer->mode == APP_TIMER_MODE_REPEATED)
+            {
+                timer->expiry_us = timer->expiry_us + timer->period_us;
+            }
+            else
+            {
+                timer->active = false;
+            }
+            timer->handler(timer->p_context);
+            ran = true;
+        }
+    }
+    return ran;
+}
+
+static uint64_t nextTimerUs(void)
+{
+    uint64_t next = SIM_NEVER;
+    unsigned short i;
+    for (i = 0; i < timerCount; i++)
+    {
+        if (timers[i]->active && timers[i]->expiry_us < next)
+        {
+            next = timers[i]->expiry_us;
+        }
+    }
+    return next;
+}
+
+// Moves time on until something wakes the application or untilUs is reached
+static void waitForWakeUp(uint64_t untilUs)
+{
+    for (;;)
+    {
+        uint64_t next = nextTimerUs();
+        if (evtHead != NULL || hostFlashEvents())
+        {
+            return;
+        }
+        next = (nextEventUs < next) ? nextEventUs : next;
+        if (next > untilUs)
+        {
+            nowUs = untilUs;
+            return;
+        }
+        nowUs = next;
+        if (runTimers())
+        {
+            return;
+        }
+        if (nextEventUs <= nowUs)
+        {
+            connectionEvent();
+        }
+    }
+}
+
+static void firmwareEntry(void)
+{
+    firmwareMain();
+    fprintf(stderr, "sim: main() returned\n");
+    exit(2);
+}
+
+static void resumeFirmware(void)
+{
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    inFirmware = true;
+    swapcontext(&simContext, &firmwareContext);
+    inFirmware = false;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    stats.firmwareNs = stats.firmwareNs + (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+}
+
+//=========================================================================== The test's side
+
+void simDefaultLink(s_SimLink *p_link)
+{
+    memset(p_link, 0, sizeof(s_SimLink));
+    p_link->mtu = NRF_SDH_BLE_GATT_MAX_MTU_SIZE;
+    p_link->dataLength = 251;
+    p_link->connIntervalUs = 30000;
+    p_link->minConnIntervalUs = 7500;
+    p_link->eventLengthUs = NRF_SDH_BLE_GAP_EVENT_LENGTH * 1250;
+    p_link->phy2M = true;
+}
+
+void simStart(s_SimLink const *p_link, sim_hvx_handler_t hvxHandler)
+{
+    link = *p_link;
+    centralHvxHandler = hvxHandler;
+    hostFlashInit();
+    getcontext(&firmwareContext);
+    firmwareContext.uc_stack.ss_sp = malloc(SIM_FIRMWARE_STACK);
+    firmwareContext.uc_stack.ss_size = SIM_FIRMWARE_STACK;
+    firmwareContext.uc_link = NULL;
+    makecontext(&firmwareContext, firmwareEntry, 0);
+    resumeFirmware();
+}
+
+bool simRunUntil(bool (*done)(void), uint32_t timeoutMs)
+{
+    uint64_t untilUs = nowUs + timeoutMs * 1000ULL;
+    for (;;)
+    {
+        if (done != NULL && done())
+        {
+            return true;
+        }
+        if (nowUs >= untilUs)
+        {
+            return false;
+        }
+        waitForWakeUp(untilUs);
+        resumeFirmware();
+    }
+}
+
+void simRunFor(uint32_t ms)
+{
+    simRunUntil(NULL, ms);
+}
+
+uint64_t simTimeUs(void)
+{
+    return nowUs;
+}
+
+void simPressButton(bsp_event_t event)
+{
+    if (bspHandler != NULL)
+    {
+        bspHandler(event);
+    }
+}
+
+void simConnect(void)
+{
+    ble_evt_t *evt;
+    if (!advertising || connected)
+    {
+        simError("central cannot connect; the application is not advertising", connected);
+        return;
+    }
+    advertising = false;
+    connected = true;
+    encrypted = false;
+    paired = false;
+    phy2M = false;
+    txOctets = 27;
+    attMtu = BLE_GATT_ATT_MTU_DEFAULT;
+    intervalUs = link.connIntervalUs;
+    nextEventUs = nowUs + intervalUs;
+    memset(cccdValues, 0, sizeof(cccdValues));
+    evt = queueEvent(BLE_GAP_EVT_CONNECTED, 0);
+    evt->evt.gap_evt.conn_handle = SIM_CONN_HANDLE;
+    evt->evt.gap_evt.params.connected.conn_params.min_conn_interval = (uint16_t)(intervalUs / 1250);
+    evt->evt.gap_evt.params.connected.conn_params.max_conn_interval = (uint16_t)(intervalUs / 1250);
+    centralOp(SIM_OP_EXCHANGE_MTU, 0, NULL, 0);
+}
+
+void simPair(void)
+{
+    centralOp(SIM_OP_PAIR, 0, NULL, 0);
+}
+
+bool simPaired(void)
+{
+    return paired;
+}
+
+void simWrite(uint16_t handle, uint8_t const *p_data, uint16_t len)
+{
+    writeDone = false;
+    centralOp(SIM_OP_WRITE, handle, p_data, len);
+}
+
+bool simWriteDone(void)
+{
+    return writeDone;
+}
+
+uint16_t simWriteStatus(void)
+{
+    return writeStatus;
+}
+
+void simDisconnect(void)
+{
+    if (connected)
+    {
+        dropConnection(BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    }
+}
+
+bool simConnected(void)
+{
+    return connected;
+}
+
+bool simPhy2M(void)
+{
+    return phy2M;
+}
+
+s_SimStats const *simStats(void)
+{
+    return &stats;
+}
+
+void simClearStats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+//=========================================================================== SoftDevice and SDK calls
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_file_name)
+{
+    fprintf(stderr, "sim: application error 0x%X at %s:%u\n", error_code, (const char *)p_file_name, line_num);
+    exit(2);
+}
+
+void hostPreemptionPoint(void)
+{
+}
+
+uint32_t sd_app_evt_wait(void)
+{
+    if (!inFirmware)
+    {
+        simError("sd_app_evt_wait() called outside the application", 0);
+        return NRF_ERROR_INVALID_STATE;
+    }
+    swapcontext(&firmwareContext, &simContext);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_softdevice_is_enabled(uint8_t *p_softdevice_enabled)
+{
+    *p_softdevice_enabled = 1;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_mutex_new(nrf_mutex_t *p_mutex)
+{
+    *p_mutex = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_mutex_acquire(nrf_mutex_t *p_mutex)
+{
+    if (*p_mutex != 0)
+    {
+        return NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN;
+    }
+    *p_mutex = 1;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_mutex_release(nrf_mutex_t *p_mutex)
+{
+    *p_mutex = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_sdh_enable_request(void)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t *p_ram_start)
+{
+    *p_ram_start = 0x20002000;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const *p_cfg, uint32_t app_ram_base)
+{
+    if (cfg_id == BLE_CONN_CFG_GATTS)
+    {
+        if (p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size == 0 ||
+            p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size > SIM_HVN_QUEUE_MAX)
+        {
+            simError("notification queue size not supported", p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size);
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        configuredHvnQueueSize = p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_enable(uint32_t *p_app_ram_base)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_evt_get(uint8_t *p_dest, uint16_t *p_len)
+{
+    s_SimEvt *evt = evtHead;
+    if (evt == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (p_dest == NULL)
+    {
+        *p_len = evt->len;
+        return NRF_SUCCESS;
+    }
+    if (*p_len < evt->len)
+    {
+        *p_len = evt->len;
+        return NRF_ERROR_DATA_SIZE;
+    }
+    memcpy(p_dest, &evt->evt, evt->len);
+    *p_len = evt->len;
+    evtHead = evt->next;
+    if (evtHead == NULL)
+    {
+        evtTail = NULL;
+    }
+    free(evt);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_user_mem_reply(uint16_t conn_handle, void const *p_block)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_addr_set(ble_gap_addr_t const *p_addr)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const *p_write_perm, uint8_t const *p_dev_name, uint16_t len)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const *p_conn_params)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_set_configure(uint8_t *p_adv_handle, ble_gap_adv_data_t const *p_adv_data, ble_gap_adv_params_t const *p_adv_params)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag)
+{
+    if (advertising || connected)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    advertising = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    dropConnection(hci_status_code);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const *p_conn_params)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (connParamsPending)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    connParamsRequested = *p_conn_params;
+    connParamsPending = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_phy_update(uint16_t conn_handle, ble_gap_phys_t const *p_gap_phys)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    phyRequested2M = ((p_gap_phys->tx_phys & BLE_GAP_PHY_2MBPS) != 0 || p_gap_phys->tx_phys == BLE_GAP_PHY_AUTO);
+    phyPending = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_data_length_update(uint16_t conn_handle, ble_gap_data_length_params_t const *p_dl_params,
+    ble_gap_data_length_limitation_t *p_dl_limitation)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    dataLengthRequested = (p_dl_params == NULL || p_dl_params->max_tx_octets == BLE_GAP_DATA_LENGTH_AUTO) ?
+        NRF_SDH_BLE_GAP_DATA_LENGTH : p_dl_params->max_tx_octets;
+    if (dataLengthRequested > NRF_SDH_BLE_GAP_DATA_LENGTH)
+    {
+        if (p_dl_limitation != NULL)
+        {
+            p_dl_limitation->tx_payload_limited_octets = dataLengthRequested - NRF_SDH_BLE_GAP_DATA_LENGTH;
+        }
+        return NRF_ERROR_RESOURCES;
+    }
+    dataLengthPending = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status, ble_gap_sec_params_t const *p_sec_params,
+    ble_gap_sec_keyset_t const *p_sec_keyset)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (sec_status != BLE_GAP_SEC_STATUS_SUCCESS)
+    {
+        return NRF_SUCCESS;
+    }
+    if (p_sec_keyset != NULL && p_sec_keyset->keys_own.p_enc_key != NULL)
+    {
+        memset(p_sec_keyset->keys_own.p_enc_key->enc_info.ltk, 0x5A, sizeof(p_sec_keyset->keys_own.p_enc_key->enc_info.ltk));
+        p_sec_keyset->keys_own.p_enc_key->enc_info.ltk_len = 16;
+    }
+    pairingPending = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, ble_gap_enc_info_t const *p_enc_info, ble_gap_irk_t const *p_id_info,
+    void const *p_sign_info)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_auth_key_reply(uint16_t conn_handle, uint8_t key_type, uint8_t const *p_key)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const *p_hvx_params)
+{
+    s_HostGattCharacteristic const *characteristic;
+    s_SimPdu *pdu;
+    uint16_t len = *p_hvx_params->p_len;
+    uint8_t queueSize = (link.hvnQueueSize > 0) ? link.hvnQueueSize : configuredHvnQueueSize;
+
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    characteristic = hostGattByHandle(p_hvx_params->handle);
+    if (characteristic == NULL || characteristic->handles.value_handle != p_hvx_params->handle)
+    {
+        simError("notification or indication on an unknown handle", p_hvx_params->handle);
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((cccdValues[characteristic->handles.cccd_handle % 256] & p_hvx_params->type) == 0)
+    {
+        simError("notification or indication the central has not enabled", p_hvx_params->handle);
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (len > attMtu - SIM_ATT_HEADER)
+    {
+        simError("notification or indication longer than the ATT MTU allows", len);
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if (p_hvx_params->type == BLE_GATT_HVX_INDICATION)
+    {
+        if (indicationState != SIM_INDICATION_NONE)
+        {
+            // main.c retries until the indication goes, so the link has to get there meanwhile
+            while (connected && indicationState != SIM_INDICATION_NONE)
+            {
+                nowUs = nextEventUs;
+                connectionEvent();
+            }
+            return NRF_ERROR_BUSY;
+        }
+        pdu = &indication;
+        indicationState = SIM_INDICATION_QUEUED;
+    }
+    else
+    {
+        if (hvnCount >= queueSize)
+        {
+            return NRF_ERROR_RESOURCES;
+        }
+        pdu = &hvnQueue[(hvnHead + hvnCount) % SIM_HVN_QUEUE_MAX];
+        hvnCount++;
+    }
+    pdu->handle = p_hvx_params->handle;
+    pdu->type = p_hvx_params->type;
+    pdu->len = len;
+    pdu->octetsLeft = len + SIM_ATT_HEADER + SIM_L2CAP_HEADER;
+    memcpy(pdu->data, p_hvx_params->p_data, len);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle, ble_gatts_rw_authorize_reply_params_t const *p_rw_authorize_reply_params)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_rw_authorize_reply_params->type == BLE_GATTS_AUTHORIZE_TYPE_WRITE)
+    {
+        if (!attBusy || writeDone)
+        {
+            simError("write authorize reply without a write request", 0);
+            return NRF_ERROR_INVALID_STATE;
+        }
+        writeStatus = p_rw_authorize_reply_params->params.write.gatt_status;
+        writeDone = true;
+        attBusy = false;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_exchange_mtu_reply(uint16_t conn_handle, uint16_t server_rx_mtu)
+{
+    if (!connected || conn_handle != SIM_CONN_HANDLE)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    attMtu = (server_rx_mtu < link.mtu) ? server_rx_mtu : link.mtu;
+    attMtu = (attMtu < BLE_GATT_ATT_MTU_DEFAULT) ? BLE_GATT_ATT_MTU_DEFAULT : attMtu;
+    attBusy = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, uint8_t const *p_sys_attr_data, uint16_t len, uint32_t flags)
+{
+    return NRF_SUCCESS;
+}
+
+// The CCCDs are not kept across connections, so there is nothing to save
+uint32_t sd_ble_gatts_sys_attr_get(uint16_t conn_handle, uint8_t *p_sys_attr_data, uint16_t *p_len, uint32_t flags)
+{
+    *p_len = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_init(void)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+    app_timer_t *timer = *p_timer_id;
+    if (timerCount >= SIM_TIMERS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    memset(timer, 0, sizeof(app_timer_t));
+    timer->handler = timeout_handler;
+    timer->mode = mode;
+    timers[timerCount++] = timer;
+    return NRF_SUCCESS;
+}
+
+// Like the SDK's, a timer that runs already is left alone
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+    if (timer_id->handler == NULL)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (!timer_id->active)
+    {
+        timer_id->p_context = p_context;
+        timer_id->expiry_us = nowUs + ticksToUs(timeout_ticks);
+        timer_id->period_us = ticksToUs(timeout_ticks);
+        timer_id->active = true;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    timer_id->active = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+    return (uint32_t)((nowUs * APP_TIMER_CLOCK_FREQ / 1000000) & APP_TIMER_MAX_CNT_VAL);
+}
+
+uint32_t bsp_init(uint32_t type, bsp_event_callback_t callback)
+{
+    bspHandler = callback;
+    return NRF_SUCCESS;
+}
+
+uint32_t bsp_btn_ble_init(void (*error_handler)(uint32_t nrf_error), bsp_event_t *p_startup_bsp_evt)
+{
+    if (p_startup_bsp_evt != NULL)
+    {
+        *p_startup_bsp_evt = BSP_EVENT_NOTHING;
+    }
+    return NRF_SUCCESS;
+}
+
+void bsp_board_init(uint32_t init_flags)
+{
+}
+
+void bsp_board_led_on(uint32_t led_idx)
+{
+}
+
+void bsp_board_led_off(uint32_t led_idx)
+{
+}
@@ -0,0 +1,157 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * The PHG side of the host tests that run main.c on ble_sim.c. It reassembles the stored data the
+ * application sends from the GHS segmentation headers and keeps the last RACP response.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "btle_utils.h"
+#include "ghs_central.h"
+#include "sdk_stubs.h"
+
+#define SEGMENT_FIRST   0x01
+#define SEGMENT_LAST    0x02
+
+s_GhsCentral ghsCentral;
+
+static uint16_t racpHandle = BLE_GATT_HANDLE_INVALID;
+static uint16_t storedDataHandle = BLE_GATT_HANDLE_INVALID;
+static bool inRecord = false;
+
+static void onHvx(uint16_t handle, uint8_t type, uint8_t const *p_data, uint16_t len)
+{
+    if (handle == racpHandle)
+    {
+        ghsCentral.racpResponseLength = (len < sizeof(ghsCentral.racpResponse)) ? len : sizeof(ghsCentral.racpResponse);
+        memcpy(ghsCentral.racpResponse, p_data, ghsCentral.racpResponseLength);
+        ghsCentral.racpResponses++;
+        ghsCentral.racpResponseUs = simTimeUs();
+    }
+    else if (handle == storedDataHandle && len > SEGMENT_HEADER_LENGTH)
+    {
+        ghsCentral.storedBytes = ghsCentral.storedBytes + len;
+        if (p_data[0] & SEGMENT_FIRST)
+        {
+            unsigned long recordNumber;
+            if (len < SEGMENT_HEADER_LENGTH + RECORD_NUMBER_LENGTH)
+            {
+                ghsCentral.outOfOrder++;
+                return;
+            }
+            recordNumber = p_data[1] | (p_data[2] << 8) | ((unsigned long)p_data[3] << 16) | ((unsigned long)p_data[4] << 24);
+            if (ghsCentral.records == 1 && !inRecord && recordNumber == ghsCentral.firstRecordNumber)
+            {
+                // The scale sends its height settings ahead of the first record, under the number of that record
+                ghsCentral.records = 0;
+                ghsCentral.leadingGroups++;
+            }
+            if (inRecord || (ghsCentral.records > 0 && recordNumber != ghsCentral.lastRecordNumber + 1))
+            {
+                ghsCentral.outOfOrder++;
+            }
+            if (ghsCentral.records == 0)
+            {
+                ghsCentral.firstRecordNumber = recordNumber;
+            }
+            ghsCentral.lastRecordNumber = recordNumber;
+            inRecord = true;
+        }
+        else if (!inRecord)
+        {
+            ghsCentral.outOfOrder++;
+        }
+        if (p_data[0] & SEGMENT_LAST)
+        {
+            if (inRecord)
+            {
+                ghsCentral.records++;
+            }
+            inRecord = false;
+        }
+    }
+}
+
+static bool writeCccd(uint16_t handle, uint8_t value)
+{
+    uint8_t cccd[2] = {value, 0};
+    simWrite(handle, cccd, sizeof(cccd));
+    return simRunUntil(simWriteDone, 1000) && simWriteStatus() == BLE_GATT_STATUS_SUCCESS;
+}
+
+void ghsCentralClear(void)
+{
+    memset(&ghsCentral, 0, sizeof(ghsCentral));
+    inRecord = false;
+}
+
+bool ghsCentralStart(s_SimLink const *p_link, unsigned short storedMsmts, uint8_t storedCccd)
+{
+    s_HostGattCharacteristic const *racp;
+    s_HostGattCharacteristic const *storedData;
+    unsigned short i;
+
+    ghsCentralClear();
+    simStart(p_link, onHvx);
+    racp = hostGattByUuid(BTLE_RACP_CHAR);
+    storedData = hostGattByUuid(BTLE_GHS_BT_SIG_STORED_DATA_NOT_CHAR);
+    if (racp == NULL || storedData == NULL)
+    {
+        printf("  the application has no RACP or stored data characteristic\n");
+        return false;
+    }
+    racpHandle = racp->handles.value_handle;
+    storedDataHandle = storedData->handles.value_handle;
+
+    for (i = 0; i < storedMsmts; i++)
+    {
+        simPressButton(BSP_EVENT_KEY_3);
+        simRunFor(10);
+    }
+    simPressButton(BSP_EVENT_KEY_2);
+    simRunFor(100);
+    simConnect();
+    simRunFor(200);
+    simPair();
+    if (!simRunUntil(simPaired, 1000))
+    {
+        printf("  pairing did not complete\n");
+        return false;
+    }
+    if (!writeCccd(racp->handles.cccd_handle, BLE_GATT_HVX_INDICATION) || !writeCccd(storedData->handles.cccd_handle, storedCccd))
+    {
+        printf("  enabling the CCCDs failed\n");
+        return false;
+    }
+    return true;
+}
+
+bool ghsCentralRacp(uint8_t const *p_cmd, uint16_t len)
+{
+    simWrite(racpHandle, p_cmd, len);
+    return simRunUntil(simWriteDone, 1000) && simWriteStatus() == BLE_GATT_STATUS_SUCCESS;
+}
+
+bool ghsCentralRacpResponded(void)
+{
+    return ghsCentral.racpResponses > 0;
+}
@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Benchmark of updateGroup() against the update calls it replaced, on the blood pressure group created from its
+ * template. RECORDS random records, half with a status, are encoded by each of:
+ *   mder calls     updateDataGhsMsmtRefs(), updateDataCompound() and updateDataNumeric() with s_MderFloats,
+ *                  updateDataBits() and the two time stamp updates, as encodeSpecializationMsmts() did
+ *   float calls    the same with the pulse rate written by updateDataNumericFloat()
+ *   updateGroup    one updateGroup() with the field map configureSpecializations() makes
+ * First every record is encoded by all three and the data arrays are compared byte for byte. Then the three are
+ * timed in turn, ROUNDS times, so that a slow spell of the machine hits all of them. The thread CPU time per group
+ * is printed as the minimum and the median of the rounds, and each variant's time over the mder calls' time of the
+ * same round as the median of the rounds. That ratio is the number to compare; it moves far less from run to run
+ * than the times do.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include "btle_utils.h"
+#include "configGhsEncoder.h"
+#include "handleSpecializations.h"
+#include "msmtGroupTemplates.h"
+#include "msmt_queue.h"
+#include "nomenclature.h"
+
+#define RECORDS     1024
+#define ROUNDS      201
+#define VARIANTS    3
+
+// Defined by main.c on the target
+s_Queue *queue = NULL;
+volatile s_global_send global_send;
+void ble_disconnected_handler(void *p_context) {}
+bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNumber) { return false; }
+
+void hostPreemptionPoint(void) {}
+
+typedef struct
+{
+    s_MsmtGroupData *data;
+    bool reportStatus;
+}s_BenchGroup;
+
+static s_MsmtData records[RECORDS];
+static s_BenchGroup groups[VARIANTS];
+static s_MsmtGroupData groupData[VARIANTS];
+static s_GhsMsmtIndex groupIndex[VARIANTS][sizeof(bpGroupTemplateIndex) / sizeof(s_GhsMsmtIndex)];
+static unsigned char groupBuffers[VARIANTS][SEGMENT_HEADROOM + sizeof(bpGroupTemplateData)];
+static s_GroupFieldMap bpFieldMap;
+static short bp_index;
+static short pr_index;
+static short status_index;
+
+static void setStatus(s_BenchGroup *group, s_MsmtData *msmt)
+{
+    if (msmt->hasStatus && !group->reportStatus)
+    {
+        updateDataRestoreLastMsmt(&group->data);
+        group->reportStatus = true;
+    }
+    else if (!msmt->hasStatus && group->reportStatus)
+    {
+        updateDataDropLastMsmt(&group->data);
+        group->reportStatus = false;
+    }
+}
+
+static void encodeMderCalls(s_BenchGroup *group, s_MsmtData *msmt, unsigned long *msmt_id)
+{
+    s_MderFloat mder[3];
+    int i;
+    setStatus(group, msmt);
+    for (i = 0; i < 3; i++)
+    {
+        mder[i].mderFloatType = MDER_FLOAT;
+        mder[i].specialValue = MDER_NUMBER;
+        mder[i].exponent = 0;
+    }
+    mder[0].mantissa = msmt->systolic;
+    mder[1].mantissa = msmt->diastolic;
+    mder[2].mantissa = msmt->mean;
+    updateDataGhsMsmtRefs(&group->data, status_index, *msmt_id, 0);
+    updateDataCompound(&group->data, bp_index, mder, (*msmt_id)++);
+    mder[0].mantissa = msmt->pulseRate;
+    updateDataGhsMsmtRefs(&group->data, status_index, *msmt_id, 1);
+    updateDataNumeric(&group->data, pr_index, &mder[0], (*msmt_id)++);
+    if (msmt->hasStatus)
+    {
+        updateDataBits(&group->data, status_index, (msmt->status_cuff_too_loose | msmt->status_improper_position
+            | msmt->status_irregular_pulse | msmt->status_movement), (*msmt_id)++);
+    }
+    updateTimeStampEpoch(&group->data, msmt->common.sGhsTime.epoch);
+    updateTimeStampTimeline(&group->data, msmt->common.sGhsTime.flagKnownTimeline);
+}
+
+static void encodeFloatCalls(s_BenchGroup *group, s_MsmtData *msmt, unsigned long *msmt_id)
+{
+    s_MderFloat mder[3];
+    int i;
+    setStatus(group, msmt);
+    for (i = 0; i < 3; i++)
+    {
+        mder[i].mderFloatType = MDER_FLOAT;
+        mder[i].specialValue = MDER_NUMBER;
+        mder[i].exponent = 0;
+    }
+    mder[0].mantissa = msmt->systolic;
+    mder[1].mantissa = msmt->diastolic;
+    mder[2].mantissa = msmt->mean;
+    updateDataGhsMsmtRefs(&group->data, status_index, *msmt_id, 0);
+    updateDataCompound(&group->data, bp_index, mder, (*msmt_id)++);
+    updateDataGhsMsmtRefs(&group->data, status_index, *msmt_id, 1);
+    updateDataNumericFloat(&group->data, pr_index, MDER_FLOAT_FROM_INTEGERS(0, msmt->pulseRate), (*msmt_id)++);
+    if (msmt->hasStatus)
+    {
+        updateDataBits(&group->data, status_index, (msmt->status_cuff_too_loose | msmt->status_improper_position
+            | msmt->status_irregular_pulse | msmt->status_movement), (*msmt_id)++);
+    }
+    updateTimeStampEpoch(&group->data, msmt->common.sGhsTime.epoch);
+    updateTimeStampTimeline(&group->data, msmt->common.sGhsTime.flagKnownTimeline);
+}
+
+static void encodeUpdateGroup(s_BenchGroup *group, s_MsmtData *msmt, unsigned long *msmt_id)
+{
+    setStatus(group, msmt);
+    updateGroup(&group->data, &bpFieldMap, msmt, msmt_id);
+}
+
+typedef void (*encoder)(s_BenchGroup *group, s_MsmtData *msmt, unsigned long *msmt_id);
+static const encoder ENCODERS[VARIANTS] = {encodeMderCalls, encodeFloatCalls, encodeUpdateGroup};
+static const char *NAMES[VARIANTS] = {"mder calls", "float calls", "updateGroup"};
+
+static void makeRecords(void)
+{
+    int i;
+    srand(1);
+    memset(records, 0, sizeof(records));
+    for (i = 0; i < RECORDS; i++)
+    {
+        s_MsmtData *msmt = &records[i];
+        msmt->common.sGhsTime.epoch = 1700000000000ULL + (unsigned long long)i * 60000 + (rand() % 1000);
+        msmt->common.sGhsTime.flagKnownTimeline = (rand() & 1) ? GHS_TIME_FLAG_ON_CURRENT_TIMELINE : 0;
+        msmt->systolic = 90 + rand() % 90;
+        msmt->diastolic = 50 + rand() % 50;
+        msmt->mean = (msmt->systolic + 2 * msmt->diastolic) / 3;
+        msmt->pulseRate = 40 + rand() % 140;
+        msmt->hasStatus = (rand() & 1);
+        msmt->status_movement = (rand() & 1) ? BP_STATUS_MOVEMENT : 0;
+        msmt->status_cuff_too_loose = (rand() & 1) ? BP_STATUS_CUFF_TOO_LOOSE : 0;
+        msmt->status_irregular_pulse = (rand() & 1) ? BP_STATUS_IRREGULAR_PULSE : 0;
+        msmt->status_improper_position = (rand() & 1) ? BP_STATUS_IMPROPER_POSITION : 0;
+    }
+}
+
+static bool makeGroups(void)
+{
+    s_GhsTime *sGhsTime = NULL;
+    int v;
+    if (!createGhsTime(&sGhsTime, GHS_TIME_OFFSET_UNSUPPORTED, GHS_TIME_FLAGS_EPOCH_TIME,
+        GHS_TIME_FLAG_SUPPORTS_MILLISECONDS, INFRA_MDC_TIME_SYNC_NONE)) return false;
+    for (v = 0; v < VARIANTS; v++)
+    {
+        // MSMT_GROUP_DATA_STORAGE() by hand, as there are three groups of the one template
+        s_MsmtGroupDataStorage storage =
+        {
+            .msmtGroupData = &groupData[v], .sGhsMsmtIndex = groupIndex[v], .buffers = groupBuffers[v],
+            .numberOfGhsMsmts = sizeof(groupIndex[v]) / sizeof(s_GhsMsmtIndex), .bufferLength = sizeof(bpGroupTemplateData),
+            .numberOfBuffers = 1
+        };
+        if (!createMsmtGroupDataArrayFromTemplate(&groups[v].data, &bpGroupTemplate, sGhsTime, &storage)) return false;
+        groups[v].reportStatus = true;
+    }
+    bp_index = getMsmtIndexOfType(groups[0].data, MDC_PRESS_BLD_NONINV);
+    pr_index = getMsmtIndexOfType(groups[0].data, MDC_PULS_RATE_NON_INV);
+    status_index = getMsmtIndexOfType(groups[0].data, MDC_BLOOD_PRESSURE_MEASUREMENT_STATUS);
+    // The map of configureSpecializations()
+    return addGroupFieldNumeric(&bpFieldMap, groups[0].data, bp_index, 0, offsetof(s_MsmtData, systolic), sizeof(unsigned short), false, 0)
+        && addGroupFieldNumeric(&bpFieldMap, groups[0].data, bp_index, 1, offsetof(s_MsmtData, diastolic), sizeof(unsigned short), false, 0)
+        && addGroupFieldNumeric(&bpFieldMap, groups[0].data, bp_index, 2, offsetof(s_MsmtData, mean), sizeof(unsigned short), false, 0)
+        && addGroupFieldNumeric(&bpFieldMap, groups[0].data, pr_index, 0, offsetof(s_MsmtData, pulseRate), sizeof(unsigned short), false, 0)
+        && addGroupFieldRef(&bpFieldMap, groups[0].data, status_index, 0, bp_index)
+        && addGroupFieldRef(&bpFieldMap, groups[0].data, status_index, 1, pr_index)
+        && addGroupFieldBits(&bpFieldMap, groups[0].data, status_index, offsetof(s_MsmtData, status_cuff_too_loose), sizeof(unsigned short))
+        && addGroupFieldBits(&bpFieldMap, groups[0].data, status_index, offsetof(s_MsmtData, status_improper_position), sizeof(unsigned short))
+        && addGroupFieldBits(&bpFieldMap, groups[0].data, status_index, offsetof(s_MsmtData, status_irregular_pulse), sizeof(unsigned short))
+        && addGroupFieldBits(&bpFieldMap, groups[0].data, status_index, offsetof(s_MsmtData, status_movement), sizeof(unsigned short))
+        && addGroupFieldTimeStamp(&bpFieldMap, groups[0].data, offsetof(s_MsmtData, common.sGhsTime.epoch),
+            offsetof(s_MsmtData, common.sGhsTime.flagKnownTimeline));
+}
+
+// Every variant has to give the same data array for every record
+static bool checkSameBytes(void)
+{
+    unsigned long msmt_id[VARIANTS] = {1, 1, 1};
+    int i;
+    int v;
+    for (i = 0; i < RECORDS; i++)
+    {
+        for (v = 0; v < VARIANTS; v++)
+        {
+            ENCODERS[v](&groups[v], &records[i], &msmt_id[v]);
+        }
+        for (v = 1; v < VARIANTS; v++)
+        {
+            if (groups[v].data->dataLength != groups[0].data->dataLength
+                || memcmp(groups[v].data->data, groups[0].data->data, groups[0].data->dataLength) != 0
+                || msmt_id[v] != msmt_id[0])
+            {
+                printf("%s differs from %s at record %d\n", NAMES[v], NAMES[0], i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static double passNs(int v)
+{
+    struct timespec start;
+    struct timespec end;
+    unsigned long msmt_id = 1;
+    int i;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for (i = 0; i < RECORDS; i++)
+    {
+        ENCODERS[v](&groups[v], &records[i], &msmt_id);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / RECORDS;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void)
+{
+    static double ns[VARIANTS][ROUNDS];
+    static double ratio[VARIANTS][ROUNDS];
+    int r;
+    int v;
+
+    makeRecords();
+    if (!makeGroups())
+    {
+        printf("group_bench: could not create the bp group\n");
+        return 1;
+    }
+    if (!checkSameBytes())
+    {
+        printf("group_bench: FAILED\n");
+        return 1;
+    }
+    for (v = 0; v < VARIANTS; v++)
+    {
+        passNs(v);  // Warm up
+    }
+    for (r = 0; r < ROUNDS; r++)
+    {
+        for (v = 0; v < VARIANTS; v++)
+        {
+            ns[v][r] = passNs(v);
+        }
+        for (v = 0; v < VARIANTS; v++)
+        {
+            ratio[v][r] = ns[v][r] / ns[0][r];
+        }
+    }
+    printf("bp group, %d records, %d rounds, ns per group\n%-12s %8s %8s %8s\n", RECORDS, ROUNDS, "", "min", "median",
+        "vs mder");
+    for (v = 0; v < VARIANTS; v++)
+    {
+        qsort(ns[v], ROUNDS, sizeof(double), compareDoubles);
+        qsort(ratio[v], ROUNDS, sizeof(double), compareDoubles);
+        printf("%-12s %8.1f %8.1f %8.3f\n", NAMES[v], ns[v][0], ns[v][ROUNDS / 2], ratio[v][ROUNDS / 2]);
+    }
+    return 0;
+}
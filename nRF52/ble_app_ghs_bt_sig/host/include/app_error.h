@@ -0,0 +1,41 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the SDK error module. app_error_handler() is in ble_sim.c; it reports and aborts
+#ifndef HOST_APP_ERROR_H__
+#define HOST_APP_ERROR_H__
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_file_name);
+
+#define APP_ERROR_HANDLER(ERR_CODE) app_error_handler((ERR_CODE), __LINE__, (const uint8_t *)__FILE__)
+#define APP_ERROR_CHECK(ERR_CODE) \
+    do \
+    { \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE); \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS) \
+        { \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE); \
+        } \
+    } while (0)
+
+#endif
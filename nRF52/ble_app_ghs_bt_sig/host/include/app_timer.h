@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the app timer on the simulated RTC of ble_sim.c. Handlers run from the
+// simulation loop, as they would from the RTC interrupt
+#ifndef HOST_APP_TIMER_H__
+#define HOST_APP_TIMER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define APP_TIMER_CLOCK_FREQ    32768
+#define APP_TIMER_MAX_CNT_VAL   0x00FFFFFF
+#define APP_TIMER_TICKS(MS)     ((uint32_t)(((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ + 500) / 1000))
+
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+
+typedef enum
+{
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct
+{
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t mode;
+    void *p_context;
+    uint64_t expiry_us;
+    uint64_t period_us;
+    bool active;
+} app_timer_t;
+
+typedef app_timer_t *app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id) \
+    static app_timer_t timer_id##_data; \
+    static const app_timer_id_t timer_id = &timer_id##_data
+
+uint32_t app_timer_init(void);
+uint32_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+
+#endif
@@ -0,0 +1,344 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the SoftDevice BLE API: the types, constants and calls the application sources use.
+// Names and meanings follow the S140 headers; layouts are simplified. The calls are in sdk_stubs.c (GATT
+// table) and ble_sim.c (events and the link).
+#ifndef HOST_BLE_H__
+#define HOST_BLE_H__
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+#define BLE_CONN_HANDLE_INVALID         0xFFFF
+#define BLE_GATT_HANDLE_INVALID         0x0000
+#define BLE_GATT_ATT_MTU_DEFAULT        23
+#define BLE_L2CAP_MTU_MIN               23
+
+#define BLE_GATT_HVX_INVALID            0x00
+#define BLE_GATT_HVX_NOTIFICATION       0x01
+#define BLE_GATT_HVX_INDICATION         0x02
+
+#define BLE_GATT_STATUS_SUCCESS                         0x0000
+#define BLE_GATT_STATUS_ATTERR_APP_BEGIN                0x0180
+#define BLE_GATT_STATUS_ATTERR_CPS_CCCD_CONFIG_ERROR    0x01FD
+#define BLE_GATT_STATUS_ATTERR_CPS_PROC_ALR_IN_PROG     0x01FE
+
+#define BLE_GATTS_SRVC_TYPE_PRIMARY     0x01
+#define BLE_GATTS_VLOC_STACK            0x01
+#define BLE_GATTS_AUTHORIZE_TYPE_INVALID    0x00
+#define BLE_GATTS_AUTHORIZE_TYPE_READ       0x01
+#define BLE_GATTS_AUTHORIZE_TYPE_WRITE      0x02
+#define BLE_GATTS_OP_INVALID                0x00
+#define BLE_GATTS_OP_WRITE_REQ              0x01
+#define BLE_GATTS_OP_WRITE_CMD              0x02
+#define BLE_GATTS_OP_PREP_WRITE_REQ         0x04
+#define BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL  0x05
+#define BLE_GATTS_OP_EXEC_WRITE_REQ_NOW     0x06
+#define BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS   (1 << 0)
+#define BLE_GATTS_SYS_ATTR_FLAG_USR_SRVCS   (1 << 1)
+
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION   0x13
+#define BLE_HCI_CONN_INTERVAL_UNACCEPTABLE          0x3B
+
+#define BLE_GAP_ADDR_TYPE_PUBLIC                0x00
+#define BLE_GAP_PHY_AUTO                        0x00
+#define BLE_GAP_PHY_1MBPS                       0x01
+#define BLE_GAP_PHY_2MBPS                       0x02
+#define BLE_GAP_DATA_LENGTH_AUTO                0
+#define BLE_GAP_IO_CAPS_NONE                    0x03
+#define BLE_GAP_SEC_STATUS_SUCCESS              0x00
+#define BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP     0x85
+#define BLE_GAP_AUTH_KEY_TYPE_NONE              0x00
+#define BLE_GAP_AD_TYPE_FLAGS                       0x01
+#define BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE 0x03
+#define BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME         0x09
+#define BLE_GAP_AD_TYPE_SERVICE_DATA                0x16
+#define BLE_GAP_AD_TYPE_APPEARANCE                  0x19
+#define BLE_GAP_ADV_FLAG_LE_GENERAL_DISC_MODE       0x02
+#define BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED       0x04
+#define BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED   0x01
+#define BLE_GAP_ADV_FP_ANY                          0x00
+#define BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED       0
+
+#define BLE_CONN_CFG_GATTS              0x24
+
+#define BLE_APPEARANCE_UNKNOWN                      0
+#define BLE_APPEARANCE_GENERIC_HEART_RATE_SENSOR    832
+#define BLE_APPEARANCE_GENERIC_BLOOD_PRESSURE       896
+#define BLE_APPEARANCE_THERMOMETER_EAR              769
+#define BLE_APPEARANCE_GENERIC_GLUCOSE_METER        1024
+#define BLE_APPEARANCE_PULSE_OXIMETER_FINGERTIP     3137
+#define BLE_APPEARANCE_GENERIC_WEIGHT_SCALE         3200
+
+enum
+{
+    BLE_EVT_USER_MEM_REQUEST = 0x01,
+    BLE_GAP_EVT_CONNECTED = 0x10,
+    BLE_GAP_EVT_DISCONNECTED,
+    BLE_GAP_EVT_CONN_PARAM_UPDATE,
+    BLE_GAP_EVT_SEC_PARAMS_REQUEST,
+    BLE_GAP_EVT_SEC_INFO_REQUEST,
+    BLE_GAP_EVT_AUTH_KEY_REQUEST,
+    BLE_GAP_EVT_AUTH_STATUS,
+    BLE_GAP_EVT_CONN_SEC_UPDATE,
+    BLE_GAP_EVT_TIMEOUT,
+    BLE_GAP_EVT_PHY_UPDATE_REQUEST,
+    BLE_GAP_EVT_PHY_UPDATE,
+    BLE_GAP_EVT_DATA_LENGTH_UPDATE_REQUEST,
+    BLE_GAP_EVT_DATA_LENGTH_UPDATE,
+    BLE_GATTC_EVT_TIMEOUT = 0x3A,
+    BLE_GATTS_EVT_WRITE = 0x50,
+    BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST,
+    BLE_GATTS_EVT_SYS_ATTR_MISSING,
+    BLE_GATTS_EVT_HVC,
+    BLE_GATTS_EVT_SC_CONFIRM,
+    BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST,
+    BLE_GATTS_EVT_TIMEOUT,
+    BLE_GATTS_EVT_HVN_TX_COMPLETE
+};
+
+typedef struct { uint16_t uuid; uint8_t type; } ble_uuid_t;
+typedef struct { uint8_t sm : 4; uint8_t lv : 4; } ble_gap_conn_sec_mode_t;
+typedef struct { uint16_t value_handle, user_desc_handle, cccd_handle, sccd_handle; } ble_gatts_char_handles_t;
+
+typedef struct
+{
+    ble_gap_conn_sec_mode_t read_perm;
+    ble_gap_conn_sec_mode_t write_perm;
+    uint8_t vlen : 1;
+    uint8_t vloc : 2;
+    uint8_t rd_auth : 1;
+    uint8_t wr_auth : 1;
+} ble_gatts_attr_md_t;
+
+typedef struct
+{
+    struct { uint8_t read : 1, write : 1, notify : 1, indicate : 1; } char_props;
+    uint8_t const *p_char_user_desc;
+    void const *p_char_pf;
+    ble_gatts_attr_md_t const *p_user_desc_md;
+    ble_gatts_attr_md_t const *p_cccd_md;
+    ble_gatts_attr_md_t const *p_sccd_md;
+} ble_gatts_char_md_t;
+
+typedef struct
+{
+    ble_uuid_t const *p_uuid;
+    ble_gatts_attr_md_t const *p_attr_md;
+    uint16_t init_len;
+    uint16_t init_offs;
+    uint16_t max_len;
+    uint8_t *p_value;
+} ble_gatts_attr_t;
+
+typedef struct
+{
+    uint16_t handle;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t *p_len;
+    uint8_t const *p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct
+{
+    uint8_t type;
+    union
+    {
+        struct { uint16_t gatt_status; uint8_t update : 1; uint16_t offset; uint16_t len; uint8_t const *p_data; } read;
+        struct { uint16_t gatt_status; uint8_t update : 1; uint16_t offset; uint16_t len; uint8_t const *p_data; } write;
+    } params;
+} ble_gatts_rw_authorize_reply_params_t;
+
+typedef struct
+{
+    uint16_t handle;
+    ble_uuid_t uuid;
+    uint8_t op;
+    uint8_t auth_required;
+    uint16_t offset;
+    uint16_t len;
+    uint8_t data[1];                // Variable length
+} ble_gatts_evt_write_t;
+
+typedef struct
+{
+    uint8_t type;
+    struct
+    {
+        struct { uint16_t handle; ble_uuid_t uuid; uint16_t offset; } read;
+        ble_gatts_evt_write_t write;
+    } request;
+} ble_gatts_evt_rw_authorize_request_t;
+
+typedef struct
+{
+    uint16_t min_conn_interval;
+    uint16_t max_conn_interval;
+    uint16_t slave_latency;
+    uint16_t conn_sup_timeout;
+} ble_gap_conn_params_t;
+
+typedef struct { uint8_t addr_id_peer : 1; uint8_t addr_type : 7; uint8_t addr[6]; } ble_gap_addr_t;
+typedef struct { uint8_t tx_phys; uint8_t rx_phys; } ble_gap_phys_t;
+typedef struct { uint16_t max_tx_octets, max_rx_octets, max_tx_time_us, max_rx_time_us; } ble_gap_data_length_params_t;
+typedef struct { uint16_t tx_payload_limited_octets, rx_payload_limited_octets, tx_rx_time_limited_us; } ble_gap_data_length_limitation_t;
+
+typedef struct { uint8_t enc : 1, id : 1, sign : 1, link : 1; } ble_gap_sec_kdist_t;
+typedef struct
+{
+    uint8_t bond : 1, mitm : 1, lesc : 1, keypress : 1, io_caps : 3, oob : 1;
+    uint8_t min_key_size;
+    uint8_t max_key_size;
+    ble_gap_sec_kdist_t kdist_own;
+    ble_gap_sec_kdist_t kdist_peer;
+} ble_gap_sec_params_t;
+
+typedef struct { uint8_t ltk[16]; uint8_t lesc : 1, auth : 1, ltk_len : 6; } ble_gap_enc_info_t;
+typedef struct { uint16_t ediv; uint8_t rand[8]; } ble_gap_master_id_t;
+typedef struct { uint8_t irk[16]; } ble_gap_irk_t;
+typedef struct { ble_gap_enc_info_t enc_info; ble_gap_master_id_t master_id; } ble_gap_enc_key_t;
+typedef struct { ble_gap_irk_t id_info; ble_gap_addr_t id_addr_info; } ble_gap_id_key_t;
+typedef struct { uint8_t csrk[16]; } ble_gap_sign_info_t;
+typedef struct { uint8_t pk[64]; } ble_gap_lesc_p256_pk_t;
+
+typedef struct
+{
+    ble_gap_enc_key_t *p_enc_key;
+    ble_gap_id_key_t *p_id_key;
+    ble_gap_sign_info_t *p_sign_key;
+    ble_gap_lesc_p256_pk_t *p_pk;
+} ble_gap_sec_keys_t;
+
+typedef struct { ble_gap_sec_keys_t keys_own; ble_gap_sec_keys_t keys_peer; } ble_gap_sec_keyset_t;
+
+typedef struct { ble_gap_addr_t peer_addr; ble_gap_master_id_t master_id; uint8_t enc_info : 1, id_info : 1, sign_info : 1; } ble_gap_evt_sec_info_request_t;
+
+typedef struct { uint8_t type : 4, anonymous : 1, include_tx_power : 1; } ble_gap_adv_properties_t;
+typedef struct
+{
+    ble_gap_adv_properties_t properties;
+    ble_gap_addr_t const *p_peer_addr;
+    uint32_t interval;
+    uint16_t duration;
+    uint8_t max_adv_evts;
+    uint8_t channel_mask[5];
+    uint8_t filter_policy;
+    uint8_t primary_phy;
+    uint8_t secondary_phy;
+} ble_gap_adv_params_t;
+typedef struct { uint8_t *p_data; uint16_t len; } ble_data_t;
+typedef struct { ble_data_t adv_data; ble_data_t scan_rsp_data; } ble_gap_adv_data_t;
+
+typedef struct
+{
+    uint16_t conn_handle;
+    union
+    {
+        struct { ble_gap_addr_t peer_addr; uint8_t role; ble_gap_conn_params_t conn_params; } connected;
+        struct { uint8_t reason; } disconnected;
+        struct { ble_gap_conn_params_t conn_params; } conn_param_update;
+        struct { ble_gap_sec_params_t peer_params; } sec_params_request;
+        ble_gap_evt_sec_info_request_t sec_info_request;
+        struct { uint8_t auth_status; } auth_status;
+        struct { ble_gap_phys_t peer_preferred_phys; } phy_update_request;
+        struct { uint8_t status; uint8_t tx_phy; uint8_t rx_phy; } phy_update;
+        struct { ble_gap_data_length_params_t peer_params; } data_length_update_request;
+        struct { ble_gap_data_length_params_t effective_params; } data_length_update;
+    } params;
+} ble_gap_evt_t;
+
+typedef struct
+{
+    uint16_t conn_handle;
+    union
+    {
+        ble_gatts_evt_write_t write;
+        ble_gatts_evt_rw_authorize_request_t authorize_request;
+        struct { uint8_t hint; } sys_attr_missing;
+        struct { uint16_t handle; } hvc;
+        struct { uint16_t client_rx_mtu; } exchange_mtu_request;
+        struct { uint8_t src; } timeout;
+        struct { uint8_t count; } hvn_tx_complete;
+    } params;
+} ble_gatts_evt_t;
+
+typedef struct { uint16_t conn_handle; } ble_gattc_evt_t;
+
+typedef struct
+{
+    struct { uint16_t evt_id; uint16_t evt_len; } header;
+    union
+    {
+        ble_gap_evt_t gap_evt;
+        ble_gatts_evt_t gatts_evt;
+        ble_gattc_evt_t gattc_evt;
+    } evt;
+} ble_evt_t;
+
+typedef struct
+{
+    struct
+    {
+        uint8_t conn_cfg_tag;
+        union
+        {
+            struct { uint8_t hvn_tx_queue_size; } gatts_conn_cfg;
+        } params;
+    } conn_cfg;
+} ble_cfg_t;
+
+#define BLE_UUID_BLE_ASSIGN(instance, value) do { (instance).type = 1; (instance).uuid = (value); } while (0)
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr) do { (ptr)->sm = 1; (ptr)->lv = 1; } while (0)
+
+// GATT table (sdk_stubs.c)
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const *p_uuid, uint16_t *p_handle);
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const *p_char_md,
+    ble_gatts_attr_t const *p_attr_char_value, ble_gatts_char_handles_t *p_handles);
+
+// Events and the link (ble_sim.c)
+uint32_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const *p_cfg, uint32_t app_ram_base);
+uint32_t sd_ble_enable(uint32_t *p_app_ram_base);
+uint32_t sd_ble_evt_get(uint8_t *p_dest, uint16_t *p_len);
+uint32_t sd_ble_user_mem_reply(uint16_t conn_handle, void const *p_block);
+uint32_t sd_ble_gap_addr_set(ble_gap_addr_t const *p_addr);
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const *p_write_perm, uint8_t const *p_dev_name, uint16_t len);
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance);
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const *p_conn_params);
+uint32_t sd_ble_gap_adv_set_configure(uint8_t *p_adv_handle, ble_gap_adv_data_t const *p_adv_data, ble_gap_adv_params_t const *p_adv_params);
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag);
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code);
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const *p_conn_params);
+uint32_t sd_ble_gap_phy_update(uint16_t conn_handle, ble_gap_phys_t const *p_gap_phys);
+uint32_t sd_ble_gap_data_length_update(uint16_t conn_handle, ble_gap_data_length_params_t const *p_dl_params,
+    ble_gap_data_length_limitation_t *p_dl_limitation);
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status, ble_gap_sec_params_t const *p_sec_params,
+    ble_gap_sec_keyset_t const *p_sec_keyset);
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, ble_gap_enc_info_t const *p_enc_info, ble_gap_irk_t const *p_id_info,
+    void const *p_sign_info);
+uint32_t sd_ble_gap_auth_key_reply(uint16_t conn_handle, uint8_t key_type, uint8_t const *p_key);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const *p_hvx_params);
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle, ble_gatts_rw_authorize_reply_params_t const *p_rw_authorize_reply_params);
+uint32_t sd_ble_gatts_exchange_mtu_reply(uint16_t conn_handle, uint16_t server_rx_mtu);
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, uint8_t const *p_sys_attr_data, uint16_t len, uint32_t flags);
+uint32_t sd_ble_gatts_sys_attr_get(uint16_t conn_handle, uint8_t *p_sys_attr_data, uint16_t *p_len, uint32_t flags);
+
+#endif
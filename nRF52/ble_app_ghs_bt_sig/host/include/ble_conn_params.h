@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the connection parameters module types; main.c only fills them in
+#ifndef HOST_BLE_CONN_PARAMS_H__
+#define HOST_BLE_CONN_PARAMS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+
+typedef enum
+{
+    BLE_CONN_PARAMS_EVT_FAILED,
+    BLE_CONN_PARAMS_EVT_SUCCEEDED
+} ble_conn_params_evt_type_t;
+
+typedef struct
+{
+    ble_conn_params_evt_type_t evt_type;
+} ble_conn_params_evt_t;
+
+typedef void (*ble_conn_params_evt_handler_t)(ble_conn_params_evt_t *p_evt);
+
+typedef struct
+{
+    ble_gap_conn_params_t *p_conn_params;
+    uint32_t first_conn_params_update_delay;
+    uint32_t next_conn_params_update_delay;
+    uint8_t max_conn_params_update_count;
+    uint16_t start_on_notify_cccd_handle;
+    bool disconnect_on_fail;
+    ble_conn_params_evt_handler_t evt_handler;
+    void (*error_handler)(uint32_t nrf_error);
+} ble_conn_params_init_t;
+
+#endif
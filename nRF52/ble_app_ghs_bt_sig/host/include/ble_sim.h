@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the SoftDevice BLE stack and a central, for running main.c on a PC; see ble_sim.c
+#ifndef HOST_BLE_SIM_H__
+#define HOST_BLE_SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "bsp.h"
+
+// What the central and the radio allow. The application asks for the rest as it does on the target
+typedef struct
+{
+    uint16_t mtu;                   // ATT MTU the central asks for in its exchange
+    uint16_t dataLength;            // Largest LL payload the central takes, 27 to 251 octets
+    uint8_t hvnQueueSize;           // SoftDevice notification queue; 0 takes what the application configures
+    uint8_t maxPacketsPerEvent;     // Packets the central takes per connection event; 0 is no limit
+    uint32_t connIntervalUs;        // Connection interval until the application asks for another
+    uint32_t minConnIntervalUs;     // Shortest interval the central grants
+    uint32_t eventLengthUs;         // Radio time of a connection event
+    bool phy2M;                     // The central takes the 2M PHY when asked
+} s_SimLink;
+
+// Peripheral to central traffic since simStart() or simClearStats()
+typedef struct
+{
+    unsigned long connectionEvents;
+    unsigned long packets;          // LL data packets
+    unsigned long long bytesOnAir;  // Of those packets, preamble to CRC
+    unsigned long notifications;
+    unsigned long indications;
+    unsigned long long firmwareNs;  // Host CPU time the application ran for
+    unsigned long errors;           // Calls the SoftDevice would refuse; each is reported on stderr
+} s_SimStats;
+
+// Called when a notification or indication reaches the central
+typedef void (*sim_hvx_handler_t)(uint16_t handle, uint8_t type, uint8_t const *p_data, uint16_t len);
+
+// The defaults: a 247 byte MTU, 251 byte LL payloads, a 30 ms interval, 7.5 ms on request and 2M allowed
+void simDefaultLink(s_SimLink *p_link);
+
+// Maps the flash and runs main() to its first wait
+void simStart(s_SimLink const *p_link, sim_hvx_handler_t hvxHandler);
+
+// Lets the application run for ms of simulated time
+void simRunFor(uint32_t ms);
+
+// Lets the application run until done() returns true or timeoutMs has passed. Returns done()
+bool simRunUntil(bool (*done)(void), uint32_t timeoutMs);
+
+// Simulated time since simStart()
+uint64_t simTimeUs(void);
+
+// Presses a DK button; the handler runs at once as it would from the GPIOTE interrupt
+void simPressButton(bsp_event_t event);
+
+// The central connects to the advertising application and then exchanges the MTU
+void simConnect(void);
+
+// The central pairs and bonds. Done when simPaired() returns true
+void simPair(void);
+bool simPaired(void);
+
+// The central writes the value or CCCD with the handle. simWriteDone() is true once the response is in
+// and simWriteStatus() then has its ATT status
+void simWrite(uint16_t handle, uint8_t const *p_data, uint16_t len);
+bool simWriteDone(void);
+uint16_t simWriteStatus(void);
+
+// The central drops the connection
+void simDisconnect(void);
+bool simConnected(void);
+
+// The link is on the 2M PHY
+bool simPhy2M(void);
+
+s_SimStats const *simStats(void);
+void simClearStats(void);
+
+#endif
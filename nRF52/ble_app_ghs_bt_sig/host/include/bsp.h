@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the board support package. The LEDs do nothing; ble_sim.c keeps the
+// event handler so a test can press the buttons
+#ifndef HOST_BSP_H__
+#define HOST_BSP_H__
+
+#include <stdint.h>
+
+#define BSP_BOARD_LED_0         0
+#define BSP_BOARD_LED_1         1
+#define BSP_BOARD_LED_2         2
+#define BSP_BOARD_LED_3         3
+#define BSP_BOARD_BUTTON_3      3
+#define BSP_INIT_LEDS           (1 << 0)
+#define BSP_INIT_BUTTONS        (1 << 1)
+
+typedef enum
+{
+    BSP_EVENT_NOTHING = 0,
+    BSP_EVENT_SLEEP,
+    BSP_EVENT_KEY_0,
+    BSP_EVENT_KEY_1,
+    BSP_EVENT_KEY_2,
+    BSP_EVENT_KEY_3
+} bsp_event_t;
+
+typedef void (*bsp_event_callback_t)(bsp_event_t);
+
+uint32_t bsp_init(uint32_t type, bsp_event_callback_t callback);
+void bsp_board_init(uint32_t init_flags);
+void bsp_board_led_on(uint32_t led_idx);
+void bsp_board_led_off(uint32_t led_idx);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// The PHG side of the host tests that run main.c on ble_sim.c; see ghs_central.c
+#ifndef HOST_GHS_CENTRAL_H__
+#define HOST_GHS_CENTRAL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble_sim.h"
+
+typedef struct
+{
+    unsigned long records;              // Complete stored records
+    unsigned long firstRecordNumber;
+    unsigned long lastRecordNumber;
+    unsigned long outOfOrder;           // Records not numbered one after the last and fragments out of place
+    unsigned long leadingGroups;        // Groups sent ahead of the first record under its number
+    unsigned long storedBytes;          // Stored data notified or indicated, GHS headers included
+    uint8_t racpResponse[8];            // The last RACP indication
+    uint16_t racpResponseLength;
+    unsigned long racpResponses;
+    uint64_t racpResponseUs;            // When the last RACP indication came
+} s_GhsCentral;
+
+extern s_GhsCentral ghsCentral;
+
+// Starts the application, stores storedMsmts msmts with the DK button, then connects, pairs and enables
+// the RACP indications and the stored data CCCD with storedCccd. Returns false if a step failed
+bool ghsCentralStart(s_SimLink const *p_link, unsigned short storedMsmts, uint8_t storedCccd);
+
+// Writes an RACP command. Returns true if the application accepted the write
+bool ghsCentralRacp(uint8_t const *p_cmd, uint16_t len);
+
+// True once an RACP indication came in since ghsCentralClear()
+bool ghsCentralRacpResponded(void);
+
+// Forgets what was received
+void ghsCentralClear(void);
+
+#endif
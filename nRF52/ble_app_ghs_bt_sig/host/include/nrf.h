@@ -0,0 +1,48 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the nRF MDK header; only what the application sources use
+#ifndef HOST_NRF_H__
+#define HOST_NRF_H__
+
+#include <stdint.h>
+
+#define __ALIGN(n) __attribute__((aligned(n)))
+
+// The host tests provide hostPreemptionPoint(). Giving up the core at each barrier lets another thread
+// run in the windows the barriers guard, also on a single core host.
+void hostPreemptionPoint(void);
+#define __DMB() do { __sync_synchronize(); hostPreemptionPoint(); } while (0)
+
+// Flash and RAM sizes; sdk_stubs.c sets them to those of the nRF52840
+typedef struct
+{
+    uint32_t CODEPAGESIZE;
+    uint32_t CODESIZE;
+    struct
+    {
+        uint32_t RAM;
+    } INFO;
+} NRF_FICR_Type;
+
+extern NRF_FICR_Type hostFicr;
+#define NRF_FICR (&hostFicr)
+
+#endif
@@ -0,0 +1,33 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the SoftDevice handler SoC observer. Flash results go straight to
+// flashSysEventHandler(), see sdk_stubs.c, so the observer is only kept
+#ifndef HOST_NRF_SDH_SOC_H__
+#define HOST_NRF_SDH_SOC_H__
+
+#include <stdint.h>
+
+typedef void (*nrf_sdh_soc_evt_handler_t)(uint32_t evt_id, void *p_context);
+
+#define NRF_SDH_SOC_OBSERVER(_name, _prio, _handler, _context) \
+    static nrf_sdh_soc_evt_handler_t const _name __attribute__((used)) = _handler
+
+#endif
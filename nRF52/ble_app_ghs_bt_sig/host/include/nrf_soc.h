@@ -0,0 +1,40 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+// Host stand-in for the SoftDevice SoC calls: flash in sdk_stubs.c, the mutex and the event wait in ble_sim.c
+#ifndef HOST_NRF_SOC_H__
+#define HOST_NRF_SOC_H__
+
+#include "nrf.h"
+#include "nrf_error.h"
+
+#define NRF_EVT_FLASH_OPERATION_SUCCESS 2
+#define NRF_EVT_FLASH_OPERATION_ERROR   3
+
+uint32_t sd_flash_write(uint32_t *p_dst, uint32_t const *p_src, uint32_t size);
+uint32_t sd_flash_page_erase(uint32_t page_number);
+
+typedef volatile uint8_t nrf_mutex_t;
+
+uint32_t sd_mutex_new(nrf_mutex_t *p_mutex);
+uint32_t sd_mutex_acquire(nrf_mutex_t *p_mutex);
+uint32_t sd_mutex_release(nrf_mutex_t *p_mutex);
+uint32_t sd_app_evt_wait(void);
+
+#endif
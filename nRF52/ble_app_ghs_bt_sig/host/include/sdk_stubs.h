@@ -0,0 +1,48 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// Host stand-in for the SoftDevice flash and GATT table; see sdk_stubs.c
+#ifndef HOST_SDK_STUBS_H__
+#define HOST_SDK_STUBS_H__
+
+#include <stdbool.h>
+#include "ble.h"
+
+// Maps the host flash and erases it. Call before anything touches flash
+void hostFlashInit(void);
+
+// Delivers the result of the flash operation in progress to flashSysEventHandler(). Returns false if there was none
+bool hostFlashEvents(void);
+
+// A characteristic of the GATT table
+typedef struct
+{
+    uint16_t uuid;
+    ble_gatts_char_handles_t handles;
+    bool writeAuthorized;       // Writes to the value come to the application as an authorize request
+} s_HostGattCharacteristic;
+
+// The first characteristic added with the 16-bit uuid, or NULL
+s_HostGattCharacteristic const *hostGattByUuid(uint16_t uuid);
+
+// The characteristic whose value or CCCD has the handle, or NULL
+s_HostGattCharacteristic const *hostGattByHandle(uint16_t handle);
+
+#endif
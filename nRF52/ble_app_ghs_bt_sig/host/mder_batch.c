@@ -0,0 +1,188 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Check of the batch MderFloat conversions of MderFloat.c against the single value methods. Every raw SFLOAT, and
+ * for FLOATs every exponent with the mantissas around the special values plus FLOAT_RANDOM random raws, are decoded
+ * by the batch and the single value methods, encoded back by both, and converted to doubles. The decoded parts and
+ * the encoded raws have to be the same. A double has to be the one strtod() gives for the number when it is exact,
+ * an exponent from -22 to 22, and within a relative 1e-14 of it otherwise; the special values have to be NAN and
+ * +/- INFINITY. It is built with -O3 so the vectorized loops are the ones checked.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MderFloat.h"
+
+#define SFLOATS         65536
+#define FLOAT_EDGES     16
+#define FLOAT_RANDOM    (1 << 20)
+#define FLOATS          (256 * FLOAT_EDGES + FLOAT_RANDOM)
+
+static const unsigned long FLOAT_EDGE_MANTISSAS[FLOAT_EDGES] =
+{
+    0x000000, 0x000001, 0x000002, 0x7FFFFC, 0x7FFFFD, 0x7FFFFE, 0x7FFFFF, 0x800000,
+    0x800001, 0x800002, 0x800003, 0x800004, 0xFFFFFE, 0xFFFFFF, 0x000009, 0x0F4240
+};
+
+static int errors = 0;
+
+static void fail(const char *what, unsigned long raw)
+{
+    if (errors++ < 10)
+    {
+        printf("%s differs for raw 0x%08lX\n", what, raw);
+    }
+}
+
+// The double of an MDER_NUMBER the way a reader of the value would write it down, correctly rounded
+static double numberAsDouble(long mantissa, int exponent)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%ldE%d", mantissa, exponent);
+    return strtod(text, NULL);
+}
+
+static void checkDouble(double value, enum MderSpecialValue specialValue, long mantissa, int exponent, unsigned long raw)
+{
+    switch (specialValue)
+    {
+        case MDER_NUMBER:
+        {
+            double expected = numberAsDouble(mantissa, exponent);
+            bool exact = (exponent >= -22 && exponent <= 22);
+            if ((exact && value != expected) || (!exact && fabs(value - expected) > fabs(expected) * 1e-14))
+            {
+                fail("double", raw);
+            }
+            break;
+        }
+        case MDER_PINF:
+            if (!(isinf(value) && value > 0)) fail("double", raw);
+            break;
+        case MDER_NINF:
+            if (!(isinf(value) && value < 0)) fail("double", raw);
+            break;
+        default:
+            if (!isnan(value)) fail("double", raw);
+            break;
+    }
+}
+
+static void checkSFloats(void)
+{
+    static unsigned short raws[SFLOATS];
+    static short int exponents[SFLOATS];
+    static long int mantissas[SFLOATS];
+    static enum MderSpecialValue specialValues[SFLOATS];
+    static unsigned short encoded[SFLOATS];
+    static double values[SFLOATS];
+    unsigned long i;
+
+    for (i = 0; i < SFLOATS; i++)
+    {
+        raws[i] = (unsigned short)i;
+    }
+    if (!createMderFloatArraysFromSFloats(raws, exponents, mantissas, specialValues, SFLOATS)
+        || !createIeeeSFloatsFromMderFloatArrays(exponents, mantissas, specialValues, encoded, SFLOATS)
+        || !createDoublesFromSFloats(raws, values, SFLOATS))
+    {
+        fail("SFLOAT batch call", 0);
+        return;
+    }
+    for (i = 0; i < SFLOATS; i++)
+    {
+        s_MderFloat mder;
+        unsigned short raw = 0;
+        createMderFloatFromSFloat(&mder, raws[i]);
+        createIeeeSFloatFromMderFloat(&mder, &raw);
+        if (mder.exponent != exponents[i] || mder.mantissa != mantissas[i] || mder.specialValue != specialValues[i])
+        {
+            fail("SFLOAT decode", i);
+        }
+        if (raw != encoded[i] || (mder.specialValue == MDER_NUMBER && raw != raws[i]))
+        {
+            fail("SFLOAT encode", i);
+        }
+        checkDouble(values[i], mder.specialValue, mder.mantissa, mder.exponent, i);
+    }
+}
+
+static void checkFloats(void)
+{
+    static unsigned long raws[FLOATS];
+    static short int exponents[FLOATS];
+    static long int mantissas[FLOATS];
+    static enum MderSpecialValue specialValues[FLOATS];
+    static unsigned long encoded[FLOATS];
+    static double values[FLOATS];
+    unsigned long i;
+
+    for (i = 0; i < 256 * FLOAT_EDGES; i++)
+    {
+        raws[i] = ((i / FLOAT_EDGES) << 24) | FLOAT_EDGE_MANTISSAS[i % FLOAT_EDGES];
+    }
+    srand(1);
+    for (; i < FLOATS; i++)
+    {
+        raws[i] = (((unsigned long)rand() & 0xFFFF) << 16) | ((unsigned long)rand() & 0xFFFF);
+    }
+    if (!createMderFloatArraysFromFloats(raws, exponents, mantissas, specialValues, FLOATS)
+        || !createIeeeFloatsFromMderFloatArrays(exponents, mantissas, specialValues, encoded, FLOATS)
+        || !createDoublesFromFloats(raws, values, FLOATS))
+    {
+        fail("FLOAT batch call", 0);
+        return;
+    }
+    for (i = 0; i < FLOATS; i++)
+    {
+        s_MderFloat mder;
+        unsigned long raw = 0;
+        createMderFloatFromFloat(&mder, raws[i]);
+        // The single value decode sign extends through a 32 bit long, as on the target. Where long is 64 bits it
+        // leaves the exponent and mantissa unsigned, so they are sign extended here before they are compared.
+        mder.exponent = (short int)((mder.exponent & 0xFF) ^ 0x80) - 0x80;
+        mder.mantissa = (long int)((mder.mantissa & 0x00FFFFFF) ^ 0x00800000) - 0x00800000;
+        createIeeeFloatFromMderFloat(&mder, &raw);
+        if (mder.exponent != exponents[i] || mder.mantissa != mantissas[i] || mder.specialValue != specialValues[i])
+        {
+            fail("FLOAT decode", raws[i]);
+        }
+        if (raw != encoded[i] || (mder.specialValue == MDER_NUMBER && raw != raws[i]))
+        {
+            fail("FLOAT encode", raws[i]);
+        }
+        checkDouble(values[i], mder.specialValue, mder.mantissa, mder.exponent, raws[i]);
+    }
+}
+
+int main(void)
+{
+    int sfloatErrors;
+    checkSFloats();
+    printf("sfloats: %s\n", (errors == 0) ? "ok" : "differ");
+    sfloatErrors = errors;
+    checkFloats();
+    printf("floats: %s\n", (errors == sfloatErrors) ? "ok" : "differ");
+    printf(errors ? "FAILED\n" : "PASSED\n");
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Benchmark of the batch MderFloat conversions of MderFloat.c against the single value methods, on VALUES random
+ * raw SFLOATs and FLOATs with some special values among them. For each of decode, encode and to double the scalar
+ * loop and the batch call are timed in turn, ROUNDS times. The scalar to double is the single value decode and
+ * mantissa * pow(10, exponent), with the special values picked out, as an application has to do it today. The thread
+ * CPU time per value is printed as the median of the rounds, with the batch time over the scalar time of the same
+ * round as the median of the rounds; that ratio moves far less from run to run than the times. It is built with -O3,
+ * which the loops need to be vectorized.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MderFloat.h"
+
+#define VALUES      4096
+#define ROUNDS      201
+#define TESTS       6
+
+static unsigned short sfloats[VALUES];
+static unsigned long floats[VALUES];
+static s_MderFloat mders[VALUES];
+static short int exponents[VALUES];
+static long int mantissas[VALUES];
+static enum MderSpecialValue specialValues[VALUES];
+static unsigned short encodedSFloats[VALUES];
+static unsigned long encodedFloats[VALUES];
+static double values[VALUES];
+
+static double toDouble(const s_MderFloat *mder)
+{
+    switch (mder->specialValue)
+    {
+        case MDER_NUMBER:
+            return mder->mantissa * pow(10, mder->exponent);
+        case MDER_PINF:
+            return INFINITY;
+        case MDER_NINF:
+            return -INFINITY;
+        default:
+            return NAN;
+    }
+}
+
+static void scalarDecodeSFloats(void)
+{
+    unsigned long i;
+    for (i = 0; i < VALUES; i++)
+    {
+        createMderFloatFromSFloat(&mders[i], sfloats[i]);
+    }
+}
+
+static void batchDecodeSFloats(void)
+{
+    createMderFloatArraysFromSFloats(sfloats, exponents, mantissas, specialValues, VALUES);
+}
+
+static void scalarEncodeSFloats(void)
+{
+    unsigned long i;
+    for (i = 0; i < VALUES; i++)
+    {
+        createIeeeSFloatFromMderFloat(&mders[i], &encodedSFloats[i]);
+    }
+}
+
+static void batchEncodeSFloats(void)
+{
+    createIeeeSFloatsFromMderFloatArrays(exponents, mantissas, specialValues, encodedSFloats, VALUES);
+}
+
+static void scalarSFloatsToDoubles(void)
+{
+    unsigned long i;
+    for (i = 0; i < VALUES; i++)
+    {
+        s_MderFloat mder;
+        createMderFloatFromSFloat(&mder, sfloats[i]);
+        values[i] = toDouble(&mder);
+    }
+}
+
+static void batchSFloatsToDoubles(void)
+{
+    createDoublesFromSFloats(sfloats, values, VALUES);
+}
+
+static void scalarDecodeFloats(void)
+{
+    unsigned long i;
+    for (i = 0; i < VALUES; i++)
+    {
+        createMderFloatFromFloat(&mders[i], floats[i]);
+    }
+}
+
+static void batchDecodeFloats(void)
+{
+    createMderFloatArraysFromFloats(floats, exponents, mantissas, specialValues, VALUES);
+}
+
+static void scalarEncodeFloats(void)
+{
+    unsigned long i;
+    for (i = 0; i < VALUES; i++)
+    {
+        createIeeeFloatFromMderFloat(&mders[i], &encodedFloats[i]);
+    }
+}
+
+static void batchEncodeFloats(void)
+{
+    createIeeeFloatsFromMderFloatArrays(exponents, mantissas, specialValues, encodedFloats, VALUES);
+}
+
+static void scalarFloatsToDoubles(void)
+{
+    unsigned long i;
+    for (i = 0; i < VALUES; i++)
+    {
+        s_MderFloat mder;
+        createMderFloatFromFloat(&mder, floats[i]);
+        values[i] = toDouble(&mder);
+    }
+}
+
+static void batchFloatsToDoubles(void)
+{
+    createDoublesFromFloats(floats, values, VALUES);
+}
+
+typedef void (*conversion)(void);
+static const char *NAMES[TESTS] = {"SFLOAT decode", "SFLOAT encode", "SFLOAT double", "FLOAT decode", "FLOAT encode",
+    "FLOAT double"};
+static const conversion SCALAR[TESTS] = {scalarDecodeSFloats, scalarEncodeSFloats, scalarSFloatsToDoubles,
+    scalarDecodeFloats, scalarEncodeFloats, scalarFloatsToDoubles};
+static const conversion BATCH[TESTS] = {batchDecodeSFloats, batchEncodeSFloats, batchSFloatsToDoubles,
+    batchDecodeFloats, batchEncodeFloats, batchFloatsToDoubles};
+
+// The encodes work on what the decodes before them made, so those are run once first
+static void makeValues(void)
+{
+    unsigned long i;
+    srand(1);
+    for (i = 0; i < VALUES; i++)
+    {
+        // A value in 64 is a special value. The exponents stay small, as sensors' do
+        sfloats[i] = (unsigned short)(((rand() & 0x03) << 12) | (rand() & 0x07FF));
+        floats[i] = ((((unsigned long)(rand() & 0x07) - 4) << 24) & 0xFF000000) | ((unsigned long)rand() & 0x003FFFFF);
+        if ((rand() & 63) == 0)
+        {
+            sfloats[i] = 0x07FE;
+            floats[i] = 0x00800002;
+        }
+    }
+}
+
+static double timeNs(conversion convert)
+{
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    convert();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / VALUES;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void)
+{
+    static double scalarNs[ROUNDS];
+    static double batchNs[ROUNDS];
+    static double ratio[ROUNDS];
+    int t;
+    int r;
+
+    makeValues();
+    printf("%d values, %d rounds, ns per value\n%-14s %8s %8s %8s\n", VALUES, ROUNDS, "", "scalar", "batch",
+        "ratio");
+    for (t = 0; t < TESTS; t++)
+    {
+        SCALAR[t]();    // Warm up, and the input of the encodes
+        BATCH[t]();
+        for (r = 0; r < ROUNDS; r++)
+        {
+            scalarNs[r] = timeNs(SCALAR[t]);
+            batchNs[r] = timeNs(BATCH[t]);
+            ratio[r] = batchNs[r] / scalarNs[r];
+        }
+        qsort(scalarNs, ROUNDS, sizeof(double), compareDoubles);
+        qsort(batchNs, ROUNDS, sizeof(double), compareDoubles);
+        qsort(ratio, ROUNDS, sizeof(double), compareDoubles);
+        printf("%-14s %8.2f %8.2f %8.3f\n", NAMES[t], scalarNs[ROUNDS / 2], batchNs[ROUNDS / 2], ratio[ROUNDS / 2]);
+    }
+    return 0;
+}
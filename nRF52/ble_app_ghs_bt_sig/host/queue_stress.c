@@ -0,0 +1,217 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Stress test of the measurement queue (msmt_queue.c) with the contexts of the firmware as threads:
+ * a 'timer' producer, a 'main' producer, the main loop consumer and an event handler that asks for the
+ * queue to be emptied. On the target the timer preempts the other producer and the other producer enqueues
+ * in a critical region, so two enqueue() calls never overlap. Host threads run truly in parallel, so both
+ * producers take producerLock, which stands in for that rule. The consumer and requestEmptyQueue() take no
+ * lock at all, as on the target. hostPreemptionPoint() gives up the core at random at the queue's barriers so
+ * the other threads get to run inside the windows they guard.
+ *
+ * A producer that finds the queue full mostly waits for the consumer, as the firmware's producers keep their
+ * data until the next period, and only now and then enqueues anyway, so overflows stay a small share of the
+ * operations and most of them exercise the slots. The counters start just short of 2^32 so every run goes
+ * across their wrap.
+ *
+ * The consumer checks that every element is whole, that each producer's elements come out in order and
+ * never twice, and, in the runs without empty requests, that every element produced was either consumed
+ * or counted as an overflow.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "msmt_queue.h"
+
+#define QUEUE_SIZE      8
+#define PER_PRODUCER    200000UL
+#define PRODUCERS       2
+#define WRAP_START      (0U - (unsigned int)PER_PRODUCER)     // Counters wrap at 2^32 half way through a run
+
+typedef struct
+{
+    unsigned long producer;
+    unsigned long seq;
+    unsigned long check;            // ~seq; a torn slot shows as a mismatch
+    unsigned char pad[40];          // About the size of an s_MsmtData
+} s_Item;
+
+static s_Queue *queue;
+static pthread_mutex_t producerLock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int producersDone   = 0;
+static volatile int stopRequests    = 0;
+static int requestEmpty             = 0;
+
+void hostPreemptionPoint(void)
+{
+    static __thread unsigned int seed = 0;
+    if (seed == 0)
+    {
+        seed = (unsigned int)(unsigned long)pthread_self() | 1;
+    }
+    if ((rand_r(&seed) & 3) == 0)
+    {
+        sched_yield();
+    }
+}
+
+static void *producer(void *arg)
+{
+    s_Item item = { 0 };
+    unsigned int seed = (unsigned int)(unsigned long)arg + 1;
+    item.producer = (unsigned long)arg;
+    for (item.seq = 1; item.seq <= PER_PRODUCER; item.seq++)
+    {
+        item.check = ~item.seq;
+        while (isFull(queue) && (rand_r(&seed) & 15) != 0)
+        {
+            sched_yield();      // Wait for the consumer, but overflow one time in 16
+        }
+        pthread_mutex_lock(&producerLock);
+        enqueue(queue, &item, sizeof(s_Item));
+        pthread_mutex_unlock(&producerLock);
+        if ((rand_r(&seed) & 7) == 0)
+        {
+            sched_yield();      // Vary the pace so the queue is full at times and empty at others, also on a single core
+        }
+    }
+    __sync_fetch_and_add(&producersDone, 1);
+    return NULL;
+}
+
+static void *requester(void *arg)
+{
+    unsigned int seed = 99;
+    (void)arg;
+    while (!stopRequests)
+    {
+        int i = rand_r(&seed) % 64;
+        requestEmptyQueue(queue);
+        while (i-- > 0 && !stopRequests)
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static int run(unsigned short elementSize, int withRequests)
+{
+    pthread_t producers[PRODUCERS];
+    pthread_t emptier;
+    unsigned long last[PRODUCERS] = { 0 };
+    unsigned long consumed = 0;
+    unsigned long errors = 0;
+    unsigned int seed = 7;
+    unsigned long i;
+
+    queue = initializeQueue(QUEUE_SIZE, elementSize);
+    queue->head = WRAP_START;
+    queue->tail = WRAP_START;
+    queue->emptyTo = WRAP_START;
+    producersDone = 0;
+    stopRequests = 0;
+    requestEmpty = withRequests;
+    for (i = 0; i < PRODUCERS; i++)
+    {
+        pthread_create(&producers[i], NULL, producer, (void *)i);
+    }
+    if (requestEmpty)
+    {
+        pthread_create(&emptier, NULL, requester, NULL);
+    }
+
+    // The main loop: take the front, 'encode' it, then drop it. Once the producers are done the
+    // requests stop and what is left is drained
+    for (;;)
+    {
+        int finished = (producersDone == PRODUCERS);
+        if (finished && requestEmpty && !stopRequests)
+        {
+            stopRequests = 1;
+            pthread_join(emptier, NULL);
+        }
+        s_Item *item = (s_Item *)front(queue);
+        if (item == NULL)
+        {
+            if (finished)
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        s_Item copy = *item;
+        if ((rand_r(&seed) & 3) == 0)
+        {
+            sched_yield();      // Give an empty request the chance to come in between front() and dequeue()
+        }
+        dequeue(queue);
+        if (copy.producer >= PRODUCERS || copy.check != ~copy.seq)
+        {
+            if (errors++ < 10) printf("  torn element: producer %lu seq %lu check %lx\n", copy.producer, copy.seq, copy.check);
+            continue;
+        }
+        if (copy.seq <= last[copy.producer])
+        {
+            if (errors++ < 10) printf("  producer %lu: seq %lu after %lu\n", copy.producer, copy.seq, last[copy.producer]);
+        }
+        last[copy.producer] = copy.seq;
+        consumed++;
+    }
+    for (i = 0; i < PRODUCERS; i++)
+    {
+        pthread_join(producers[i], NULL);
+    }
+    if (!requestEmpty && consumed + queue->overflowCount != PRODUCERS * PER_PRODUCER)
+    {
+        printf("  %lu consumed and %lu overflows of %lu produced\n", consumed, queue->overflowCount, PRODUCERS * PER_PRODUCER);
+        errors++;
+    }
+    if (queue->head - WRAP_START != PRODUCERS * PER_PRODUCER - queue->overflowCount)
+    {
+        printf("  head moved %u for %lu enqueued\n", (unsigned int)(queue->head - WRAP_START), PRODUCERS * PER_PRODUCER - queue->overflowCount);
+        errors++;
+    }
+    printf("%s, %s: %lu consumed, %lu overflows (%lu%%), high water mark %d, %lu errors\n",
+        elementSize > 0 ? "pool backed" : "calloc per slot", withRequests ? "with empty requests" : "no empty requests",
+        consumed, queue->overflowCount, queue->overflowCount * 100 / (PRODUCERS * PER_PRODUCER), queue->highWaterMark, errors);
+    cleanUpQueue(queue);
+    return (errors == 0) ? 0 : 1;
+}
+
+int main(void)
+{
+    int failed = 0;
+    if (initializeQueue(10, sizeof(s_Item)) != NULL)
+    {
+        printf("a queue of 10 slots was accepted; the slot mask needs a power of two\n");
+        failed = 1;
+    }
+    failed |= run(sizeof(s_Item), 0);
+    failed |= run(0, 0);
+    failed |= run(sizeof(s_Item), 1);
+    failed |= run(0, 1);
+    printf(failed ? "FAILED\n" : "PASSED\n");
+    return failed;
+}
@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Timing check of the RACP abort of main.c over the simulated link of ble_sim.c. A report all records is
+ * started with 10, 100 and 1000 stored records and aborted once a few have come. The abort response has
+ * to come within ABORT_EVENTS connection events of the abort write, and no record may start after it. The
+ * number of events must not depend on how many records were left: each run has to take as many as the
+ * first. Each run is in a process of its own, as main.c
+ * keeps its state in statics; the number of events is passed back as the exit status.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "btle_utils.h"
+#include "ghs_central.h"
+
+#define RECORDS_BEFORE_ABORT    3
+#define ABORT_EVENTS            2   // The write, and the response in the next connection event
+
+static const uint8_t GET_ALL_RECORDS[2] = {RACP_GET_RECORDS, RACP_ALL};
+static const uint8_t ABORT[2] = {RACP_ABORT, 0x00};
+static const uint8_t ABORT_SUCCESS[4] = {0x06, 0x00, RACP_ABORT, 0x01};
+
+static bool recordsCame(void)
+{
+    return ghsCentral.records >= RECORDS_BEFORE_ABORT;
+}
+
+// Returns the connection events from the abort write to its response, or 0 if the check failed
+static int abortTransfer(unsigned short storedMsmts)
+{
+    s_SimLink link;
+    unsigned long events;
+    unsigned long records;
+
+    simDefaultLink(&link);
+    link.mtu = BLE_GATT_ATT_MTU_DEFAULT;    // Several fragments a record, so one is in flight at the abort
+    if (!ghsCentralStart(&link, storedMsmts, BLE_GATT_HVX_NOTIFICATION))
+    {
+        return 0;
+    }
+    if (!ghsCentralRacp(GET_ALL_RECORDS, sizeof(GET_ALL_RECORDS)) || !simRunUntil(recordsCame, 10000))
+    {
+        printf("  the transfer did not start\n");
+        return 0;
+    }
+    simClearStats();
+    ghsCentral.racpResponses = 0;
+    if (!ghsCentralRacp(ABORT, sizeof(ABORT)) || !simRunUntil(ghsCentralRacpResponded, 10000))
+    {
+        printf("  no response to the abort\n");
+        return 0;
+    }
+    events = simStats()->connectionEvents;
+    records = ghsCentral.records;
+    if (ghsCentral.racpResponseLength != sizeof(ABORT_SUCCESS) || memcmp(ghsCentral.racpResponse, ABORT_SUCCESS, sizeof(ABORT_SUCCESS)) != 0)
+    {
+        printf("  the abort response was %02X %02X %02X %02X\n", ghsCentral.racpResponse[0], ghsCentral.racpResponse[1],
+            ghsCentral.racpResponse[2], ghsCentral.racpResponse[3]);
+        return 0;
+    }
+    simRunFor(1000);
+    if (ghsCentral.records != records || ghsCentral.racpResponses != 1 || simStats()->errors != 0)
+    {
+        printf("  after the abort: %lu more records, %lu RACP responses, %lu refused calls\n", ghsCentral.records - records,
+            ghsCentral.racpResponses, simStats()->errors);
+        return 0;
+    }
+    if (events > ABORT_EVENTS)
+    {
+        printf("  the response took %lu connection events\n", events);
+        return 0;
+    }
+    return (int)events;
+}
+
+static int run(unsigned short storedMsmts)
+{
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        exit(abortTransfer(storedMsmts));
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+    {
+        return 0;
+    }
+    return WEXITSTATUS(status);
+}
+
+int main(void)
+{
+    static const unsigned short STORED[] = {10, 100, 1000};
+    int errors = 0;
+    int firstEvents = 0;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(STORED) / sizeof(STORED[0]); i++)
+    {
+        int events = run(STORED[i]);
+        if (i == 0)
+        {
+            firstEvents = events;
+        }
+        if (events == 0)
+        {
+            printf("abort with %u stored records: failed\n", STORED[i]);
+            errors++;
+        }
+        else if (events != firstEvents)
+        {
+            printf("abort with %u stored records: failed, response after %d connection events but %d with %u records\n",
+                STORED[i], events, firstEvents, STORED[0]);
+            errors++;
+        }
+        else
+        {
+            printf("abort with %u stored records: ok, response after %d connection events\n", STORED[i], events);
+        }
+    }
+    printf(errors ? "FAILED\n" : "PASSED\n");
+    return (errors == 0) ? 0 : 1;
+}
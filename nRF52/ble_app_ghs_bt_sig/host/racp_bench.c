@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Benchmark of the stored data transfer of main.c over the simulated link of ble_sim.c. For each MTU,
+ * data length and notification queue depth of the sweep, STORED_MSMTS records are stored and read with
+ * an RACP report all records, notified. One line is printed per setting:
+ *   records/s      records over the simulated time from the RACP write to the RACP response
+ *   events/record  connection events in that time per record
+ *   air B/record   peripheral to central LL bytes (preamble to CRC) per record, the RACP response included
+ *   queue B/record bytes copied into main.c's measurement queue per record
+ *   encode us      host CPU time in encodeSpecializationMsmts() per stored record
+ * The application's CPU time takes no simulated time, so records/s is what the link and the send path
+ * allow; the encode time shows what a record costs the CPU on top of that. Each setting is run in a
+ * process of its own, as main.c keeps its state in statics.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "btle_utils.h"
+#include "ghs_central.h"
+#include "msmt_queue.h"
+
+#define STORED_MSMTS    200
+
+static const uint8_t GET_ALL_RECORDS[2] = {RACP_GET_RECORDS, RACP_ALL};
+static const uint16_t MTUS[] = {23, 65, 131, 185, 247};
+static const uint16_t DATA_LENGTHS[] = {27, 69, 131, 185, 251};
+static const uint8_t QUEUE_DEPTHS[] = {1, 2, 4, 8};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+extern s_Queue *queue;  // main.c's measurement queue
+
+// main.c calls the encoder through the linker's --wrap so that its CPU time can be taken here
+static unsigned long long encodeNs = 0;
+static unsigned long encodes = 0;
+
+bool __real_encodeSpecializationMsmts(s_MsmtData *msmt);
+
+bool __wrap_encodeSpecializationMsmts(s_MsmtData *msmt)
+{
+    struct timespec start;
+    struct timespec end;
+    bool isStoredData = msmt->common.isStoredData;  // The encoder may change the msmt
+    bool encoded;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    encoded = __real_encodeSpecializationMsmts(msmt);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    if (encoded && isStoredData)
+    {
+        encodeNs = encodeNs + (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+        encodes++;
+    }
+    return encoded;
+}
+
+static int transfer(s_SimLink const *p_link)
+{
+    uint64_t startUs;
+    double seconds;
+
+    if (!ghsCentralStart(p_link, STORED_MSMTS, BLE_GATT_HVX_NOTIFICATION))
+    {
+        return 1;
+    }
+    simClearStats();
+    ghsCentralClear();
+    encodeNs = 0;
+    encodes = 0;
+    startUs = simTimeUs();
+    if (!ghsCentralRacp(GET_ALL_RECORDS, sizeof(GET_ALL_RECORDS)) || !simRunUntil(ghsCentralRacpResponded, 600000))
+    {
+        printf("  no RACP response; %lu records came\n", ghsCentral.records);
+        return 1;
+    }
+    if (ghsCentral.records != STORED_MSMTS || ghsCentral.outOfOrder != 0 || simStats()->errors != 0)
+    {
+        printf("  %lu records of %u, %lu out of order, %lu refused calls\n", ghsCentral.records, STORED_MSMTS,
+            ghsCentral.outOfOrder, simStats()->errors);
+        return 1;
+    }
+    seconds = (ghsCentral.racpResponseUs - startUs) / 1000000.0;
+    printf("%4u %4u %5u %10.1f %8.2f %8llu %8lu %9.1f\n", p_link->mtu, p_link->dataLength, p_link->hvnQueueSize,
+        ghsCentral.records / seconds,
+        (double)simStats()->connectionEvents / ghsCentral.records,
+        simStats()->bytesOnAir / ghsCentral.records,
+        queue->bytesCopied / ghsCentral.records,
+        (encodes > 0) ? encodeNs / 1000.0 / encodes : 0.0);
+    return 0;
+}
+
+static int run(s_SimLink const *p_link)
+{
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        exit(transfer(p_link));
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        printf("%4u %4u %5u failed\n", p_link->mtu, p_link->dataLength, p_link->hvnQueueSize);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    s_SimLink link;
+    int errors = 0;
+    unsigned int m;
+    unsigned int d;
+    unsigned int q;
+
+    simDefaultLink(&link);
+    printf("%u records, connection interval down to %u us, event length %u us, %s PHY, %s\n", STORED_MSMTS,
+        link.minConnIntervalUs, link.eventLengthUs, link.phy2M ? "2M" : "1M",
+        PIPELINE_STORED_DATA ? "pipelined" : "not pipelined");
+    printf(" MTU   DL queue  records/s events/r  air B/r queue B/r encode us\n");
+    for (m = 0; m < COUNT(MTUS); m++)
+    {
+        for (d = 0; d < COUNT(DATA_LENGTHS); d++)
+        {
+            for (q = 0; q < COUNT(QUEUE_DEPTHS); q++)
+            {
+                link.mtu = MTUS[m];
+                link.dataLength = DATA_LENGTHS[d];
+                link.hvnQueueSize = QUEUE_DEPTHS[q];
+                errors += run(&link);
+            }
+        }
+    }
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Check of the stored data transfer of main.c over the simulated link of ble_sim.c. Measurements are
+ * stored with the DK button, the PHG connects, pairs, enables the CCCDs and asks for all records with
+ * the RACP. Every record has to come, whole and in order, followed by the RACP success response, and the
+ * application must not make a call the SoftDevice would refuse. Nor may it leave the link idle: each PDU
+ * gets at most two connection events, one to send it and, for an indication, one for its confirmation. This is done for several MTU, data length
+ * and notification queue sizes and with the stored data indicated. main.c keeps its state in statics, so
+ * each run is in a process of its own. The records must be queued as references, not copied into the
+ * queue: no more than a reference per record, and one more for the scale's settings, may be copied.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "btle_utils.h"
+#include "ghs_central.h"
+#include "msmt_queue.h"
+
+#define STORED_MSMTS    40
+#define SLACK_EVENTS    20  // Bulk mode setup and the RACP write and response
+
+static const uint8_t GET_ALL_RECORDS[2] = {RACP_GET_RECORDS, RACP_ALL};
+static const uint8_t GET_RECORDS_SUCCESS[4] = {0x06, 0x00, RACP_GET_RECORDS, 0x01};
+
+extern s_Queue *queue;  // main.c's measurement queue
+
+static int transfer(s_SimLink const *p_link, uint8_t storedCccd)
+{
+    int errors = 0;
+    unsigned long pdus;
+    if (!ghsCentralStart(p_link, STORED_MSMTS, storedCccd))
+    {
+        return 1;
+    }
+    simClearStats();
+    if (!ghsCentralRacp(GET_ALL_RECORDS, sizeof(GET_ALL_RECORDS)))
+    {
+        printf("  the RACP request was refused\n");
+        return 1;
+    }
+    if (!simRunUntil(ghsCentralRacpResponded, 60000))
+    {
+        printf("  no RACP response; %lu records came\n", ghsCentral.records);
+        return 1;
+    }
+    pdus = simStats()->notifications + simStats()->indications;
+    if (simStats()->connectionEvents > 2 * pdus + SLACK_EVENTS)
+    {
+        printf("  %lu connection events for %lu PDUs\n", simStats()->connectionEvents, pdus);
+        errors++;
+    }
+    simRunFor(100);     // Anything sent after the response would show up here
+    if (ghsCentral.records != STORED_MSMTS || ghsCentral.outOfOrder != 0)
+    {
+        printf("  %lu records of %u, numbered %lu to %lu, %lu out of order\n", ghsCentral.records, STORED_MSMTS,
+            ghsCentral.firstRecordNumber, ghsCentral.lastRecordNumber, ghsCentral.outOfOrder);
+        errors++;
+    }
+    if (ghsCentral.racpResponses != 1 || ghsCentral.racpResponseLength != sizeof(GET_RECORDS_SUCCESS)
+        || memcmp(ghsCentral.racpResponse, GET_RECORDS_SUCCESS, sizeof(GET_RECORDS_SUCCESS)) != 0)
+    {
+        printf("  %lu RACP responses, the last %02X %02X %02X %02X\n", ghsCentral.racpResponses,
+            ghsCentral.racpResponse[0], ghsCentral.racpResponse[1], ghsCentral.racpResponse[2], ghsCentral.racpResponse[3]);
+        errors++;
+    }
+    if (simPhy2M())
+    {
+        printf("  the link is still on the 2M PHY after the transfer\n");
+        errors++;
+    }
+    if (simStats()->errors != 0)
+    {
+        printf("  %lu calls the SoftDevice would refuse\n", simStats()->errors);
+        errors++;
+    }
+    if (queue->bytesCopied > (STORED_MSMTS + 1) * sizeof(s_StoredMsmtReference))
+    {
+        printf("  %lu bytes copied into the queue for %u records\n", queue->bytesCopied, STORED_MSMTS);
+        errors++;
+    }
+    return errors;
+}
+
+static int run(const char *name, uint16_t mtu, uint16_t dataLength, uint8_t hvnQueueSize, uint8_t storedCccd)
+{
+    s_SimLink link;
+    int status;
+    pid_t pid;
+
+    simDefaultLink(&link);
+    link.mtu = mtu;
+    link.dataLength = dataLength;
+    link.hvnQueueSize = hvnQueueSize;
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        exit(transfer(&link, storedCccd) == 0 ? 0 : 1);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid)
+    {
+        printf("%s: could not run\n", name);
+        return 1;
+    }
+    status = (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    printf("%s: %s\n", name, (status == 0) ? "ok" : "failed");
+    return status;
+}
+
+int main(void)
+{
+    int errors = 0;
+    errors += run("MTU 23, data length 27, 1 queued notification", 23, 27, 1, BLE_GATT_HVX_NOTIFICATION);
+    errors += run("MTU 23, data length 251, application queue size", 23, 251, 0, BLE_GATT_HVX_NOTIFICATION);
+    errors += run("MTU 185, data length 27, 4 queued notifications", 185, 27, 4, BLE_GATT_HVX_NOTIFICATION);
+    errors += run("MTU 247, data length 251, application queue size", 247, 251, 0, BLE_GATT_HVX_NOTIFICATION);
+    errors += run("MTU 247, data length 251, indicated", 247, 251, 0, BLE_GATT_HVX_INDICATION);
+    errors += run("MTU 23, data length 27, indicated", 23, 27, 0, BLE_GATT_HVX_INDICATION);
+    printf(errors ? "FAILED\n" : "PASSED\n");
+    return (errors == 0) ? 0 : 1;
+}
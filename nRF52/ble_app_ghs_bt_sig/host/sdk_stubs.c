@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Host stand-ins for the SoftDevice and SDK calls of btle_utils.c. Flash is an anonymous mapping at the
+ * addresses of the nRF52840 flash the stored measurement log and the bonding data use, so the sources can
+ * keep treating page numbers as addresses. As on the target, a write can only clear bits and an erase sets
+ * a page to 0xFF. The result of an operation is held back until hostFlashEvents() so it arrives after
+ * the call returns, as the system event does on the target. Services and characteristics get handles in
+ * the order they are added, as the SoftDevice gives them, so a test can find them by UUID.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "nrf_soc.h"
+#include "ble.h"
+#include "crc16.h"
+#include "sdk_stubs.h"
+
+#define HOST_FLASH_START    0x80000UL
+#define HOST_FLASH_END      0x100000UL
+
+NRF_FICR_Type hostFicr = { .CODEPAGESIZE = 4096, .CODESIZE = 256, .INFO.RAM = 256 };
+
+static uint32_t pendingFlashEvent = 0;
+
+#define HOST_GATT_CHARACTERISTICS   32
+static s_HostGattCharacteristic gattCharacteristics[HOST_GATT_CHARACTERISTICS];
+static unsigned short gattCharacteristicCount = 0;
+static uint16_t nextGattHandle = 1;
+
+void flashSysEventHandler(uint32_t sys_evt);
+
+void hostFlashInit(void)
+{
+    void *flash = mmap((void *)HOST_FLASH_START, HOST_FLASH_END - HOST_FLASH_START, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (flash != (void *)HOST_FLASH_START)
+    {
+        fprintf(stderr, "Cannot map the host flash at 0x%lx\n", HOST_FLASH_START);
+        exit(2);
+    }
+    memset(flash, 0xFF, HOST_FLASH_END - HOST_FLASH_START);
+}
+
+bool hostFlashEvents(void)
+{
+    uint32_t event = pendingFlashEvent;
+    pendingFlashEvent = 0;
+    if (event != 0)
+    {
+        flashSysEventHandler(event);
+    }
+    return (event != 0);
+}
+
+uint32_t sd_flash_write(uint32_t *p_dst, uint32_t const *p_src, uint32_t size)
+{
+    uint32_t i;
+    if (pendingFlashEvent != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if ((uintptr_t)p_dst < HOST_FLASH_START || (uintptr_t)(p_dst + size) > HOST_FLASH_END)
+    {
+        fprintf(stderr, "Flash write of %u words at %p is outside the flash\n", size, (void *)p_dst);
+        exit(2);
+    }
+    for (i = 0; i < size; i++)
+    {
+        p_dst[i] &= p_src[i];
+    }
+    pendingFlashEvent = NRF_EVT_FLASH_OPERATION_SUCCESS;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_flash_page_erase(uint32_t page_number)
+{
+    uintptr_t page = (uintptr_t)page_number * hostFicr.CODEPAGESIZE;
+    if (pendingFlashEvent != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if (page < HOST_FLASH_START || page + hostFicr.CODEPAGESIZE > HOST_FLASH_END)
+    {
+        fprintf(stderr, "Erase of page %u is outside the flash\n", page_number);
+        exit(2);
+    }
+    memset((void *)page, 0xFF, hostFicr.CODEPAGESIZE);
+    pendingFlashEvent = NRF_EVT_FLASH_OPERATION_SUCCESS;
+    return NRF_SUCCESS;
+}
+
+// The CRC-CCITT of the SDK crc16 module
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc)
+{
+    uint32_t i;
+    uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+    for (i = 0; i < size; i++)
+    {
+        crc = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+    return crc;
+}
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const *p_uuid, uint16_t *p_handle)
+{
+    *p_handle = nextGattHandle++;
+    return NRF_SUCCESS;
+}
+
+// Declaration, value, then the user description and CCCD if there are any
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const *p_char_md,
+    ble_gatts_attr_t const *p_attr_char_value, ble_gatts_char_handles_t *p_handles)
+{
+    if (gattCharacteristicCount >= HOST_GATT_CHARACTERISTICS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    memset(p_handles, 0, sizeof(ble_gatts_char_handles_t));
+    nextGattHandle++;
+    p_handles->value_handle = nextGattHandle++;
+    if (p_char_md->p_char_user_desc != NULL)
+    {
+        p_handles->user_desc_handle = nextGattHandle++;
+    }
+    if (p_char_md->p_cccd_md != NULL)
+    {
+        p_handles->cccd_handle = nextGattHandle++;
+    }
+    gattCharacteristics[gattCharacteristicCount].uuid = p_attr_char_value->p_uuid->uuid;
+    gattCharacteristics[gattCharacteristicCount].handles = *p_handles;
+    gattCharacteristics[gattCharacteristicCount].writeAuthorized = p_attr_char_value->p_attr_md->wr_auth;
+    gattCharacteristicCount++;
+    return NRF_SUCCESS;
+}
+
+s_HostGattCharacteristic const *hostGattByUuid(uint16_t uuid)
+{
+    unsigned short i;
+    for (i = 0; i < gattCharacteristicCount; i++)
+    {
+        if (gattCharacteristics[i].uuid == uuid)
+        {
+            return &gattCharacteristics[i];
+        }
+    }
+    return NULL;
+}
+
+s_HostGattCharacteristic const *hostGattByHandle(uint16_t handle)
+{
+    unsigned short i;
+    for (i = 0; i < gattCharacteristicCount; i++)
+    {
+        if (handle != BLE_GATT_HANDLE_INVALID &&
+            (gattCharacteristics[i].handles.value_handle == handle || gattCharacteristics[i].handles.cccd_handle == handle))
+        {
+            return &gattCharacteristics[i];
+        }
+    }
+    return NULL;
+}
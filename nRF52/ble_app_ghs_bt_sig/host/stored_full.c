@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Check of a full stored measurement log (btle_utils.c), built with USES_STORED_DATA 1 against the flash
+ * stand-in of sdk_stubs.c. More than NUMBER_OF_STORED_MSMTS measurements are stored, over a page worth more
+ * so that the oldest page is emptied and reclaimed on the way. Each one past the capacity has to replace the
+ * oldest: the log must hold the newest NUMBER_OF_STORED_MSMTS, in order, and the log generation must have
+ * moved so queued references to the old indices are seen as stale. This is checked in flash and after the
+ * log is loaded from flash again, both with the last evicted records still in an unreclaimed page and not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "btle_utils.h"
+#include "handleSpecializations.h"
+#include "msmt_queue.h"
+#include "sdk_stubs.h"
+
+#define RECORDS_PER_PAGE    127     // Log records per page for the blood pressure cuff
+
+// Defined by main.c on the target
+s_Queue *queue = NULL;
+volatile s_global_send global_send;
+void ble_disconnected_handler(void *p_context) {}
+bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNumber) { return false; }
+
+void hostPreemptionPoint(void) {}
+
+static unsigned long long ticks = 1000;     // Stands in for the RTC ticks
+static int errors = 0;
+
+// Runs the flash operations and the log steps they lead to until none are left
+static void runFlashUntilIdle(void)
+{
+    int quiet = 0;
+    while (quiet < 3)
+    {
+        runFlashOperations();
+        quiet = (hostFlashEvents() || !isFlashIdle()) ? 0 : quiet + 1;
+    }
+}
+
+// Stores count msmts the way main.c does and returns the record number of the last one
+static unsigned long storeMsmts(unsigned short count)
+{
+    unsigned short i;
+    for (i = 0; i < count; i++)
+    {
+        ticks = ticks + 1000;
+        if (generateAndAddStoredMsmt(ticks, (unsigned long)ticks, numberOfStoredMsmtGroups))
+        {
+            numberOfStoredMsmtGroups++;
+        }
+        runFlashUntilIdle();
+    }
+    return recordNumber - 1;
+}
+
+// The log has to hold the NUMBER_OF_STORED_MSMTS records up to last, oldest first
+static void checkNewest(const char *name, const char *where, unsigned long last)
+{
+    s_MsmtData msmt;
+    unsigned short i;
+    if (numberOfStoredMsmtGroups != NUMBER_OF_STORED_MSMTS)
+    {
+        printf("  %s, %s: %u msmts, expected %u\n", name, where, numberOfStoredMsmtGroups, NUMBER_OF_STORED_MSMTS);
+        errors++;
+    }
+    for (i = 0; i < NUMBER_OF_STORED_MSMTS; i++)
+    {
+        unsigned long expected = last - (NUMBER_OF_STORED_MSMTS - 1) + i;
+        if (!getStoredMsmt(i, &msmt) || msmt.common.recordNumber != expected)
+        {
+            printf("  %s, %s: msmt %u is not record %lu\n", name, where, i, expected);
+            errors++;
+            return;
+        }
+    }
+    if (getStoredMsmt(NUMBER_OF_STORED_MSMTS, &msmt))
+    {
+        printf("  %s, %s: more than %u msmts\n", name, where, NUMBER_OF_STORED_MSMTS);
+        errors++;
+    }
+}
+
+static void run(const char *name, unsigned short beyond)
+{
+    unsigned long generation;
+    unsigned long last;
+    int before = errors;
+
+    clearStoredMsmts();
+    runFlashUntilIdle();
+    numberOfStoredMsmtGroups = 0;
+
+    storeMsmts(NUMBER_OF_STORED_MSMTS);
+    generation = getStoredMsmtGeneration();
+    last = storeMsmts(beyond);
+    if (getStoredMsmtGeneration() == generation)
+    {
+        printf("  %s: the log generation did not move\n", name);
+        errors++;
+    }
+    checkNewest(name, "in flash", last);
+    loadStoredMsmtsFromFlash();
+    checkNewest(name, "reloaded", last);
+    storeMsmts(1);
+    checkNewest(name, "one more after reloading", last + 1);
+
+    printf("%s: %s\n", name, (errors == before) ? "ok" : "wrong records");
+}
+
+int main(void)
+{
+    hostFlashInit();
+    sGhsTime = calloc(1, sizeof(s_GhsTime));
+    sGhsTime->timeSync = 0x01;
+    epoch = 1700000000000ULL;
+    loadStoredMsmtsFromFlash();
+    resumeStoredTimelines();
+
+    run("full log, one more msmt", 1);
+    run("full log, a page more", RECORDS_PER_PAGE);
+    run("full log, a page and a half more", RECORDS_PER_PAGE + RECORDS_PER_PAGE / 2);
+    printf(errors ? "FAILED\n" : "PASSED\n");
+    return (errors == 0) ? 0 : 1;
+}
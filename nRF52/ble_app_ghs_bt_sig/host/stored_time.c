@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Check of the time stamps of stored measurements across a set time (handleSpecializations.c and the
+ * stored measurement log in btle_utils.c), built with USES_STORED_DATA 1 against the flash stand-in of
+ * sdk_stubs.c. A measurement is stored, the time is set as main.c does it and a second measurement is
+ * stored. Read back, the first has to have moved by the set time difference and taken its time sync,
+ * and the second, taken on the new clock, must not have moved again. This is checked with the records
+ * still waiting in RAM, once they are in flash and after the log is loaded from flash again, both with
+ * the first record appended before and after the set time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "btle_utils.h"
+#include "handleSpecializations.h"
+#include "msmt_queue.h"
+#include "sdk_stubs.h"
+
+#define EPOCH_MASK      0xFFFFFFFFFFFFULL
+
+// Defined by main.c on the target
+s_Queue *queue = NULL;
+volatile s_global_send global_send;
+void ble_disconnected_handler(void *p_context) {}
+bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNumber) { return false; }
+
+void hostPreemptionPoint(void) {}
+
+static unsigned long long ticks = 1000;     // Stands in for the RTC ticks
+static int errors = 0;
+
+// Runs the flash operations and the log steps they lead to until none are left
+static void runFlashUntilIdle(void)
+{
+    int quiet = 0;
+    while (quiet < 3)
+    {
+        runFlashOperations();
+        quiet = (hostFlashEvents() || !isFlashIdle()) ? 0 : quiet + 1;
+    }
+}
+
+// What main.c does on a set time: the clock and the stored msmts on the current timeline move by diff
+static void setTime(long long diff, unsigned char timeSync)
+{
+    epoch = epoch + diff;
+    sGhsTime->timeSync = timeSync;
+    handleSpecializationsOnSetTime(numberOfStoredMsmtGroups, diff, timeSync);
+}
+
+static void checkStoredMsmt(const char *name, const char *where, unsigned short index,
+    unsigned long long expectedEpoch, unsigned char expectedTimeSync)
+{
+    s_MsmtData msmt;
+    if (!getStoredMsmt(index, &msmt))
+    {
+        printf("  %s, %s: msmt %u missing\n", name, where, index);
+        errors++;
+        return;
+    }
+    if (msmt.common.sGhsTime.epoch != (expectedEpoch & EPOCH_MASK) || msmt.common.sGhsTime.timeSync != expectedTimeSync)
+    {
+        printf("  %s, %s: msmt %u has epoch %llu sync %u, expected %llu sync %u\n", name, where, index,
+            msmt.common.sGhsTime.epoch, msmt.common.sGhsTime.timeSync, expectedEpoch & EPOCH_MASK, expectedTimeSync);
+        errors++;
+    }
+}
+
+static void run(const char *name, bool appendFirst, long long diff, unsigned char timeSync)
+{
+    unsigned long long first;
+    unsigned long long second;
+    int before = errors;
+
+    clearStoredMsmts();
+    runFlashUntilIdle();
+
+    ticks = ticks + 1000;
+    first = epoch + ticks;
+    generateAndAddStoredMsmt(ticks, (unsigned long)ticks, numberOfStoredMsmtGroups);
+    if (appendFirst)
+    {
+        runFlashUntilIdle();
+    }
+
+    setTime(diff, timeSync);
+    first = first + diff;
+
+    ticks = ticks + 1000;
+    second = epoch + ticks;
+    generateAndAddStoredMsmt(ticks, (unsigned long)ticks, numberOfStoredMsmtGroups);
+
+    checkStoredMsmt(name, "before append", 0, first, timeSync);
+    checkStoredMsmt(name, "before append", 1, second, timeSync);
+    runFlashUntilIdle();
+    checkStoredMsmt(name, "in flash", 0, first, timeSync);
+    checkStoredMsmt(name, "in flash", 1, second, timeSync);
+    loadStoredMsmtsFromFlash();
+    checkStoredMsmt(name, "reloaded", 0, first, timeSync);
+    checkStoredMsmt(name, "reloaded", 1, second, timeSync);
+
+    printf("%s: %s\n", name, (errors == before) ? "ok" : "wrong time stamps");
+}
+
+int main(void)
+{
+    hostFlashInit();
+    sGhsTime = calloc(1, sizeof(s_GhsTime));
+    sGhsTime->timeSync = 0x01;
+    epoch = 1700000000000ULL;
+    loadStoredMsmtsFromFlash();
+    resumeStoredTimelines();
+
+    run("set forward, first msmt in RAM", false, 3600000LL, 0x06);
+    run("set forward, first msmt in flash", true, 7200000LL, 0x04);
+    run("set back, first msmt in RAM", false, -5400000LL, 0x06);
+    run("set back, first msmt in flash", true, -1800000LL, 0x04);
+    printf(errors ? "FAILED\n" : "PASSED\n");
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Check of the measurement group templates in msmtGroupTemplates.h. It is built with USES_MSMT_GROUP_TEMPLATES 0
+ * and LOG_MSMT_GROUP_TEMPLATES 1, one build per specialization, so configureSpecializations() creates every group
+ * the long way and hands each one to logMsmtGroupTemplate(). The linker's --wrap sends that call here, where the
+ * group is compared with the template of the same name: the header indices, the msmt index entries and every byte
+ * of the data array. A template that is stale after a change to a group fails the check; regenerate it as the
+ * header of msmtGroupTemplates.h says.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "btle_utils.h"
+#include "configGhsEncoder.h"
+#include "handleSpecializations.h"
+#include "msmtGroupTemplates.h"
+#include "msmt_queue.h"
+
+typedef struct
+{
+    const char *name;
+    const s_MsmtGroupTemplate *msmtGroupTemplate;
+    bool logged;
+    int errors;
+}s_NamedTemplate;
+
+static s_NamedTemplate templates[] =
+{
+    #if (BP_CUFF == 1)
+        { "bp", &bpGroupTemplate, false, 0 },
+    #endif
+    #if (PULSE_OX == 1)
+        { "spot", &spotGroupTemplate, false, 0 },
+        { "cont", &contGroupTemplate, false, 0 },
+    #endif
+    #if (GLUCOSE == 1)
+        { "gluc", &glucGroupTemplate, false, 0 },
+    #endif
+    #if (HEART_RATE == 1)
+        { "hr", &hrGroupTemplate, false, 0 },
+    #endif
+    #if (SCALE == 1)
+        { "settings", &settingsGroupTemplate, false, 0 },
+        { "scale", &scaleGroupTemplate, false, 0 },
+    #endif
+    #if (THERMOMETER == 1)
+        { "temp", &tempGroupTemplate, false, 0 },
+    #endif
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+// Defined by main.c on the target
+s_Queue *queue = NULL;
+volatile s_global_send global_send;
+void ble_disconnected_handler(void *p_context) {}
+bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNumber) { return false; }
+
+void hostPreemptionPoint(void) {}
+
+static int errors = 0;
+
+static void differs(const char *name, const char *what)
+{
+    printf("%s: %s differs from %sGroupTemplate\n", name, what, name);
+    errors++;
+}
+
+static bool sameMsmtIndex(const s_GhsMsmtIndex *a, const s_GhsMsmtIndex *b)
+{
+    return a->msmtValueType == b->msmtValueType && a->msmt_length == b->msmt_length && a->id_index == b->id_index
+        && a->numberOfCmpds == b->numberOfCmpds && a->numberOfBytes == b->numberOfBytes && a->value_index == b->value_index
+        && a->isSfloat == b->isSfloat && a->numberOfSuppTypes == b->numberOfSuppTypes
+        && a->suppTypes_index == b->suppTypes_index && a->numberRefs == b->numberRefs && a->ref_index == b->ref_index
+        && a->duration_index == b->duration_index;
+}
+
+static void compareWithTemplate(char *name, s_MsmtGroupData *msmtGroupData, const s_MsmtGroupTemplate *msmtGroupTemplate)
+{
+    unsigned short i;
+    if (msmtGroupData->bufferLength != msmtGroupTemplate->dataLength
+        || msmtGroupData->dataLength != msmtGroupTemplate->dataLength)
+    {
+        differs(name, "the length");
+        return;
+    }
+    if (msmtGroupData->timestamp_index != msmtGroupTemplate->timestamp_index
+        || msmtGroupData->no_of_msmts_index != msmtGroupTemplate->no_of_msmts_index
+        || msmtGroupData->numberOfSuppTypes != msmtGroupTemplate->numberOfSuppTypes
+        || msmtGroupData->suppTypes_index != msmtGroupTemplate->suppTypes_index
+        || msmtGroupData->numberRefs != msmtGroupTemplate->numberRefs
+        || msmtGroupData->ref_index != msmtGroupTemplate->ref_index
+        || msmtGroupData->duration_index != msmtGroupTemplate->duration_index)
+    {
+        differs(name, "a header index");
+    }
+    if (msmtGroupData->currentGhsMsmtCount != msmtGroupTemplate->numberOfGhsMsmts)
+    {
+        differs(name, "the number of msmts");
+        return;
+    }
+    for (i = 0; i < msmtGroupTemplate->numberOfGhsMsmts; i++)
+    {
+        if (!sameMsmtIndex(&msmtGroupData->sGhsMsmtIndex[i], &msmtGroupTemplate->sGhsMsmtIndex[i]))
+        {
+            differs(name, "a msmt index entry");
+        }
+    }
+    for (i = 0; i < msmtGroupTemplate->dataLength; i++)
+    {
+        if (msmtGroupData->data[i] != msmtGroupTemplate->data[i])
+        {
+            printf("%s: byte %u is 0x%02X, the template has 0x%02X\n", name, i, msmtGroupData->data[i],
+                msmtGroupTemplate->data[i]);
+            errors++;
+        }
+    }
+}
+
+void __wrap_logMsmtGroupTemplate(char *name, s_MsmtGroupData *msmtGroupData)
+{
+    unsigned short t;
+    int errorsBefore = errors;
+    for (t = 0; t < COUNT(templates) && strcmp(templates[t].name, name) != 0; t++);
+    if (t == COUNT(templates))
+    {
+        printf("%s: no template of that name\n", name);
+        errors++;
+        return;
+    }
+    compareWithTemplate(name, msmtGroupData, templates[t].msmtGroupTemplate);
+    templates[t].logged = true;
+    templates[t].errors = errors - errorsBefore;
+}
+
+int main(void)
+{
+    unsigned short t;
+    configureSpecializations();
+    for (t = 0; t < COUNT(templates); t++)
+    {
+        if (!templates[t].logged)
+        {
+            printf("%s: the group was not created\n", templates[t].name);
+            errors++;
+        }
+        else
+        {
+            printf("%s: %s\n", templates[t].name, templates[t].errors ? "differs" : "ok");
+        }
+    }
+    printf(errors ? "FAILED\n" : "PASSED\n");
+    return (errors == 0) ? 0 : 1;
+}
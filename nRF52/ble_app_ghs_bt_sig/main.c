@@ -60,6 +60,7 @@
 #include "ble_conn_params.h"
 #include "boards.h"
 #include "nrf_sdh_ble.h"
+#include "nrf_sdh_soc.h"
 #include "nrf_sdm.h"
 #include "nrf_sdh.h"
 
@@ -95,6 +96,7 @@
 
 #define APP_BLE_OBSERVER_PRIO           3                                           /**< Application's BLE observer priority. You shouldn't need to modify this value. */
 #define APP_BLE_CONN_CFG_TAG            1                                           /**< A tag identifying the SoftDevice BLE configuration. */
+#define APP_SOC_OBSERVER_PRIO           1                                           /**< Application's SoC observer priority. Receives the flash operation results. */
 
 #define APP_ADV_INTERVAL                40                                          /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS      180                                         /**< The advertising timeout in units of seconds. */
@@ -106,6 +108,9 @@
 #define MAX_CONN_INTERVAL               MSEC_TO_UNITS(1000, UNIT_1_25_MS)           /**< Maximum acceptable connection interval (1 second). */
 #define SLAVE_LATENCY                   0                                           /**< Slave latency. */
 #define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory timeout (4 seconds). */
+#define BULK_MIN_CONN_INTERVAL          MSEC_TO_UNITS(7.5, UNIT_1_25_MS)            /**< Minimum connection interval requested during bulk transfers (7.5 ms). */
+#define BULK_MAX_CONN_INTERVAL          MSEC_TO_UNITS(15, UNIT_1_25_MS)             /**< Maximum connection interval requested during bulk transfers (15 ms). */
+#define BULK_KEEP_2M_PHY                0                                           /**< 1 to stay on the 2M PHY after a bulk transfer, 0 to request the 1M PHY again. */
 
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000)                       /**< Time from initiating event (connect or start of indication) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(3000)                       /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
@@ -168,6 +173,30 @@ APP_TIMER_DEF(m_app_dummy_timer_id);
 static uint8_t                  m_adv_handle                    = 0;  // For advertisments
 static uint32_t                 m_config_id                     = 1;  // For advertisments
 static bool                     stored_data_done_sent;
+/*
+ * With PIPELINE_STORED_DATA the record count is taken down when send_data() hands the last fragment of a
+ * record to the SoftDevice, not when its TX complete arrives. If that was the last record and fragments
+ * are still outstanding, handle_data_characteristics() sets stored_data_done_pending instead of responding.
+ * The TX complete that takes chunks_outstanding to 0 calls it again; it then skips the count it already
+ * took, sends the RACP response and clears the flag. Starting or aborting a transfer clears it as well.
+ */
+static bool                     stored_data_done_pending        = false;  // Pipelined: all records queued, waiting on TX complete
+static s_MsmtGroupData          *sending_group                  = NULL;   // Group whose buffer global_send is sending
+static s_MsmtGroupData          *pending_group                  = NULL;   // Group encoded while sending, sent when the send completes
+static unsigned long            pending_recordNumber            = 0;
+static uint16_t                 pending_handle                  = BLE_GATT_HANDLE_INVALID;
+static unsigned long            racp_start_ticks                = 0;
+static bool                     bulk_transfer_mode              = false;  // Short connection interval and 2M PHY requested
+static unsigned long            racp_bytes_notified             = 0;  // Stored data statistics per RACP request
+static unsigned long            racp_notifications              = 0;
+static unsigned long long       racp_encode_rtc_count           = 0;
+#define RACP_ACK_RECORDS 16     // Stored records handed to the SoftDevice whose last fragment is not yet acknowledged
+static unsigned long            racp_ack_record[RACP_ACK_RECORDS];
+static unsigned long            racp_ack_fragments[RACP_ACK_RECORDS];  // racp_notifications once the record's last fragment was handed off
+static unsigned short           racp_ack_head                   = 0;
+static unsigned short           racp_ack_tail                   = 0;
+static unsigned long            racp_fragments_acked            = 0;
+static bool                     racp_resume_dirty               = false;  // racpResume differs from the copy saved with the bonding data
 
 static uint16_t                 m_connection_handle             = BLE_CONN_HANDLE_INVALID;     /**< Handle of the current connection. */
 static uint16_t                 m_ghs_bt_sig_service_handle     = BLE_GATT_HANDLE_INVALID;
@@ -203,15 +232,12 @@ unsigned short                  num_records_to_send             = 0;
 uint16_t                        current_char_handle             = BLE_GATT_HANDLE_INVALID;
 ble_gap_conn_params_t           gap_conn_params;
 nrf_mutex_t p_mutex;
-nrf_mutex_t q_mutex;
 //static __align(4) uint32_t evt_buf[CEIL_DIV(BLE_STACK_EVT_MSG_BUF_SIZE, sizeof(uint32_t))];
 __ALIGN(4) uint8_t *evt_buf;
 __ALIGN(4) uint8_t *evt_buf2;
 
 static uint8_t cpResponse[6];
 
-uint8_t tempBuf[512];  // For send_data
-
 //=========================== PARAMETERS FOR GHS DATA
 s_Queue *queue;
 
@@ -249,6 +275,7 @@ unsigned char GET_NUMBER_OF_RECORDS_RESP_SUCCESS[6]   = {0x05, 0x00, 0x00, 0x00,
 unsigned char GET_RECORDS_RESP_SUCCESS[4]             = {0x06, 0x00, 0x01, 0x01};  // same for all, gte, first. last operators
 unsigned char GET_COMBO_RECORDS_RESP_SUCCESS[6]       = {0x08, 0x00, 0x00, 0x00, 0x00, 0x00};  // Same set of responses for all combo cases. Last two bytes number of records sent
 unsigned char DELETE_RECORDS_RESP_SUCCESS[4]          = {0x06, 0x00, 0x02, 0x01};  // same for all, gte, first. last operators 
+unsigned char ABORT_RESP_SUCCESS[4]                   = {0x06, 0x00, 0x03, 0x01};
 
 unsigned char RESP_RACP_ERROR[6]                = {0x06, 0x00, 0x00, 0x06, 0x00, 0x00};  // need to fill [2] with the op-code (01 for get records, 07 for combo, 02 for delete)
 
@@ -602,6 +629,44 @@ static uint32_t conn_params_init(void)
     return sd_ble_gap_ppcp_set(cp_init.p_conn_params);
 }
 
+/**@brief Function for entering or leaving bulk transfer mode.
+ *
+ * @details On entry the 2M PHY and a short connection interval are requested so an RACP transfer or
+ *          spirometer stream takes less time. On exit the low power connection interval and, unless
+ *          BULK_KEEP_2M_PHY is set, the 1M PHY are requested again, leaving the link as the peer
+ *          set it up. 1M has the longer range and some peers only switched to 2M because we asked.
+ *
+ * @param[in] enable  true when the transfer starts, false when it ends.
+ */
+static void set_bulk_transfer_mode(bool enable)
+{
+    ret_code_t err_code;
+
+    if (enable == bulk_transfer_mode || m_connection_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return;
+    }
+    ble_gap_conn_params_t conn_params;
+    memset(&conn_params, 0, sizeof(conn_params));
+    conn_params.min_conn_interval = enable ? BULK_MIN_CONN_INTERVAL : MIN_CONN_INTERVAL;
+    conn_params.max_conn_interval = enable ? BULK_MAX_CONN_INTERVAL : MAX_CONN_INTERVAL;
+    conn_params.slave_latency     = SLAVE_LATENCY;
+    conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+    err_code = sd_ble_gap_conn_param_update(m_connection_handle, &conn_params);
+    NRF_LOG_DEBUG("Bulk transfer mode %u: connection parameter update request result %d", enable, err_code);
+    if (enable || BULK_KEEP_2M_PHY == 0)
+    {
+        ble_gap_phys_t const phys =
+        {
+            .rx_phys = enable ? BLE_GAP_PHY_2MBPS : BLE_GAP_PHY_1MBPS,
+            .tx_phys = enable ? BLE_GAP_PHY_2MBPS : BLE_GAP_PHY_1MBPS,
+        };
+        err_code = sd_ble_gap_phy_update(m_connection_handle, &phys);
+        NRF_LOG_DEBUG("Bulk transfer mode %u: %uM PHY request result %d", enable, enable ? 2 : 1, err_code);
+    }
+    bulk_transfer_mode = enable;
+}
+
 
 /**@brief Function for putting the chip into sleep mode.
  *
@@ -636,6 +701,7 @@ static void getCurrentTime()
 
 static void ghscp_handler(unsigned char *cmd, unsigned short len);
 static void racp_handler(unsigned char *cmd, unsigned short len);
+static void handle_data_characteristics();
 static void handleSetTime(unsigned char *setTime);
 
 static bool do_read_request(ble_evt_t * p_ble_evt)
@@ -719,7 +785,10 @@ static bool do_read_request(ble_evt_t * p_ble_evt)
         {
             if (cccdSet[RACP_CCCD_INDEX])
             {
-                if (global_send.number_of_groups == 0)
+                // An abort is the one request taken while a transfer is in progress
+                if (global_send.number_of_groups == 0 ||
+                    (p_ble_evt->evt.gatts_evt.params.authorize_request.request.write.len > 0 &&
+                     p_ble_evt->evt.gatts_evt.params.authorize_request.request.write.data[0] == RACP_ABORT))
                 {
                     reply.params.write.gatt_status = BLE_GATT_STATUS_SUCCESS;
                     reply.params.write.update = 1;
@@ -912,6 +981,73 @@ static void print_data(unsigned char *data, unsigned short data_length)
     }
 }
 
+/*
+ * Sets the chunk size of the fragmenter from the ATT MTU and the link layer data length. A notification of
+ * the chunk size plus the ATT and L2CAP headers is sent in as many LL packets as needed, so the chunk is cut
+ * back to fill whole LL packets instead of leaving the last one mostly empty. When the whole MTU fits in one
+ * LL packet the MTU is the limit.
+ */
+static void update_chunk_size(void)
+{
+    unsigned short att_payload = mtu_size - OPCODE_LENGTH - HANDLE_LENGTH;
+    unsigned short overhead = OPCODE_LENGTH + HANDLE_LENGTH + L2CAP_HEADER_LENGTH;
+    unsigned short ll_packets = (att_payload + overhead) / data_length;
+    if (ll_packets == 0)
+    {
+        global_send.chunk_size = att_payload;
+        global_send.ll_packets_per_chunk = 1;
+    }
+    else
+    {
+        global_send.chunk_size = ll_packets * data_length - overhead;
+        global_send.ll_packets_per_chunk = ll_packets;
+    }
+    NRF_LOG_INFO("Chunk size %u bytes in %u LL packets (MTU %u, LL data length %u)",
+        global_send.chunk_size, global_send.ll_packets_per_chunk, mtu_size, data_length);
+}
+
+// Forgets where an interrupted stored data transfer would resume
+static void clearRacpResume(void)
+{
+    if (racpResume.magic == RACP_RESUME_MAGIC)
+    {
+        racp_resume_dirty = true;
+    }
+    memset(&racpResume, 0, sizeof(s_RacpResume));
+}
+
+// Remembers the stored record whose last fragment was just handed to the SoftDevice
+static void trackRacpRecordSent(unsigned long recordNum)
+{
+    if ((unsigned short)(racp_ack_head - racp_ack_tail) >= RACP_ACK_RECORDS)
+    {
+        racp_ack_tail++;    // Cannot happen with HVN_TX_QUEUE_SIZE fragments in flight; at worst a record is resent
+    }
+    racp_ack_record[racp_ack_head % RACP_ACK_RECORDS] = recordNum;
+    racp_ack_fragments[racp_ack_head % RACP_ACK_RECORDS] = racp_notifications;
+    racp_ack_head++;
+}
+
+// Moves the resume cursor to the last stored record all of whose fragments the peer has acknowledged
+static void trackRacpFragmentsAcked(unsigned short count)
+{
+    racp_fragments_acked = racp_fragments_acked + count;
+    while (racp_ack_tail != racp_ack_head && racp_ack_fragments[racp_ack_tail % RACP_ACK_RECORDS] <= racp_fragments_acked)
+    {
+        racpResume.lastRecordNumber = racp_ack_record[racp_ack_tail % RACP_ACK_RECORDS];
+        racpResume.magic = RACP_RESUME_MAGIC;
+        racp_resume_dirty = true;
+        racp_ack_tail++;
+    }
+}
+
+// True if cmd repeats the request whose transfer to the bonded peer was cut short
+static bool isRacpResumable(unsigned char *cmd, unsigned short len)
+{
+    return (racpResume.magic == RACP_RESUME_MAGIC && racpResume.commandLength == len
+            && memcmp(racpResume.command, cmd, len) == 0);
+}
+
 static ret_code_t send_data()
 {
     if (global_send.data_length == 0 || !send_flag)   // Nothing to send
@@ -943,9 +1079,10 @@ static ret_code_t send_data()
     {
         unsigned short data_reduction = 0; // Reduction of data size sent due to fragment and record number headers
         bool insert_recordNumber = false;
+        unsigned char *fragment = NULL;    // Where the headers are written in front of the fragment's data
+        uint8_t overwritten[SEGMENT_HEADROOM];  // Data bytes the headers cover; restored once the SoftDevice has the fragment
         if (global_send.handle == m_ghs_bt_sig_live_data_not_handle.value_handle || global_send.handle == m_ghs_bt_sig_stored_data_not_handle.value_handle)
         {
-            memset(tempBuf, 0, 512);
             if (ghs_abort // connection has been terminated by PHG
                 || (m_connection_handle == BLE_CONN_HANDLE_INVALID))    // the connection has been killed
             {
@@ -959,16 +1096,16 @@ static ret_code_t send_data()
                 if ((frag_header & 0x01) == 0x01)  // if first fragment
                 {
                     insert_recordNumber = true;    // need to insert record number as well as fragment
-                    data_reduction = 5;            // How much the actual data size being sent is reduced
+                    data_reduction = SEGMENT_HEADER_LENGTH + RECORD_NUMBER_LENGTH; // How much the actual data size being sent is reduced
                 }
                 else
                 {
-                    data_reduction = 1;
+                    data_reduction = SEGMENT_HEADER_LENGTH;
                 }
             }
             else if (global_send.handle == m_ghs_bt_sig_live_data_not_handle.value_handle)
             {
-                data_reduction = 1;
+                data_reduction = SEGMENT_HEADER_LENGTH;
             }
             // If amount of data exceeds max size, send chunk sized length of data
             if (global_send.data_length - global_send.offset > global_send.chunk_size - data_reduction) //(mtu_size - OPCODE_LENGTH - HANDLE_LENGTH))
@@ -998,6 +1135,7 @@ static ret_code_t send_data()
                 global_send.offset = 0;
                 global_send.data = NULL;
                 global_send.handle = 0;
+                pending_group = NULL;
                 emptyQueue(queue);
                 error_code = NRF_SUCCESS;
                 break;
@@ -1006,21 +1144,17 @@ static ret_code_t send_data()
             hvx_params.offset = 0; // global_send_offset;
             hvx_params.p_len = &hvx_length;
         
-            // Insert headers
-
-            if (insert_recordNumber)
+            // Insert headers in place. The first fragment's headers go in the headroom in front of the group data
+            // (see createMsmtGroupDataArray()); later ones cover the tail of the fragment already sent. Those
+            // bytes are saved and put back after the send since the template is reused for the next measurement.
+            fragment = (unsigned char *)(global_send.data + global_send.offset - data_reduction);
+            memcpy(overwritten, fragment, data_reduction);
+            fragment[0] = frag_header;
+            if (insert_recordNumber)    // record number only on first fragment
             {
-                // Here is the crap - I have to stick one extra byte at the start of this fragment and the record number, but record number only on first fragment.
-                memcpy(&tempBuf[data_reduction], (unsigned char *)(global_send.data + global_send.offset), (hvx_length - data_reduction ));
-                tempBuf[0] = frag_header;
-                fourByteEncode(tempBuf, 1, recordNum);
-            }
-            else
-            {
-                // Here is the crap - I have to stick one extra byte at the start of this fragment.
-                memcpy(&tempBuf[data_reduction], (unsigned char *)(global_send.data + global_send.offset), (hvx_length - data_reduction ));
-                tempBuf[0] = frag_header;
+                fourByteEncode(fragment, SEGMENT_HEADER_LENGTH, recordNum);
             }
+            hvx_params.p_data = fragment;
         }
         else // No fragmentation for control point indications
         {
@@ -1029,16 +1163,28 @@ static ret_code_t send_data()
             hvx_params.offset = 0;
             hvx_length = global_send.data_length;
             hvx_params.p_len = &hvx_length;
-            memcpy(tempBuf, global_send.data, hvx_length);
+            hvx_params.p_data = global_send.data;
         }
-        hvx_params.p_data = tempBuf;
 
         // Send indication or notification
         NRF_LOG_DEBUG("=====> Sending fragment of %u bytes", hvx_length);
-        print_data(tempBuf, hvx_length);
+        print_data((unsigned char *)hvx_params.p_data, hvx_length);
         error_code = sd_ble_gatts_hvx(m_connection_handle, &hvx_params);
+        if (error_code == NRF_ERROR_BUSY)  // Indications only
+        {
+            while (sd_ble_gatts_hvx(m_connection_handle, &hvx_params) == NRF_ERROR_BUSY);  // keep calling until not busy.
+        }
+        if (fragment != NULL)   // The SoftDevice copies the fragment in sd_ble_gatts_hvx() so the data can be restored
+        {
+            memcpy(fragment, overwritten, data_reduction);
+        }
         if (error_code == NRF_SUCCESS)
         {
+            if (global_send.handle == m_ghs_bt_sig_stored_data_not_handle.value_handle)
+            {
+                racp_bytes_notified = racp_bytes_notified + hvx_length;
+                racp_notifications++;
+            }
             frag_header = (frag_header & 0xFE);
             // This is for notifications. We need to make sure all notifications are accounted for before indicating that the 
             // record is complete. So it increments here, and decrements in the BLE_EVT_TX_COMPLETE event. The event may
@@ -1050,6 +1196,21 @@ static ret_code_t send_data()
             if (global_send.offset >= global_send.data_length)
             {
                 NRF_LOG_DEBUG("=====> Entire package sent");
+                if (global_send.handle == m_ghs_bt_sig_stored_data_not_handle.value_handle)
+                {
+                    trackRacpRecordSent(global_send.recordNumber);
+                }
+                #if (USES_STORED_DATA == 1 && PIPELINE_STORED_DATA == 1)
+                    // The SoftDevice has copied every fragment so the template is free. Queue the next record now
+                    // so it is encoded while this one is still being notified. Indications still wait for the HVC.
+                    if (global_send.handle == m_ghs_bt_sig_stored_data_not_handle.value_handle
+                        && hvx_params.type == BLE_GATT_HVX_NOTIFICATION)
+                    {
+                        global_send.data_length = 0;
+                        global_send.offset = 0;
+                        handle_data_characteristics();
+                    }
+                #endif
                 error_code = NRF_SUCCESS;
                 break;
             }
@@ -1063,14 +1224,21 @@ static ret_code_t send_data()
             //NRF_LOG_DEBUG("=====> TX buffer still available");
             continue;
         }
-        // This will only happen for indications. Here we simply loop on redoing the send calls
-        // until the send goes, then we can advance the buffer and wait for the BLE_GATTS_EVT_HVC event.
+        // This will only happen for indications. The send calls were redone above until the send went,
+        // so we can advance the buffer and wait for the BLE_GATTS_EVT_HVC event.
         else if (error_code == NRF_ERROR_BUSY)  // Indications only
         {
-            while (sd_ble_gatts_hvx(m_connection_handle, &hvx_params) == NRF_ERROR_BUSY);  // keep calling until not busy.
             frag_header = (frag_header & 0xFE);
             global_send.offset = global_send.offset + *hvx_params.p_len - 1;
             global_send.chunks_outstanding++;
+            if (global_send.handle == m_ghs_bt_sig_stored_data_not_handle.value_handle)
+            {
+                racp_notifications++;   // Every fragment is counted so its HVC moves the resume cursor correctly
+                if (global_send.offset >= global_send.data_length)
+                {
+                    trackRacpRecordSent(global_send.recordNumber);
+                }
+            }
             error_code = NRF_SUCCESS;
             break;    // Wait for event
         }
@@ -1090,6 +1258,7 @@ static ret_code_t send_data()
             global_send.offset = 0;
             global_send.data = NULL;
             global_send.handle = 0;
+            pending_group = NULL;
             emptyQueue(queue);
             break;
         }
@@ -1139,10 +1308,28 @@ bool prepareMeasurements(s_MsmtGroupData *msmtGroupData, unsigned short recordNu
         && ((cccdSet[LIVE_DATA_CCCD_INDEX] && live_data_mode) ||    // the live data characteristic has been enabled and live data is active
             (cccdSet[STORED_DATA_CCCD_INDEX] && racp_mode)))   // the stored data characteristic has been enabled and live data is not active
     {
+        if (global_send.handle != 0)    // Still sending the previous group
+        {
+            // The update methods may fill this group now only if that does not touch the buffer being sent. It is
+            // sent from send_pending_group() when the current send completes.
+            if (global_send.handle != m_ghs_bt_sig_live_data_not_handle.value_handle || pending_group != NULL
+                || (msmtGroupData == sending_group && msmtGroupData->altData == NULL))
+            {
+                return false;
+            }
+            pending_group = msmtGroupData;
+            pending_recordNumber = recordNumber;
+            pending_handle = current_char_handle;
+            return true;
+        }
+        sending_group = msmtGroupData;
         global_send.data = msmtGroupData->data;
 
         // Set up parameters for notification of this PDU - likely in fragments
-        global_send.chunks_outstanding = 0;
+        if (!PIPELINE_STORED_DATA || current_char_handle != m_ghs_bt_sig_stored_data_not_handle.value_handle)
+        {
+            global_send.chunks_outstanding = 0; // Pipelined records may still have notifications of the previous one outstanding
+        }
         global_send.handle = current_char_handle;
         global_send.offset = 0;
         global_send.data_length = (unsigned short)msmtGroupData->dataLength;
@@ -1164,23 +1351,86 @@ void sendStoredMeasurements(unsigned short stored_count)
     }
 }
 
+#if (USES_STORED_DATA == 1)
+// Drops everything of the stored data transfer not yet handed to the SoftDevice. Fragments it already holds
+// still go out; the client discards the incomplete record. The work does not depend on the number of records left.
+static void stop_stored_data_transfer(void)
+{
+    global_send.number_of_groups = 0;
+    stored_data_done_pending = false;
+    stored_data_done_sent = true;
+    pending_group = NULL;
+    requestEmptyQueue(queue);   // The main loop is the only consumer; it empties the queue before its next record
+    racp_mode = false;
+    set_bulk_transfer_mode(false);
+}
+#endif
+
+/*
+ * If a group is being sent, prepareMeasurements() only lets the encoder run when the new group can be held
+ * in a free buffer until the send completes. Otherwise the measurement stays in the queue and is tried again
+ * instead of being dropped.
+ *
+ * A stored msmt is queued as a reference and unpacked from the log here. If it can no longer be unpacked the
+ * stored records moved under the transfer (a full log dropped its oldest) and the rest of its indices are off
+ * too, so the transfer ends with procedure not completed.
+ */
 static bool encodeMsmtData(void *data)
 {
-    if (global_send.handle != 0)
+    s_MsmtData stored;
+    if (global_send.handle == 0 && send_flag)
     {
-        if (!ghs_abort)
+        NRF_LOG_DEBUG("Not ready for live measurement # %lu, still sending", live_data_count);
+        return false;
+    }
+    unsigned long long encodeStart = getRtcCount();
+    if (((s_MsmtData *)data)->common.isStoredData)
+    {
+        if (!getReferencedStoredMsmt((s_StoredMsmtReference *)data, &stored))
         {
-            emptyQueue(queue);
+            dequeue(queue);
+            #if (USES_STORED_DATA == 1)
+                NRF_LOG_INFO("----> Stored data transfer ended with %u records left", global_send.number_of_groups);
+                stop_stored_data_transfer();
+                RESP_RACP_ERROR[2] = (global_send.current_command & 0xFF);
+                RESP_RACP_ERROR[3] = RACP_PROCEDURE_NOT_COMPLETED;
+                createRacpResponse(RESP_RACP_ERROR, 4);  // Replaces the record being sent
+                send_flag = true;
+            #endif
+            return false;
         }
+        data = &stored;
+    }
+    if (!encodeSpecializationMsmts((s_MsmtData *)data))
+    {
         NRF_LOG_DEBUG("Not ready for measurement # %lu", live_data_count);
         return false;
     }
-    if (send_flag)
+    if (((s_MsmtData *)data)->common.isStoredData)
     {
-        NRF_LOG_DEBUG("Not ready for live measurement # %lu, still sending", live_data_count);
-        return false;
+        racp_encode_rtc_count = racp_encode_rtc_count + (getRtcCount() - encodeStart);
+    }
+    if (sending_group != NULL && global_send.data == sending_group->data)   // Send starts now
+    {
+        global_send.data_length = sending_group->dataLength;    // The encoder may have dropped or restored a msmt
+        swapMsmtGroupDataBuffers(&sending_group);               // Further updates go to the other buffer
     }
-    return encodeSpecializationMsmts((s_MsmtData *)data);
+    return true;
+}
+
+// Starts sending the group that was encoded while the previous one was being sent
+static void send_pending_group(void)
+{
+    sending_group = pending_group;
+    pending_group = NULL;
+    global_send.chunks_outstanding = 0;
+    global_send.handle = pending_handle;
+    global_send.offset = 0;
+    global_send.data = sending_group->data;
+    global_send.data_length = sending_group->dataLength;
+    global_send.recordNumber = pending_recordNumber;
+    swapMsmtGroupDataBuffers(&sending_group);
+    send_flag = true;
 }
 
 /*
@@ -1256,6 +1506,9 @@ static void ghscp_handler(unsigned char *cmd, unsigned short len)
 
                 createCpResponse(GHSCP_RSP_SUCCESS, 1);       // Indicate a success response
                 live_data_mode = (cmd[0] == GHSCP_SET_LIVE_DATA_MODE);       // Set/Clear our internal live data mode flag
+                #if (SPIROMETER == 1)
+                    set_bulk_transfer_mode(live_data_mode);     // RTSA streams
+                #endif
                 NRF_LOG_INFO("Current enabled state of live data characteristic %u.  Live data mode is now %u", cccdSet[LIVE_DATA_CCCD_INDEX], live_data_mode);
             }
             else
@@ -1277,6 +1530,42 @@ static void ghscp_handler(unsigned char *cmd, unsigned short len)
 
 }
 
+// Returns the log text of a RACP GTE, LTE or RANGE request, or NULL if the operand type is not supported
+static char *getRacpFilterString(unsigned char *cmd, bool count)
+{
+    bool byRecordNumber = (cmd[2] == RACP_RECORD_NUM);
+    if (cmd[2] != RACP_RECORD_NUM && cmd[2] != RACP_TIMESTAMP)
+    {
+        return NULL;
+    }
+    switch (cmd[1])
+    {
+        case RACP_GTE:
+            if (count)
+            {
+                return byRecordNumber ? "get Number of Records >= record number" : "get Number of Records >= timestamp";
+            }
+            return byRecordNumber ? "get records GTE to record num" : "get records GTE to time stamp";
+
+        case RACP_LTE:
+            if (count)
+            {
+                return byRecordNumber ? "get Number of Records <= record number" : "get Number of Records <= timestamp";
+            }
+            return byRecordNumber ? "get records LTE to record num" : "get records LTE to time stamp";
+
+        case RACP_RANGE:
+            if (count)
+            {
+                return byRecordNumber ? "get Number of Records in record number range" : "get Number of Records in timestamp range";
+            }
+            return byRecordNumber ? "get records in record num range" : "get records in time stamp range";
+
+        default:
+            return NULL;
+    }
+}
+
 static void racp_handler(unsigned char *cmd, unsigned short len)
 {
     global_send.current_command = cmd[0] + (cmd[1] << 8);  // We made need to include cmd[2]
@@ -1304,40 +1593,30 @@ static void racp_handler(unsigned char *cmd, unsigned short len)
             switch (cmd[1])
             {
                 case RACP_ALL:
-                {
                     str = "get Number of all Records";
-                    printCommand(str, global_send.current_command);
-                    NRF_LOG_INFO("Number of all records is %u", numberOfStoredMsmtGroups);
-                    GET_NUMBER_OF_RECORDS_RESP_SUCCESS[2] = (numberOfStoredMsmtGroups & 0xFF);
-                    GET_NUMBER_OF_RECORDS_RESP_SUCCESS[3] = ((numberOfStoredMsmtGroups >> 8) & 0xFF);
-                    GET_NUMBER_OF_RECORDS_RESP_SUCCESS[4] = 0;
-                    GET_NUMBER_OF_RECORDS_RESP_SUCCESS[5] = 0;
-                    createRacpResponse(GET_NUMBER_OF_RECORDS_RESP_SUCCESS, 6);
-
-                    send_flag = true;
-                }
-                break;
-                
+                case RACP_FIRST:
+                    str = (str != NULL) ? str : "get Number of first Record";
+                case RACP_LAST:
+                    str = (str != NULL) ? str : "get Number of last Record";
                 case RACP_GTE:
+                case RACP_LTE:
+                case RACP_RANGE:
                 {
-                    unsigned short numberOfRecords = getNumberOfStoredRecords(cmd, len);
-                    if (cmd[2] == RACP_RECORD_NUM)
-                    {
-                        str = "get Number of Records >= record number";
-                    }
-                    else if (cmd[2] == RACP_TIMESTAMP)
-                    {
-                        str = "get Number of Records >= timestamp";
-                    }
-                    else // unsupported operand
+                    unsigned short start;
+                    if (str == NULL)
                     {
-                        RESP_RACP_ERROR[2] = cmd[0];
-                        RESP_RACP_ERROR[3] = RACP_OPERAND_NOT_SUPPORTED;
-                        createRacpResponse(RESP_RACP_ERROR, 4);
-                        send_flag = true;
-                        break;
+                        str = getRacpFilterString(cmd, true);
+                        if (str == NULL) // unsupported operand
+                        {
+                            RESP_RACP_ERROR[2] = cmd[0];
+                            RESP_RACP_ERROR[3] = RACP_OPERAND_NOT_SUPPORTED;
+                            createRacpResponse(RESP_RACP_ERROR, 4);
+                            send_flag = true;
+                            break;
+                        }
+                        global_send.current_command = global_send.current_command + (cmd[2] << 16);
                     }
-                    global_send.current_command = global_send.current_command + (cmd[2] << 16);
+                    unsigned short numberOfRecords = findStoredRecords(cmd, len, &start);
                     printCommand(str, global_send.current_command);
                     
                     NRF_LOG_INFO("Number of records is %u", numberOfRecords);
@@ -1385,9 +1664,22 @@ static void racp_handler(unsigned char *cmd, unsigned short len)
                 break;
             }
             bool combined = (cmd[0] == RACP_GET_COMBINED);
-            num_records_to_send = getNumberOfStoredRecords(cmd, len);
-            long start_index = getStartIndexInStoredRecords(cmd, len);
-            NRF_LOG_DEBUG("----> Number of records to send %u Start index %i", num_records_to_send, start_index);
+            unsigned short start_index;
+            num_records_to_send = findStoredRecords(cmd, len, &start_index);   // One search gives both
+            bool resumed = isRacpResumable(cmd, len);
+            if (resumed)
+            {
+                // Skip what the peer acknowledged before the link dropped
+                unsigned short end = start_index + num_records_to_send;
+                unsigned short resume = findStoredRecordAfter(racpResume.lastRecordNumber);
+                if (resume > start_index)
+                {
+                    start_index = (resume < end) ? resume : end;
+                    num_records_to_send = end - start_index;
+                }
+                NRF_LOG_INFO("----> Resuming stored data transfer after record number %u", racpResume.lastRecordNumber);
+            }
+            NRF_LOG_DEBUG("----> Number of records to send %u Start index %u", num_records_to_send, start_index);
             switch(cmd[1])
             {
                 case RACP_ALL:
@@ -1397,17 +1689,12 @@ static void racp_handler(unsigned char *cmd, unsigned short len)
                 case RACP_LAST:
                     str = (str != NULL) ? str : "get last record";
                 case RACP_GTE:
+                case RACP_LTE:
+                case RACP_RANGE:
                     if (str == NULL)
                     {
-                        if (cmd[2] == RACP_RECORD_NUM)
-                        {
-                            str = "get records GTE to record num";
-                        }
-                        else if (cmd[2] == RACP_TIMESTAMP)
-                        {
-                            str = "get records GTE to time stamp";
-                        }
-                        else // unsupported operand
+                        str = getRacpFilterString(cmd, false);
+                        if (str == NULL) // unsupported operand
                         {
                             RESP_RACP_ERROR[2] = cmd[0];
                             RESP_RACP_ERROR[3] = RACP_OPERAND_NOT_SUPPORTED;
@@ -1420,15 +1707,50 @@ static void racp_handler(unsigned char *cmd, unsigned short len)
                     racp_request = cmd[0];
                     stored_data_done_sent = false;
                     printCommand(str, global_send.current_command);
-                    if (start_index >= 0)
+                    if (num_records_to_send > 0)
                     {
+                        if (!resumed)
+                        {
+                            clearRacpResume();
+                            if (len <= RACP_RESUME_COMMAND_LENGTH)
+                            {
+                                racpResume.commandLength = len;
+                                memcpy(racpResume.command, cmd, len);
+                            }
+                        }
+                        racp_ack_head = 0;
+                        racp_ack_tail = 0;
+                        racp_fragments_acked = 0;
                         racp_mode = true;
-                        NRF_LOG_DEBUG("----> Sending stored data element %i", start_index);
+                        NRF_LOG_DEBUG("----> Sending stored data element %u", start_index);
                         global_send.number_of_groups = num_records_to_send;
+                        global_send.next_group = start_index + 1;
+                        stored_data_done_pending = false;
+                        racp_start_ticks = getTicks();
+                        set_bulk_transfer_mode(true);
+                        racp_bytes_notified = 0;
+                        racp_notifications = 0;
+                        racp_encode_rtc_count = 0;
+                        queue->bytesCopied = 0;
                         current_char_handle = m_ghs_bt_sig_stored_data_not_handle.value_handle;   // NEEDED FOR THE SEND_DATA method!!
                         sendStoredMeasurements(start_index);
                     }
-                    else if (num_records_to_send == 0)
+                    else if (resumed)
+                    {
+                        // All of it was delivered before the link dropped
+                        clearRacpResume();
+                        if (combined)
+                        {
+                            memset(&GET_COMBO_RECORDS_RESP_SUCCESS[2], 0, 4);
+                            createRacpResponse(GET_COMBO_RECORDS_RESP_SUCCESS, 6);
+                        }
+                        else
+                        {
+                            createRacpResponse(GET_RECORDS_RESP_SUCCESS, 4);
+                        }
+                        send_flag = true;
+                    }
+                    else
                     {
                         RESP_RACP_ERROR[2] = cmd[0];
                         RESP_RACP_ERROR[3] = RACP_NO_RECORDS_FOUND;
@@ -1455,6 +1777,28 @@ static void racp_handler(unsigned char *cmd, unsigned short len)
         #endif
     }
 
+    case RACP_ABORT:
+        #if (USES_STORED_DATA != 1)
+            RESP_RACP_ERROR[2] = cmd[0];
+            RESP_RACP_ERROR[3] = RACP_OPCODE_NOT_SUPPORTED;
+            createRacpResponse(RESP_RACP_ERROR, 4);
+            send_flag = true;
+            return;
+        #else
+            str = "Abort";
+            printCommand(str, global_send.current_command);
+            if (racp_mode)
+            {
+                // The response goes out in the next connection event
+                NRF_LOG_INFO("----> Stored data transfer aborted with %u records left", global_send.number_of_groups);
+                stop_stored_data_transfer();
+                clearRacpResume();  // The client asked to stop; it does not want the rest later either
+            }
+            createRacpResponse(ABORT_RESP_SUCCESS, 4);  // Replaces the record being sent
+            send_flag = true;
+            break;
+        #endif
+
     case RACP_DELETE_RECORDS:
         #if (USES_STORED_DATA != 1)
             RESP_RACP_ERROR[2] = cmd[0];
@@ -1476,16 +1820,61 @@ static void racp_handler(unsigned char *cmd, unsigned short len)
                 break;
             }
             str = "Delete All Stored Records";
-            if (!live_data_mode)
+            if (!live_data_mode && cmd[1] == RACP_ALL)
             {
                 deleteStoredSpecializationMsmts();  // really don't need this, setting numberOfStoredMsmtGroups to 0 will do it.
                 numberOfStoredMsmtGroups = 0;
                 recordNumber = 0;
+                clearRacpResume();                  // Record numbers start over
                 // Respond with command done
                 printCommand(str, global_send.current_command);
                 createRacpResponse(DELETE_RECORDS_RESP_SUCCESS, 4);
                 send_flag = true;
-                stored_msmts_same = false;
+            }
+            else if (!live_data_mode)
+            {
+                // Typically all records up to the last one the gateway has acknowledged
+                unsigned short start;
+                unsigned short numberOfRecords;
+                if (cmd[1] == RACP_FIRST || cmd[1] == RACP_LAST)
+                {
+                    str = (cmd[1] == RACP_FIRST) ? "Delete first Stored Record" : "Delete last Stored Record";
+                }
+                else
+                {
+                    str = (cmd[2] == RACP_RECORD_NUM) ? "Delete Stored Records by record number" : "Delete Stored Records by timestamp";
+                    if ((cmd[1] != RACP_GTE && cmd[1] != RACP_LTE && cmd[1] != RACP_RANGE) ||
+                        (cmd[2] != RACP_RECORD_NUM && cmd[2] != RACP_TIMESTAMP))
+                    {
+                        RESP_RACP_ERROR[2] = cmd[0];
+                        RESP_RACP_ERROR[3] = (cmd[1] > RACP_LAST) ? RACP_OPERATOR_NOT_SUPPORTED : RACP_OPERAND_NOT_SUPPORTED;
+                        createRacpResponse(RESP_RACP_ERROR, 4);
+                        send_flag = true;
+                        break;
+                    }
+                    global_send.current_command = global_send.current_command + (cmd[2] << 16);
+                }
+                printCommand(str, global_send.current_command);
+                numberOfRecords = findStoredRecords(cmd, len, &start);
+                if (numberOfRecords == 0)
+                {
+                    RESP_RACP_ERROR[2] = cmd[0];
+                    RESP_RACP_ERROR[3] = RACP_NO_RECORDS_FOUND;
+                    createRacpResponse(RESP_RACP_ERROR, 4);
+                }
+                else if (!deleteStoredMsmts(start, numberOfRecords))   // Slots are tombstoned in the background
+                {
+                    RESP_RACP_ERROR[2] = cmd[0];
+                    RESP_RACP_ERROR[3] = RACP_SERVER_BUSY;
+                    createRacpResponse(RESP_RACP_ERROR, 4);
+                }
+                else
+                {
+                    NRF_LOG_INFO("Deleted %u records from index %u", numberOfRecords, start);
+                    numberOfStoredMsmtGroups = numberOfStoredMsmtGroups - numberOfRecords;
+                    createRacpResponse(DELETE_RECORDS_RESP_SUCCESS, 4);
+                }
+                send_flag = true;
             }
             else
             {
@@ -1571,7 +1960,7 @@ static bool handleCommonEvents(ble_evt_t* p_ble_evt)
                 mtu_size = NRF_SDH_BLE_GATT_MAX_MTU_SIZE;
                 NRF_LOG_DEBUG("MTU exchange request reply failed. Error code: 0x%02X", err_code);
             }
-            global_send.chunk_size = (mtu_size - OPCODE_LENGTH - HANDLE_LENGTH);
+            update_chunk_size();
             used = true;
             break;
 
@@ -1610,6 +1999,7 @@ static bool handleCommonEvents(ble_evt_t* p_ble_evt)
                     p_ble_evt->evt.gap_evt.params.data_length_update.effective_params.max_tx_octets,
                     p_ble_evt->evt.gap_evt.params.data_length_update.effective_params.max_tx_time_us);
                 data_length = p_ble_evt->evt.gap_evt.params.data_length_update.effective_params.max_tx_octets;
+                update_chunk_size();
             }
             used = true;
             break;
@@ -1642,20 +2032,45 @@ static void handle_data_characteristics()
 {
     global_send.handle = 0;
     NRF_LOG_DEBUG("----> Record is done");
+    if (pending_group != NULL)
+    {
+        send_pending_group();
+    }
     #if (USES_STORED_DATA == 1)
 
     if (((global_send.current_command & 0xFF) == RACP_GET_RECORDS) ||
          ((global_send.current_command & 0xFF) == RACP_GET_COMBINED))
     {
-        global_send.number_of_groups--;
+        if (!stored_data_done_pending)  // Already counted when the last pipelined record was handed off
+        {
+            global_send.number_of_groups--;
+        }
         if (global_send.number_of_groups > 0 && global_send.number_of_groups <= NUMBER_OF_STORED_MSMTS)
         {
-            NRF_LOG_DEBUG("----> Sending stored data element %u", (numberOfStoredMsmtGroups - global_send.number_of_groups));
-            sendStoredMeasurements(numberOfStoredMsmtGroups - global_send.number_of_groups);
+            NRF_LOG_DEBUG("----> Sending stored data element %u", global_send.next_group);
+            sendStoredMeasurements(global_send.next_group++);   // The selection need not run to the last record
         }
         else if (!stored_data_done_sent)
         {
-            NRF_LOG_INFO("----> All stored data sent");
+            if (PIPELINE_STORED_DATA && global_send.chunks_outstanding > 0)
+            {
+                // The last record is handed off but not all on air; respond once the TX complete arrives
+                stored_data_done_pending = true;
+                return;
+            }
+            stored_data_done_pending = false;
+            unsigned long elapsed = getTicks() - racp_start_ticks;
+            NRF_LOG_INFO("----> All stored data sent, %u bytes copied into the queue", queue->bytesCopied);
+            NRF_LOG_INFO("----> %u records in %u ms", num_records_to_send, elapsed);
+            NRF_LOG_INFO("----> Chunk size %u bytes, %u LL packets per chunk", global_send.chunk_size, global_send.ll_packets_per_chunk);
+            if (num_records_to_send > 0)
+            {
+                // ATT notification overhead is the opcode and handle on top of each fragment
+                NRF_LOG_INFO("----> %u notifications, %u ATT bytes per record, encoding %u us per record",
+                    racp_notifications,
+                    (racp_bytes_notified + racp_notifications * (OPCODE_LENGTH + HANDLE_LENGTH)) / num_records_to_send,
+                    (unsigned long)((racp_encode_rtc_count * 1000000 / 32768) / num_records_to_send));
+            }
             if (racp_request == RACP_GET_RECORDS) // Old RACP
             {
                 createRacpResponse(GET_RECORDS_RESP_SUCCESS, 4);
@@ -1670,6 +2085,7 @@ static void handle_data_characteristics()
             }
             global_send.number_of_groups = 0;
             stored_data_done_sent = true;
+            clearRacpResume();
             send_flag = true;
         }
     }
@@ -1707,8 +2123,13 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 
             NRF_LOG_INFO("Connection event received at time %u.", getTicks());
             m_connection_handle = p_ble_evt->evt.gap_evt.conn_handle;
-            global_send.chunk_size = (mtu_size - OPCODE_LENGTH - HANDLE_LENGTH);
+            bulk_transfer_mode = false;
+            mtu_size = BLE_GATT_ATT_MTU_DEFAULT;    // Until the client exchanges MTU and data length
+            data_length = 27;
+            update_chunk_size();
             frag_header = 0xFC;
+            sending_group = NULL;
+            pending_group = NULL;
             if (saveDataBuffer != NULL)
             {
                 // Calling sd_ble_gatts_sys_attr_set with CCCD info
@@ -1774,6 +2195,8 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
         case BLE_GAP_EVT_DISCONNECTED:
         {
             NRF_LOG_INFO("Disconnected at time %u", getTicks());
+            NRF_LOG_DEBUG("Queue high water mark %d, pool allocations avoided %u, overflows %u",
+                queue->highWaterMark, queue->allocationsAvoided, queue->overflowCount);
             #if (USES_LIVE_DATA == 1)
                 app_timer_stop(m_ghs_live_data_timer_id);
             #endif
@@ -1784,6 +2207,7 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
             bsp_board_led_off(MSMT_DATA_LED);
             bsp_board_led_on(DISCONNECTED_LED);
             ghs_abort = true;
+            pending_group = NULL;
 
             // call twice; once to get the size of the data
             // create the buffer,
@@ -1804,11 +2228,10 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
                 }
                 bool isEqual = ((currentSysDataLength == saveDataLength)
                                 && (saveDataLength > 0 && saveDataBuffer != NULL)
-                                && (memcmp(saveDataBuffer, currentSysDataBuffer, saveDataLength) == 0)
-                                && stored_msmts_same);
+                                && (memcmp(saveDataBuffer, currentSysDataBuffer, saveDataLength) == 0));
                 if (isEqual)
                 {
-                    NRF_LOG_INFO("Flash write not needed; data is equal to what is already in flash");
+                    NRF_LOG_INFO("Bonding data write not needed; data is equal to what is already in flash");
                     flash_write_needed = false;
                 }
                 else
@@ -1825,15 +2248,30 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
             }
             else
             {
-                flash_write_needed = !stored_msmts_same;
+                flash_write_needed = false;
             }
             m_connection_handle = BLE_CONN_HANDLE_INVALID;
+            if (racp_resume_dirty)
+            {
+                NRF_LOG_INFO("Saving RACP resume cursor; last acknowledged record number %u", racpResume.lastRecordNumber);
+                racp_resume_dirty = false;
+                flash_write_needed = true;
+            }
+            if (storedTimelinesChanged)
+            {
+                NRF_LOG_INFO("Saving stored msmt timelines; current timeline %u", storedTimelines.current);
+                storedTimelinesChanged = false;
+                flash_write_needed = true;
+            }
             if (flash_write_needed)
             {
+                // Bonding data is rewritten only when it changed. The flash writes are queued and
+                // done while we go back to advertising; stored msmts are saved from the main loop.
                 latestTimeStamp = getRtcTicks();
-                saveKeysToFlash(&keys, &saveDataBuffer, &saveDataLength, cccdSet, &noOfCccds);
-                stored_msmts_same = true;
-                break;
+                if (saveKeysToFlash(&keys, &saveDataBuffer, &saveDataLength, cccdSet, &noOfCccds))
+                {
+                    flash_write_needed = false;
+                }
             }
             reset_specializations();
             #if (USE_DK == 0)
@@ -1917,6 +2355,7 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
         {
             bsp_board_led_off(BSP_BOARD_BUTTON_3);
             NRF_LOG_INFO("Pairing completed");
+            clearRacpResume();  // A new bond; the cursor was for the previous peer
         }
         break;
         
@@ -1954,7 +2393,14 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 
 
         case BLE_GATTS_EVT_HVC:
-            global_send.chunks_outstanding--;                   // We don't need to do this - plays no role for indications
+            if (global_send.chunks_outstanding > 0)             // The HVC of a record dropped by an abort finds it 0
+            {
+                global_send.chunks_outstanding--;               // We don't need to do this - plays no role for indications
+            }
+            if (racp_mode && global_send.handle == m_ghs_bt_sig_stored_data_not_handle.value_handle)
+            {
+                trackRacpFragmentsAcked(1);
+            }
             if (global_send.offset >= global_send.data_length)  // Have all segments been indicated?
             {
                 NRF_LOG_INFO("----> Indications complete at time %u, connection handle 0x%04X", getTicks(), m_connection_handle);
@@ -1976,6 +2422,7 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
                 {
                     NRF_LOG_INFO("----> All stored data sent indication has been acknowledged");
                     racp_mode = false;
+                    set_bulk_transfer_mode(false);
                 }
                 break;
             }
@@ -2029,8 +2476,24 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
         // every notification, and decremented by p_ble_evt->evt.common_evt.params.tx_complete.count every event. When 0, the notification
         // sequence is done.
         case BLE_GATTS_EVT_HVN_TX_COMPLETE:  // This is the best we get for notifications
-            global_send.chunks_outstanding = global_send.chunks_outstanding - p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+            if (p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count > global_send.chunks_outstanding)
+            {
+                global_send.chunks_outstanding = 0;     // Fragments of a record dropped by an abort
+            }
+            else
+            {
+                global_send.chunks_outstanding = global_send.chunks_outstanding - p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+            }
+            if (racp_mode)  // Stored data is the only thing notified during a RACP transfer
+            {
+                trackRacpFragmentsAcked(p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count);
+            }
             NRF_LOG_DEBUG("----> Notification TX done event received. Packets sent and not evented %u", global_send.chunks_outstanding);
+            if (stored_data_done_pending && global_send.chunks_outstanding == 0)   // Last pipelined record is now on air
+            {
+                handle_data_characteristics();
+                break;
+            }
             if (global_send.chunks_outstanding > 0) // Have not received all events from notifications
             {
                 if (global_send.offset < global_send.data_length)
@@ -2039,6 +2502,10 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
                 }
                 break;
             }
+            if (global_send.data_length == 0)   // Nothing in hand; a pipelined record was handed off and the next is not encoded yet
+            {
+                break;
+            }
             if (global_send.offset >= global_send.data_length && global_send.offset > 0)  // Have all segments been notified?
             {   // If yes:
                 NRF_LOG_INFO("----> Notification(s) complete at time %u, connection handle 0x%04X", getTicks(), m_connection_handle);
@@ -2081,21 +2548,16 @@ static void write_flash(void * p_context)
  * @details This function is called from the System event interrupt handler after a system
  *          event has been received.
  *
- * @param[in] sys_evt  System stack event.
+ * @param[in] sys_evt    System stack event.
+ * @param[in] p_context  Not used.
  */
-/*
-static void sys_evt_dispatch(uint32_t sys_evt)
+static void sys_evt_dispatch(uint32_t sys_evt, void * p_context)
 {
-    // Dispatch the system event to the fstorage module, where it will be
-    // dispatched to the Flash Data Storage (FDS) module.
-    // fs_sys_event_handler(sys_evt);
-
-    // Dispatch to the Advertising module last, since it will check if there are any
-    // pending flash operations in fstorage. Let fstorage process system events first,
-    // so that it can report correctly to the Advertising module.
-    // ble_advertising_on_sys_evt(sys_evt);
+    // Flash operation results. The next queued operation is started from the main loop.
+    flashSysEventHandler(sys_evt);
 }
-*/
+
+NRF_SDH_SOC_OBSERVER(m_soc_observer, APP_SOC_OBSERVER_PRIO, sys_evt_dispatch, NULL);
 
 #define RAM_START       0x20000000
 static uint32_t ram_end_address_get(void)
@@ -2129,6 +2591,15 @@ static void ble_stack_init(void)
     err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
     APP_ERROR_CHECK(err_code);
 
+    // Let the SoftDevice queue several notifications so send_data() can fill a connection event
+    // instead of stopping at NRF_ERROR_RESOURCES after every fragment.
+    ble_cfg_t ble_cfg;
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag = APP_BLE_CONN_CFG_TAG;
+    ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = HVN_TX_QUEUE_SIZE;
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+    APP_ERROR_CHECK(err_code);
+
     uint32_t const app_ram_start_link = ram_start;
     err_code = sd_ble_enable(&ram_start); // This can change the ram start I guess.
     if (ram_start > app_ram_start_link)
@@ -2173,9 +2644,12 @@ static void bring_up_adver(void)
 {
     if (m_connection_handle  == BLE_CONN_HANDLE_INVALID)  // Should always be invalid
     {
-        emptyQueue(queue);
+        requestEmptyQueue(queue);   // Also called from the button handler; the main loop does the emptying
         // We auto-add a stored msmt when there is no button push
         #if (USE_DK == 0)
+            #if (USES_STORED_DATA >= 1)
+                deleteStoredSpecializationMsmts();  // Only the latest msmt is kept; the log is cleared in the main loop
+            #endif
             numberOfStoredMsmtGroups = 0;
             if (generateAndAddStoredMsmt(getRtcTicks(), getTicks(), numberOfStoredMsmtGroups))
             {
@@ -2231,7 +2705,6 @@ static void receive_new_measurement(uint8_t * p_data)
                     if (generateAndAddStoredMsmt(getRtcTicks(), getTicks(), numberOfStoredMsmtGroups))
                     {
                         numberOfStoredMsmtGroups++;
-                        stored_msmts_same = false;
                     }
                 #endif
             }
@@ -2252,6 +2725,7 @@ static void receive_new_measurement(uint8_t * p_data)
                         deleteStoredSpecializationMsmts();
                     #endif
                     clearSecurityKeys(&keys);
+                    clearRacpResume();
                 }
 
                 break;
@@ -2334,7 +2808,8 @@ static void initializeBluetooth()
 
     memset(cccds, 0, noOfCccds);
     loadKeysFromFlash(&keys, &saveDataBuffer, &saveDataLength, cccds, &noOfCccds);
-    stored_msmts_same = true;
+    loadStoredMsmtsFromFlash();
+    resumeStoredTimelines();
     NRF_LOG_DEBUG("Number of saved stored measurements in flash %u", numberOfStoredMsmtGroups);
     memcpy(cccdSet, cccds, noOfCccds);  // destination, source, length
     
@@ -2350,7 +2825,6 @@ static void initializeBluetooth()
         // This also provides the callback method to receive events.
     ble_stack_init();
     sd_mutex_new(&p_mutex);
-    sd_mutex_new(&q_mutex);
 
     // Set device address
     ble_gap_addr_t addrStruct;
@@ -2688,10 +3162,31 @@ static void main_loop(void)
     uint8_t enabled;
     uint16_t len;
     ret_code_t result;
+    bool encoded;
     for (;;)
     {
-        send_data();        // when flag is set, a set of data is indicated or notified depending upon setup. 
+        // Encode before sending and sleeping. The event handlers below queue the next stored record (on the
+        // HVC of an indicated one, for example), and nothing else may wake the application to encode it.
+        // A pipelined record handed off in send_data() queues the next one at once, so keep encoding and
+        // sending while that happens: the SoftDevice queue is filled with as many records as it takes
+        // before the application sleeps instead of one record per wakeup.
+        do
+        {
+            encoded = false;
+            if (!isEmpty(queue))
+            {
+                void *data = front(queue);
+                if (data != NULL && encodeMsmtData(data))
+                {
+                    NRF_LOG_DEBUG("Measurement taken from queue");
+                    send_flag = true;
+                    dequeue(queue);
+                    encoded = true;
+                }
+            }
+            send_data();    // when flag is set, a set of data is indicated or notified depending upon setup. 
                                 // Flag is reset in method
+        } while (encoded && !isEmpty(queue));
         main_wait();            // Contains the sd_app_evt_wait()
     //    if (start_shutdown)
     //    {
@@ -2702,20 +3197,6 @@ static void main_loop(void)
     //            start_shutdown = false;
     //        }
     //    }
-        if (!isEmpty(queue))
-        {
-            void *data = front(queue);
-            if (encodeMsmtData(data))
-            {
-                NRF_LOG_DEBUG("Measurement taken from queue");
-                send_flag = true;
-                if(sd_mutex_acquire(&q_mutex) != NRF_ERROR_SOC_MUTEX_ALREADY_TAKEN)
-                {
-                    dequeue(queue);
-                    sd_mutex_release(&q_mutex);
-                }
-            }
-        }
         if (restartAdv)     // Only called when USE_DK = 0
         {
             restartAdv = false;
@@ -2723,6 +3204,7 @@ static void main_loop(void)
             bsp_board_led_on(MSMT_DATA_LED);
             bring_up_adver();
         }
+        runFlashOperations();   // Next flash erase or write, including appending new stored msmts to the log
         while(true)
         {
             // uint32_t evt_id;
@@ -2770,7 +3252,8 @@ int main(void)
     ret_code_t err_code;
     NRF_LOG_DEBUG("Power on");
     m_adv_handle = 0;
-    queue = initializeQueue(10);
+    // A power of two slots, see initializeQueue(), each holding a live msmt or a stored msmt reference
+    queue = initializeQueue(16, (sizeof(s_MsmtData) > sizeof(s_StoredMsmtReference)) ? sizeof(s_MsmtData) : sizeof(s_StoredMsmtReference));
     if (queue == NULL)
     {
         NRF_LOG_DEBUG("Could not allocate memory for the message queue. Quitting");
@@ -22,28 +22,80 @@ DEALINGS IN THE SOFTWARE.
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include "msmt_queue.h"
 #ifndef _WIN32
+#include "nrf.h"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
+#define QUEUE_BARRIER() __DMB()
 #else
 #define NRF_LOG_DEBUG printf
 #include <windows.h>
 #include <stdio.h>
+#define QUEUE_BARRIER() MemoryBarrier()
 #endif
 
-s_Queue* initializeQueue(int size)
+/*
+ * The queue is a single-producer/single-consumer ring. 'head' is only written by the producer
+ * (enqueue) and 'tail' is only written by the consumer (dequeue, emptyQueue). Both are free running
+ * counters; the number of elements is head - tail. maxsize must be a power of two so the slot can be
+ * taken by masking the counter: a modulo of any other size would jump to the wrong slot when the
+ * counters wrap at 2^32.
+ * The barrier guarantees the slot contents are visible before the index that publishes them,
+ * so the producer and the consumer never need a mutex.
+ *
+ * In this application the live data timer and the stored record path both produce. The timer runs at
+ * APP_TIMER_CONFIG_IRQ_PRIORITY, above the main loop and the SoftDevice event handler, so it is never
+ * preempted by the other producer; the stored record path, run from both of those, enqueues in a critical
+ * region so the timer cannot enter enqueue() half way through one of its calls. The consumer is the main
+ * loop alone. The RACP abort and the advertising start, which run in event handlers, only request that
+ * the queue be emptied; the consumer does it the next time it calls front() or dequeue().
+ *
+ * If elementSize is non-zero the queue is pool backed. A single block of size * elementSize bytes
+ * is allocated here and each slot is a fixed window into it, so enqueue and dequeue never touch the
+ * heap. If elementSize is 0 the legacy behavior is kept and each slot is calloc'ed on enqueue and
+ * freed on dequeue.
+ */
+s_Queue* initializeQueue(int size, unsigned short elementSize)
 {
     s_Queue* queue = NULL;
+    if (size <= 0 || (size & (size - 1)) != 0)
+    {
+        NRF_LOG_DEBUG("Queue size %d is not a power of two", size);
+        return NULL;
+    }
     queue = (s_Queue *)calloc(1, sizeof(s_Queue));
 
     if (queue != NULL)
     {
         queue->msmts = (void**)calloc(1, size * sizeof(void*));
+        if (queue->msmts == NULL)
+        {
+            NRF_LOG_DEBUG("Could not allocate memory for the queue slot pointers");
+            free(queue);
+            return NULL;
+        }
         queue->maxsize = size;
-        queue->front = 0;
-        queue->rear = -1;
-        queue->size = 0;
+        queue->head = 0;
+        queue->tail = 0;
+        queue->elementSize = elementSize;
+        if (elementSize > 0)
+        {
+            queue->pool = (unsigned char*)calloc(1, size * elementSize);
+            if (queue->pool == NULL)
+            {
+                NRF_LOG_DEBUG("Could not allocate memory for the queue pool of %d bytes", size * elementSize);
+                free(queue->msmts);
+                free(queue);
+                return NULL;
+            }
+            int i;
+            for (i = 0; i < size; i++)
+            {
+                queue->msmts[i] = (void*)&queue->pool[i * elementSize];
+            }
+        }
     }
 
     return queue;
@@ -56,7 +108,7 @@ int isFull(s_Queue *queue)
 
 // Utility function to return the size of the queue
 int size(s_Queue* queue) {
-    return queue->size;
+    return (int)(queue->head - queue->tail);
 }
 
 // Utility function to check if the queue is empty or not
@@ -64,91 +116,165 @@ int isEmpty(s_Queue* queue) {
     return !size(queue);
 }
 
+// Discards the elements from the tail up to the given head. Consumer side only.
+static void discardTo(s_Queue* queue, unsigned int head)
+{
+    unsigned int i;
+    for (i = queue->tail; i != head; i++)
+    {
+        int slot = i & (queue->maxsize - 1);
+        if (queue->pool == NULL && queue->msmts[slot] != NULL)
+        {
+            free(queue->msmts[slot]);
+            queue->msmts[slot] = NULL;
+        }
+    }
+    QUEUE_BARRIER();
+    queue->tail = head;
+}
+
+// Carries out a requestEmptyQueue(). Returns true if elements were discarded. Consumer side only.
+static bool applyEmptyRequest(s_Queue* queue)
+{
+    if (!queue->emptyRequested)
+    {
+        return false;
+    }
+    queue->emptyRequested = 0;
+    QUEUE_BARRIER();    // A request made from here on sets the flag again
+    unsigned int head = queue->emptyTo;
+    if ((int)(head - queue->tail) <= 0)
+    {
+        return false;   // Already past it
+    }
+    discardTo(queue, head);
+    return true;
+}
+
 // Utility function to return the front element of the queue
 void* front(s_Queue* queue)
 {
+    applyEmptyRequest(queue);
     if (isEmpty(queue))
     {
         NRF_LOG_DEBUG("Underflow: Program Terminated\r\n");
         return NULL;
 
     }
+    QUEUE_BARRIER();    // Read the slot only after the head that published it
 
-    return queue->msmts[queue->front];
+    return queue->msmts[queue->tail & (queue->maxsize - 1)];
 }
 
-// Utility function to add an element `x` to the queue
+// Utility function to add an element `x` to the queue. Producer side only.
 void enqueue(s_Queue* queue, void* msmt, unsigned short length)
 {
-    if (size(queue) == queue->maxsize)
+    unsigned int head = queue->head;
+    if ((int)(head - queue->tail) >= queue->maxsize)
     {
+        queue->overflowCount++;
         NRF_LOG_DEBUG("Overflow: Program Terminated\r\n");
         return;
     }
-    queue->rear = (queue->rear + 1) % queue->maxsize;    // circular queue
-    if (queue->msmts[queue->rear] == NULL)
+    if (queue->pool != NULL && length > queue->elementSize)
+    {
+        NRF_LOG_DEBUG("Element of %d bytes exceeds the queue pool slot size of %d bytes\r\n", length, queue->elementSize);
+        return;
+    }
+    int rear = head & (queue->maxsize - 1);    // circular queue
+    if (queue->pool != NULL)
     {
-        queue->msmts[queue->rear] = (void*)calloc(1, length);
-        if (queue->msmts[queue->rear] == NULL)
+        queue->allocationsAvoided++;
+    }
+    else if (queue->msmts[rear] == NULL)
+    {
+        queue->msmts[rear] = (void*)calloc(1, length);
+        if (queue->msmts[rear] == NULL)
         {
             //error
             return;
         }
     }
-    memcpy(queue->msmts[queue->rear], msmt, length);
-    queue->size++;
+    memcpy(queue->msmts[rear], msmt, length);
+    queue->bytesCopied = queue->bytesCopied + length;
+    QUEUE_BARRIER();    // Slot contents must be visible before the head moves
+    queue->head = head + 1;
+    if ((int)(head + 1 - queue->tail) > queue->highWaterMark)
+    {
+        queue->highWaterMark = (int)(head + 1 - queue->tail);
+    }
 
-    NRF_LOG_DEBUG("front = %d, rear = %d\r\n", queue->front, queue->rear);
+    NRF_LOG_DEBUG("head = %u, tail = %u\r\n", queue->head, queue->tail);
 }
 
-// Utility function to dequeue the front element
+// Utility function to dequeue the front element. Consumer side only.
 void dequeue(s_Queue* queue)
 {
+    if (applyEmptyRequest(queue))
+    {
+        return;     // The element taken with front() went with the rest
+    }
     if (isEmpty(queue))    // front == rear
     {
         NRF_LOG_DEBUG("Underflow: queue empty");
         return;
     }
 
-    if (queue->msmts[queue->front] != NULL)
+    unsigned int tail = queue->tail;
+    int front = tail & (queue->maxsize - 1);
+    if (queue->pool == NULL && queue->msmts[front] != NULL)
     {
-        free(queue->msmts[queue->front]);
-        queue->msmts[queue->front] = NULL;
+        free(queue->msmts[front]);
+        queue->msmts[front] = NULL;
     }
 
-    queue->front = (queue->front + 1) % queue->maxsize;  // circular queue
-    queue->size--;
+    QUEUE_BARRIER();    // Done with the slot before handing it back to the producer
+    queue->tail = tail + 1;  // circular queue
 
-    NRF_LOG_DEBUG("front = %d, rear = %d\r\n", queue->front, queue->rear);
+    NRF_LOG_DEBUG("head = %u, tail = %u\r\n", queue->head, queue->tail);
 }
 
+// Discards all queued elements. Consumer side only; anything the producer adds afterwards is kept.
 void emptyQueue(s_Queue* queue)
 {
     if (queue != NULL)
     {
         if (queue->msmts != NULL)
         {
-            int i;
-            for (i = 0; i < queue->maxsize; i++)
-            {
-                if (queue->msmts[i] != NULL)
-                {
-                    free(queue->msmts[i]);
-                    queue->msmts[i] = NULL;
-                }
-            }
-            queue->front = 0;
-            queue->rear = -1;
-            queue->size = 0;
+            queue->emptyRequested = 0;  // Covered by what is discarded here
+            QUEUE_BARRIER();
+            discardTo(queue, queue->head);
         }
     }
 }
 
+/*
+ * Has the consumer discard everything queued so far the next time it calls front() or dequeue(). Any
+ * context may call this; anything the producer adds afterwards is kept.
+ */
+void requestEmptyQueue(s_Queue* queue)
+{
+    if (queue != NULL)
+    {
+        queue->emptyTo = queue->head;
+        QUEUE_BARRIER();    // The head to empty to must be visible before the request
+        queue->emptyRequested = 1;
+    }
+}
+
 void cleanUpQueue(s_Queue* queue)
 {
     if (queue != NULL)
     {
         emptyQueue(queue);
+        if (queue->pool != NULL)
+        {
+            free(queue->pool);
+        }
+        if (queue->msmts != NULL)
+        {
+            free(queue->msmts);
+        }
         free(queue);
     }
 }
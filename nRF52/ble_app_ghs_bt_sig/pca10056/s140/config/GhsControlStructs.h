@@ -27,6 +27,10 @@ DEALINGS IN THE SOFTWARE.
 
 #define OPCODE_LENGTH  1                        /**< Length of opcode inside PO Measurement packet. */
 #define HANDLE_LENGTH  2                        /**< Length of handle inside PO Measurement packet. */
+#define L2CAP_HEADER_LENGTH  4                  /**< Length of the L2CAP header in front of each ATT PDU. */
+#define SEGMENT_HEADER_LENGTH  1                /**< Length of the GHS segmentation header in front of each fragment. */
+#define RECORD_NUMBER_LENGTH  4                 /**< Length of the record number in front of the first fragment of stored data. */
+#define SEGMENT_HEADROOM  (SEGMENT_HEADER_LENGTH + RECORD_NUMBER_LENGTH) /**< Bytes reserved in front of a group's data buffer. */
 //#define MAX_CHAR_LEN   (BLE_L2CAP_MTU_MIN - OPCODE_LENGTH - HANDLE_LENGTH)  /**< Maximum size of a transmitted PO Measurement. */
 
 // THese are the RACP Op-Codes
@@ -253,10 +257,24 @@ typedef struct
     unsigned short handle;              // the handle of the characteristic to make the indications/notifications on
     unsigned short current_command;     // the current command being handled
     unsigned short chunk_size;          // maximum length of each indication/notification
+    unsigned short ll_packets_per_chunk;    // link layer packets a full chunk takes on air
     unsigned short number_of_groups;    // how many records to send
+    unsigned short next_group;          // index of the next stored record to send
     unsigned long  recordNumber;        // for stored data
 } s_global_send;
 
+#define RACP_RESUME_MAGIC 0x52534D52UL          // 'RMSR'; the resume cursor is valid
+#define RACP_RESUME_COMMAND_LENGTH 20           // Longest RACP request that can be resumed
+
+// Where the bonded peer's last report stored records request was cut short. Saved with the bonding data.
+typedef struct
+{
+    unsigned long magic;                // RACP_RESUME_MAGIC if lastRecordNumber is valid
+    unsigned long lastRecordNumber;     // last record all of whose fragments the peer acknowledged
+    unsigned short commandLength;
+    unsigned char command[RACP_RESUME_COMMAND_LENGTH];  // the request being answered
+} s_RacpResume;
+
 typedef struct
 {
     unsigned long attrId;
@@ -524,10 +542,73 @@ typedef struct
     unsigned short ref_index;           // Location of the reference array
     unsigned short duration_index;      // Location of the duration
     unsigned short currentGhsMsmtCount; // The number of measurements currently in the group (this is used while creating the template and popping/pushing msmts in the group)
-    s_GhsMsmtIndex **sGhsMsmtIndex;     // the array of support info for each measurement entry
-    unsigned char *data;                // the byte array to be sent to the PHG
+    s_GhsMsmtIndex *sGhsMsmtIndex;      // the array of support info for each measurement entry. It is allocated with the struct
+    unsigned char *data;                // the byte array to be sent to the PHG. SEGMENT_HEADROOM bytes in front of it are reserved
+    unsigned char *altData;             // If double buffered, the other byte array. It holds the group being sent while 'data' is updated
+    unsigned short bufferLength;        // allocated length of data (and altData); dataLength may be less when a msmt is dropped
+    bool isStatic;                      // true if the struct and its byte arrays are an s_MsmtGroupDataStorage, not allocated
 }s_MsmtGroupData;                       // Support information for using the measurement group data buffer for this measurement group
 
+// A measurement group data array created ahead of time and kept in ROM. The fields are those of s_MsmtGroupData.
+typedef struct
+{
+    unsigned short dataLength;
+    unsigned short timestamp_index;
+    unsigned short no_of_msmts_index;
+    unsigned short numberOfSuppTypes;
+    unsigned short suppTypes_index;
+    unsigned short numberRefs;
+    unsigned short ref_index;
+    unsigned short duration_index;
+    unsigned short numberOfGhsMsmts;
+    const s_GhsMsmtIndex *sGhsMsmtIndex;  // numberOfGhsMsmts entries
+    const unsigned char *data;            // dataLength bytes
+}s_MsmtGroupTemplate;
+
+// Static RAM for a measurement group data array made from a template, so that no heap is used. Declare it with
+// MSMT_GROUP_DATA_STORAGE(), which sizes it from the template's arrays.
+typedef struct
+{
+    s_MsmtGroupData *msmtGroupData;
+    s_GhsMsmtIndex *sGhsMsmtIndex;        // numberOfGhsMsmts entries
+    unsigned char *buffers;               // numberOfBuffers byte arrays of SEGMENT_HEADROOM + bufferLength bytes each
+    unsigned short numberOfGhsMsmts;
+    unsigned short bufferLength;
+    unsigned char numberOfBuffers;        // 2 if double buffered
+}s_MsmtGroupDataStorage;
+
+/**
+ * A field map lets updateGroup() fill a whole measurement group from one sensor record instead of one update call per
+ * value. Each s_GroupField says where a value is in the record, where it goes in the data array, and how to encode it.
+ * The map is made once, after the data array is created, with the addGroupField...() methods.
+ */
+#define GROUP_FIELD_FLOAT 1         // unsigned mantissa in the record written as a FLOAT with the field's exponent
+#define GROUP_FIELD_SFLOAT 2        // unsigned mantissa in the record written as an SFLOAT with the field's exponent
+#define GROUP_FIELD_BITS 3          // value of a BITS msmt
+#define GROUP_FIELD_BITS_OR 4       // OR'ed into the value of a BITS msmt written by an earlier field
+#define GROUP_FIELD_MSMT_ID 5       // msmt_id plus the msmt index in recordOffset; a msmt id or a reference to one
+#define GROUP_FIELD_EPOCH 6         // the epoch of the time stamp
+#define GROUP_FIELD_TIMELINE 7      // the on current timeline flag of the time stamp
+#define GROUP_FIELD_SIGNED_FLOAT 8  // as GROUP_FIELD_FLOAT but the mantissa in the record is signed and is sign extended
+#define GROUP_FIELD_SIGNED_SFLOAT 9 // as GROUP_FIELD_SFLOAT but the mantissa in the record is signed and is sign extended
+#define MAX_GROUP_FIELDS 16
+
+typedef struct
+{
+    unsigned short dataIndex;       // index of the field in the s_MsmtGroupData data array
+    unsigned short recordOffset;    // offsetof() the value in the sensor record. For GROUP_FIELD_MSMT_ID the msmt index
+    unsigned char recordWidth;      // bytes of the value in the sensor record: 1, 2, 4 or 8
+    unsigned char dataWidth;        // bytes of the field in the data array
+    unsigned char kind;             // one of the GROUP_FIELD_ values
+    signed char exponent;           // for the FLOAT and SFLOAT kinds
+}s_GroupField;
+
+typedef struct
+{
+    unsigned short numberOfFields;
+    s_GroupField fields[MAX_GROUP_FIELDS];
+}s_GroupFieldMap;
+
 #define USES_NUMERIC 1
 #define USES_COMPOUND 1
 #define USES_CODED 1
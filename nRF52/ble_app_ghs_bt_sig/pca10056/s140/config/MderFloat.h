@@ -85,6 +85,18 @@ typedef struct sMderFloat_tag
 
 } s_MderFloat;
 
+/*
+ * The raw FLOAT and SFLOAT of a number given as integers, the same result as createIeeeFloatFromMderFloat() and
+ * createIeeeSFloatFromMderFloat() with MDER_NUMBER. When the exponent is a constant, as it is for most sensors, the
+ * compiler folds the exponent bits to a constant; the mantissa is still masked at run time and is not range checked.
+ * A negative mantissa must be passed as a signed type so the mask leaves its two's complement. A negative value of a
+ * narrower type that was zero extended, e.g. a short read into an unsigned long, is written as a large positive one.
+ */
+#define MDER_FLOAT_FROM_INTEGERS(exponent, mantissa) \
+    (((((unsigned long)(exponent)) << 24) & 0xFF000000) | (((unsigned long)(mantissa)) & 0x00FFFFFF))
+#define MDER_SFLOAT_FROM_INTEGERS(exponent, mantissa) \
+    ((unsigned short)(((((unsigned short)(exponent)) << 12) & 0xF000) | (((unsigned short)(mantissa)) & 0x0FFF)))
+
 s_MderFloat* copyMderFloat(s_MderFloat* source, s_MderFloat* destination);
 
 /**
@@ -155,6 +167,22 @@ bool createMderFloatFromFloat(s_MderFloat *smderFloat, unsigned long ieeeMder);
 bool createIeeeSFloatFromMderFloat(s_MderFloat* smderFloat, unsigned short *rawIeeeSfloat);
 bool createIeeeFloatFromMderFloat(s_MderFloat* smderFloat, unsigned long *rawIeeeFloat);
 
+/*
+ * Batch versions of the above for arrays of count values. The s_MderFloat fields are split into separate exponent,
+ * mantissa and special value arrays so the loops vectorize. Return false if a pointer is NULL.
+ */
+bool createMderFloatArraysFromSFloats(const unsigned short *ieeeSFloats, short int *exponents, long int *mantissas,
+    enum MderSpecialValue *specialValues, unsigned long count);
+bool createMderFloatArraysFromFloats(const unsigned long *ieeeFloats, short int *exponents, long int *mantissas,
+    enum MderSpecialValue *specialValues, unsigned long count);
+bool createIeeeSFloatsFromMderFloatArrays(const short int *exponents, const long int *mantissas,
+    const enum MderSpecialValue *specialValues, unsigned short *ieeeSFloats, unsigned long count);
+bool createIeeeFloatsFromMderFloatArrays(const short int *exponents, const long int *mantissas,
+    const enum MderSpecialValue *specialValues, unsigned long *ieeeFloats, unsigned long count);
+/* NAN and INFINITY are used for the special values; NRes and reserved are NAN as well */
+bool createDoublesFromSFloats(const unsigned short *ieeeSFloats, double *values, unsigned long count);
+bool createDoublesFromFloats(const unsigned long *ieeeFloats, double *values, unsigned long count);
+
 unsigned long getIeeeFloatFromString(char* floatAsString);
 unsigned long getIeeeSFloatFromString(char* floatAsString);
 bool getMderFloatFromString(s_MderFloat* mderFloat, char* floatAsString);
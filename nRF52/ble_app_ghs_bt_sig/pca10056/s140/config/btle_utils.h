@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #endif
 
 #include "GhsControlStructs.h"
+#include "handleSpecializations.h"
 
 #if (HAS_ABS_TIMESTAMP == 1)
     /**
@@ -120,8 +121,9 @@ ret_code_t createBatteryService(unsigned short int* serviceHandle, unsigned char
  * @param saveDataLength the length of the data obtained from the sd_ble_gatts_sys_attr_get()
  * @param cccdSet a pointer to the list of enabled states of the characteristics
  * @param noOfCccds a pointer to the number of Cccds that can be enabled in the specialization
+ * @return false if the flash queue has no room; nothing is written and the call must be repeated
  */
-void saveKeysToFlash(ble_gap_sec_keyset_t* keys,
+bool saveKeysToFlash(ble_gap_sec_keyset_t* keys,
     unsigned char **saveDataBuffer, unsigned short int *saveDataLength,
     unsigned char* cccdSet, unsigned short* noOfCccds);
 
@@ -137,6 +139,88 @@ void loadKeysFromFlash(ble_gap_sec_keyset_t* keys,
     unsigned char** saveDataBuffer, unsigned short int* saveDataLength, unsigned char* cccdSet,
     unsigned short *noOfCccds);
 
+/**
+ * Method hands a new stored measurement to the stored measurement log. It is kept in RAM until the
+ * main loop has appended it to the log; see runFlashOperations(). It may be called from interrupt context.
+ * @param msmt the measurement; it is packed and need not stay in place
+ * @param ticks the RTC ticks when the measurement was stored, kept with the record for the time line check
+ * @return false if too many measurements are waiting to be appended; the measurement is not stored
+ */
+bool addStoredMsmt(s_MsmtData *msmt, unsigned long long ticks);
+
+/**
+ * Method unpacks a stored measurement, with any pending fixups applied
+ * @param index the position of the measurement, 0 being the oldest
+ * @param msmt the measurement
+ * @return false if there is no stored measurement at that index
+ */
+bool getStoredMsmt(unsigned short index, s_MsmtData *msmt);
+
+/**
+ * Method returns the generation of the stored measurement log. It changes whenever measurements leave the
+ * log, which moves the index of the measurements after them.
+ */
+unsigned long getStoredMsmtGeneration(void);
+
+/**
+ * Method unpacks the stored measurement a queued reference points to, with any pending fixups applied
+ * @param reference the index of the measurement and the log generation when it was queued
+ * @param msmt the measurement
+ * @return false if measurements left the log since the reference was queued or there is no measurement
+ *         at that index
+ */
+bool getReferencedStoredMsmt(s_StoredMsmtReference *reference, s_MsmtData *msmt);
+
+/**
+ * Method removes all stored measurements. They are gone for getStoredMsmt() at once; the log pages
+ * are erased later by the main loop.
+ */
+void clearStoredMsmts(void);
+
+/**
+ * Method removes a run of stored measurements. They are gone for getStoredMsmt() at once; their slots
+ * in the log are tombstoned later by the main loop and the pages they free are reclaimed then.
+ * @param start the index of the first measurement to remove, 0 being the oldest
+ * @param count the number of measurements to remove
+ * @return false if the log is busy rewriting or has too many deletes waiting; nothing is removed
+ */
+bool deleteStoredMsmts(unsigned short start, unsigned short count);
+
+/**
+ * Method applies a fixup to all stored measurements. Those in flash are rewritten by the main loop
+ * in the background and the fixup is applied when they are read in the meantime. storedMsmtFixupDone()
+ * is called once they are all rewritten.
+ * @param fixup the change to make
+ * @return true if records in flash wait for the fixup, false if it is already done
+ */
+bool fixupStoredMsmts(s_StoredMsmtFixup *fixup);
+
+/**
+ * Method is given the SoftDevice system events. It picks out the results of the flash operations.
+ * It may be called from interrupt context.
+ * @param sys_evt the system event
+ */
+void flashSysEventHandler(uint32_t sys_evt);
+
+/**
+ * Method starts the next queued flash operation once the previous one has completed and, when the
+ * flash is idle, queues the next step of the stored measurement log. Call it from the main loop; it
+ * returns at once.
+ */
+void runFlashOperations(void);
+
+/**
+ * Method checks whether all queued flash operations are done
+ * @return true if nothing is queued or in progress
+ */
+bool isFlashIdle(void);
+
+/**
+ * Method rebuilds the RAM index of the stored measurement log in flash. It sets numberOfStoredMsmtGroups,
+ * the next record number and raises latestTimeStamp to that of the latest record.
+ */
+void loadStoredMsmtsFromFlash(void);
+
 void allocateMemoryForSecurityKeys(ble_gap_sec_keyset_t* keys);
 void clearSecurityKeys(ble_gap_sec_keyset_t* keys);
 void freeMemoryForSecurityKeys(ble_gap_sec_keyset_t* keys);
@@ -487,10 +487,12 @@ bool updateDataRestoreLastMsmt(s_MsmtGroupData** msmtGroupDataPtr);
 #if(USES_NUMERIC == 1)
     bool createNumericMsmt(s_GhsMsmt **ghsMsmt, unsigned long type, bool isSfloat, unsigned short units, bool hasMsmtId);
     bool updateDataNumeric(s_MsmtGroupData** msmtGroupData, short msmtIndex, s_MderFloat* value, unsigned short msmt_id);
+    // For values that are always numbers: pass the raw float, e.g. MDER_FLOAT_FROM_INTEGERS(-1, conc), and it is written
+    // straight into the data array. Returns false if the msmt is not a numeric of that float width.
+    bool updateDataNumericFloat(s_MsmtGroupData** msmtGroupData, short msmtIndex, unsigned long ieeeFloat, unsigned long msmt_id);
+    bool updateDataNumericSFloat(s_MsmtGroupData** msmtGroupData, short msmtIndex, unsigned short ieeeSFloat, unsigned long msmt_id);
 #endif
 #if(USES_COMPOUND == 1)
-    //bool createCompoundNumericMsmt(s_GhsMsmt** ghsMsmt, unsigned long type, bool isSfloat, unsigned short units, 
-    //        unsigned short numberOfComponents, s_Compound *compounds, bool hasMsmtId);  // Classic compound
     bool createComplexCompoundNumericMsmt(s_GhsMsmt** ghsMsmt, unsigned long type, bool isSfloat, 
             unsigned short numberOfComponents, s_Compound *compounds, bool hasMsmtId);  // Complex compound
     bool updateDataCompound(s_MsmtGroupData** msmtGroupData, short msmtIndex, s_MderFloat* value, unsigned short msmt_id);
@@ -531,4 +533,138 @@ bool setGhsMsmtDuration(s_GhsMsmt **ghsMsmt);
 
 bool createMsmtGroupDataArray(s_MsmtGroupData** msmtGroupData, s_MsmtGroup *msmtGroup, s_GhsTime *sGhsTime);
 
+/**
+ * Same as createMsmtGroupDataArray() but also allocates a second byte array so the group can be updated while the
+ * previous update is still being sent. The update methods always write to 'data'; swapMsmtGroupDataBuffers()
+ * hands the filled array over to the sender.
+ * @param msmtGroupData pointer to the s_MsmtGroupData pointer to populate
+ * @param msmtGroup the measurement group to encode
+ * @param sGhsTime the time properties of the PHD. Can be NULL if there are no time stamps
+ * @return true if both byte arrays were created
+ */
+bool createDoubleBufferedMsmtGroupDataArray(s_MsmtGroupData** msmtGroupData, s_MsmtGroup *msmtGroup, s_GhsTime *sGhsTime);
+
+/**
+ * Swaps the two byte arrays of a double buffered group. After the swap 'altData' is the array that was just filled
+ * and is to be sent, and 'data' is a copy of it that the update methods may write to.
+ * @param msmtGroupData pointer to the s_MsmtGroupData pointer to swap
+ * @return false if the group is not double buffered
+ */
+bool swapMsmtGroupDataBuffers(s_MsmtGroupData** msmtGroupData);
+
+/*
+ * Declares <name>GroupStorage, the static RAM for the measurement group data array made from the template
+ * <name>GroupTemplate of msmtGroupTemplates.h. The msmt index array and the bufferCount byte arrays (1, or 2 when double
+ * buffered) are sized from the template's arrays at compile time.
+ */
+#define MSMT_GROUP_DATA_STORAGE(name, bufferCount) \
+    static s_MsmtGroupData name##GroupDataStorage; \
+    static s_GhsMsmtIndex name##GroupIndexStorage[sizeof(name##GroupTemplateIndex) / sizeof(s_GhsMsmtIndex)]; \
+    static unsigned char name##GroupBufferStorage[(bufferCount) * (SEGMENT_HEADROOM + sizeof(name##GroupTemplateData))]; \
+    static s_MsmtGroupDataStorage name##GroupStorage = \
+    { \
+        .msmtGroupData = &name##GroupDataStorage, .sGhsMsmtIndex = name##GroupIndexStorage, \
+        .buffers = name##GroupBufferStorage, .numberOfGhsMsmts = sizeof(name##GroupTemplateIndex) / sizeof(s_GhsMsmtIndex), \
+        .bufferLength = sizeof(name##GroupTemplateData), .numberOfBuffers = (bufferCount) \
+    }
+
+/**
+ * Creates the measurement group data array from a template in ROM instead of from an s_MsmtGroup. The template is
+ * copied into the static storage given; none of the configuration structures are needed and nothing is allocated.
+ * The time stamp flags, offset and time sync are taken from sGhsTime as createMsmtGroupDataArray() does.
+ * @param msmtGroupData pointer to the s_MsmtGroupData pointer to populate. It is set to storage->msmtGroupData
+ * @param msmtGroupTemplate the template, as logged by logMsmtGroupTemplate()
+ * @param sGhsTime the time properties of the PHD. Can be NULL if there are no time stamps
+ * @param storage the RAM to use, declared with MSMT_GROUP_DATA_STORAGE(). With two buffers the group is double
+ *        buffered as createDoubleBufferedMsmtGroupDataArray() makes it
+ * @return false if the storage is smaller than the template
+ */
+bool createMsmtGroupDataArrayFromTemplate(s_MsmtGroupData** msmtGroupData, const s_MsmtGroupTemplate *msmtGroupTemplate,
+    s_GhsTime *sGhsTime, s_MsmtGroupDataStorage *storage);
+
+/**
+ * Finds the index of a measurement in a group by its MDC type, as read from the data array. It gives a group created
+ * from a template the same msmt indices addGhsMsmtToGroup() returned when the template was logged, without hard
+ * coding them.
+ * @param msmtGroupData the measurement group data array
+ * @param type the MDC code of the measurement type
+ * @return the msmt index or -1 if no msmt in the group has that type. The first msmt of the type is returned
+ */
+short getMsmtIndexOfType(s_MsmtGroupData* msmtGroupData, unsigned long type);
+
+/**
+ * Logs a measurement group data array as the C source of an s_MsmtGroupTemplate so it can be pasted into the
+ * application and kept in ROM. Call it after the data array is created and the values that never change, like
+ * supplemental types, are filled in.
+ * @param name prefix of the names of the template and its arrays
+ * @param msmtGroupData the measurement group data array
+ */
+void logMsmtGroupTemplate(char *name, s_MsmtGroupData* msmtGroupData);
+
+/**
+ * Adds a numeric value, or one component of a complex compound, to a field map. The msmt id, if the msmt has one,
+ * is added with the first value. SFLOAT or FLOAT is taken from the msmt.
+ * The record value is read as recordWidth bytes and zero extended unless isSigned is set, so a signed record field
+ * must be added with isSigned true or a negative mantissa is sent as a large positive one.
+ * @param fieldMap the field map to add to. It starts zeroed
+ * @param msmtGroupData the measurement group data array the map is for
+ * @param msmtIndex the index of the msmt as returned by addGhsMsmtToGroup()
+ * @param component the compound component, 0 for a simple numeric
+ * @param recordOffset offsetof() the mantissa in the sensor record
+ * @param recordWidth sizeof() the mantissa in the sensor record
+ * @param isSigned true if the mantissa in the sensor record is a signed type
+ * @param exponent the exponent written with every value
+ * @return false if the msmt is not a numeric or the map is full
+ */
+bool addGroupFieldNumeric(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, short msmtIndex, unsigned char component,
+    unsigned short recordOffset, unsigned char recordWidth, bool isSigned, signed char exponent);
+
+/**
+ * Adds the value of a BITS msmt to a field map. When more than one record value is added for the same msmt, the
+ * values are OR'ed together.
+ * @param fieldMap the field map to add to
+ * @param msmtGroupData the measurement group data array the map is for
+ * @param msmtIndex the index of the BITS msmt
+ * @param recordOffset offsetof() the bits in the sensor record
+ * @param recordWidth sizeof() the bits in the sensor record
+ * @return false if the msmt is not a BITS or the map is full
+ */
+bool addGroupFieldBits(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, short msmtIndex,
+    unsigned short recordOffset, unsigned char recordWidth);
+
+/**
+ * Adds a reference to another msmt in the group to a field map. It is filled with the msmt id that msmt gets.
+ * @param fieldMap the field map to add to
+ * @param msmtGroupData the measurement group data array the map is for
+ * @param msmtIndex the index of the msmt holding the reference
+ * @param ref_index the index of the reference as in updateDataGhsMsmtRefs()
+ * @param refMsmtIndex the index of the msmt referred to
+ * @return false if there is no such reference or the map is full
+ */
+bool addGroupFieldRef(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, short msmtIndex, unsigned short ref_index,
+    short refMsmtIndex);
+
+/**
+ * Adds the epoch and the on current timeline flag of the group time stamp to a field map.
+ * @param fieldMap the field map to add to
+ * @param msmtGroupData the measurement group data array the map is for
+ * @param epochOffset offsetof() the unsigned long long epoch in the sensor record
+ * @param timelineOffset offsetof() the unsigned char timeline flag in the sensor record
+ * @return false if the group has no time stamp or the map is full
+ */
+bool addGroupFieldTimeStamp(s_GroupFieldMap *fieldMap, s_MsmtGroupData* msmtGroupData, unsigned short epochOffset,
+    unsigned short timelineOffset);
+
+/**
+ * Fills every field in the map from one sensor record. It replaces the updateData...() and updateTimeStamp...()
+ * calls for the values in the map. The msmts of the group get msmt ids in the order they are in the group. Fields
+ * of a msmt removed by updateDataDropLastMsmt() are skipped.
+ * @param msmtGroupData pointer to the s_MsmtGroupData pointer to update
+ * @param fieldMap the field map made for this group
+ * @param record the sensor record
+ * @param msmt_id the msmt id of the first msmt. It is advanced by the number of msmts sent
+ * @return false if an input is NULL
+ */
+bool updateGroup(s_MsmtGroupData** msmtGroupData, const s_GroupFieldMap *fieldMap, const void *record, unsigned long *msmt_id);
+
 #endif  //CONFIG_GHS_ENCODER_H__
@@ -34,12 +34,36 @@ DEALINGS IN THE SOFTWARE.
 #define SCALE 0
 #define THERMOMETER 0
 
-#define NUMBER_OF_STORED_MSMTS 30
+// A msmt stored when the log already holds NUMBER_OF_STORED_MSMTS replaces the oldest one
+#if defined(NRF52811_XXAA) || defined(NRF52810_XXAA)
+#define NUMBER_OF_STORED_MSMTS 100  // 192 kB of flash and 24 kB of RAM; at most 3 log pages (12 kB) for any specialization
+#define STORED_LOG_RESERVED_PAGES 3
+#else
+#define NUMBER_OF_STORED_MSMTS 2000 // Stored msmts are kept packed in flash (btle_utils.c) with a 2-byte index entry each in RAM.
+                                    // Flash cost per record and the flash taken for 2000 records; the same for the DK
+                                    // (PCA10056) and the dongle (PCA10059) as both are nRF52840s with 4 kB pages:
+                                    //     BP_CUFF, PULSE_OX   32 bytes, 127 per page, 17 pages (68 kB)
+                                    //     GLUCOSE             60 bytes,  68 per page, 31 pages (124 kB)
+                                    //     SCALE, THERMOMETER  28 bytes, 145 per page, 15 pages (60 kB)
+                                    // The log sits just below the bonding data page (0xDE000), so on the dongle it stays
+                                    // clear of the bootloader. The numbers are logged at start up.
+#define STORED_LOG_RESERVED_PAGES 31    // Pages kept free for the log below the bonding data page: FLASH_SIZE in the
+                                        // project files ends the application at 0xBF000. Raising NUMBER_OF_STORED_MSMTS
+                                        // past what fits fails the build; lower FLASH_SIZE with this to make room.
+#endif
 #define SUPPORT_PAIRING 1  // 1: requires pairing/bonding 0: no pairing or bonding
 #define USES_STORED_DATA 0 // 0 = no stored data of any type
                            // 1 = treat as persistently stored data (RACP)
                            // 2 = TODO: use as temporarily stored data
+#define PIPELINE_STORED_DATA 1  // 1 = queue the next RACP record as soon as the SoftDevice has taken every fragment of the
+                                // current one so records go out back to back; 0 = wait for the TX complete of each record
 #define USES_LIVE_DATA 1
+#define USES_MSMT_GROUP_TEMPLATES 1 // 1 = the msmt group data arrays are copied from templates in ROM at start up
+                                    // 0 = they are built at start up
+#define LOG_MSMT_GROUP_TEMPLATES 0  // 1 = with USES_MSMT_GROUP_TEMPLATES 0, log the built groups as the C source of the
+                                    //     templates in msmtGroupTemplates.h. Use it to regenerate them after changing a group
+#define HVN_TX_QUEUE_SIZE 8     // Notifications the SoftDevice can hold per connection before sd_ble_gatts_hvx() returns
+                                // NRF_ERROR_RESOURCES. The SoftDevice default is 1. Larger values take more SoftDevice RAM
 
 #define USE_DK 1        // Set NRF_LOG_ENABLED to 0 when DK is 0. The idea is either DK or nRF52840 dongle
                         // Board in preprocessor needs to be changed from BOARD_PCA10056 (DK) to BOARD_PCA10059 (dongle)
@@ -49,8 +73,8 @@ extern s_TimeInfo *sTimeInfo;
 extern s_TimeInfoData *sTimeInfoData;
 extern s_SystemInfoData *systemInfoData;
 extern unsigned short numberOfStoredMsmtGroups;
-extern bool stored_msmts_same;
 extern unsigned long long latestTimeStamp;
+extern s_RacpResume racpResume;
 extern unsigned long long epoch;
 extern unsigned long long factor;
 extern unsigned char security_char[];
@@ -62,10 +86,11 @@ extern unsigned long msmt_id;
 
 typedef struct
 {
+    bool isStoredData;                     // First so that it is also the first member of s_StoredMsmtReference
     bool hasTimeStamp;
     s_GhsTime sGhsTime;
     unsigned long recordNumber;            // For stored data only
-    bool isStoredData;
+    unsigned char timeline;                // For stored data only: the storedTimelines entry of the time stamp
 }s_MsmtCommon;
 
 #if (BP_CUFF == 1)  // Define little endian
@@ -105,6 +130,7 @@ typedef struct
         unsigned short status_pulse_over_limit;
         unsigned short status_improper_position;
     }s_MsmtData;
+    #define STORED_MSMT_PACKED_SIZE 22          // Common part plus four values and one byte of status bits
 #endif
 #if (PULSE_OX == 1)
     #define LIVE_COUNT_MAX 32
@@ -116,6 +142,7 @@ typedef struct
         unsigned short pulseRate;
         unsigned short pulseQuality;
     }s_MsmtData;
+    #define STORED_MSMT_PACKED_SIZE 20
 #endif
 #if (GLUCOSE == 1)
     typedef struct
@@ -133,6 +160,7 @@ typedef struct
         unsigned short exer;    // percent
         unsigned short duration;   // seconds
     }s_MsmtData;
+    #define STORED_MSMT_PACKED_SIZE 47
 #endif
 #if (HEART_RATE == 1)
     #define LIVE_COUNT_MAX 2
@@ -220,6 +248,7 @@ typedef struct
         s_MsmtCommon common;
         unsigned short mass;        // Weight * 100
     }s_MsmtData;
+    #define STORED_MSMT_PACKED_SIZE 15
 #endif
 #if (THERMOMETER == 1)
     #define LIVE_COUNT_MAX 8
@@ -229,19 +258,72 @@ typedef struct
         unsigned short temp;  // Body Temperature * 100
         unsigned short ambient;  // Room Temperature * 100
     }s_MsmtData;
+    #define STORED_MSMT_PACKED_SIZE 17
 #endif
 
+#define STORED_TIMELINES 8                 // Timelines stored msmts can be on; a new one starts when the clock restarts
+#define STORED_TIMELINE_ID_MASK 0x07       // Bits of the packed time flags holding the timeline of a stored msmt
+#define STORED_TIMELINE_RETIRED 0          // Takes the msmts of the oldest timeline when the table fills. Its base is 0
+#define STORED_TIMELINE_SYNC_NONE 0xFF     // Timeline time sync before its first set time: msmts keep their own
+#define STORED_TIMELINE_FREE 0
+#define STORED_TIMELINE_LIVE 1
+#define STORED_TIMELINE_RETIRING 2         // Its msmts are being moved to STORED_TIMELINE_RETIRED
+#define STORED_TIMELINES_MAGIC 0x4C544D53UL    // 'SMTL'
+
+typedef struct
+{
+    long long base;                 // Added to the epochs of its msmts; set time moves it
+    unsigned long firstRecord;      // Record number of its first msmt. Its msmts follow those of older timelines
+    unsigned char timeSync;         // Time sync given by its last set time or STORED_TIMELINE_SYNC_NONE
+    unsigned char state;
+} s_StoredTimeline;
+
+// Saved with the bonding data
+typedef struct
+{
+    unsigned long magic;
+    unsigned char current;          // Timeline new msmts go on
+    s_StoredTimeline timeline[STORED_TIMELINES];
+} s_StoredTimelines;
+
+extern s_StoredTimelines storedTimelines;
+extern bool storedTimelinesChanged;
+
+// A change to stored msmts already in flash, made once for all of them and applied whenever one is read
+typedef struct
+{
+    bool active;
+    unsigned char retire;           // Bit per timeline whose msmts move to STORED_TIMELINE_RETIRED
+} s_StoredMsmtFixup;
+
+// What is queued for a stored msmt in place of a copy of it. It is unpacked from the log when it is encoded;
+// that the queued item is a reference is told by isStoredData, which is at the start of s_MsmtData as well.
+typedef struct
+{
+    bool isStoredData;              // Always true
+    unsigned short index;           // getStoredMsmt() index of the msmt
+    unsigned long generation;       // getStoredMsmtGeneration() when it was queued
+} s_StoredMsmtReference;
+
 unsigned char *getBtAddress(void);
 void configureSpecializations(void);
 bool generateAndAddStoredMsmt(unsigned long long timeStampMsmt, unsigned long timeStamp, unsigned short numberOfStoredMsmtGroups);
 void handleSpecializationsOnSetTime(unsigned short numberOfStoredMsmtGroups, long long diff, unsigned short timeSync);
 void sendStoredSpecializationMsmts(unsigned short stored_count);
 void deleteStoredSpecializationMsmts(void);
-unsigned short getNumberOfStoredRecords(unsigned char* cmd, unsigned short len);
-long getStartIndexInStoredRecords(unsigned char* cmd, unsigned short len);
+unsigned short findStoredRecords(unsigned char* cmd, unsigned short len, unsigned short *start);
+unsigned short findStoredRecordAfter(unsigned long recordNumber);
 bool encodeSpecializationMsmts(s_MsmtData *msmt);
 void generateLiveDataForSpecializations(unsigned long live_data_count, unsigned long long timeStampMsmt, unsigned long timeStamp);
 void setNotOnCurrentTimeline();
+void resumeStoredTimelines(void);
+void packStoredMsmt(s_MsmtData *msmt, unsigned char *buf);
+void unpackStoredMsmt(unsigned char *buf, s_MsmtData *msmt);
+void applyStoredMsmtFixup(s_MsmtData *msmt, s_StoredMsmtFixup *fixup);
+void composeStoredMsmtFixup(s_StoredMsmtFixup *fixup, s_StoredMsmtFixup *then);
+void storedMsmtFixupDone(s_StoredMsmtFixup *fixup);
+void resolveStoredMsmtTime(s_MsmtData *msmt);
+void baseStoredMsmtTime(s_MsmtData *msmt);
 void cleanUpSpecializations(void);
 void reset_specializations(void);
 
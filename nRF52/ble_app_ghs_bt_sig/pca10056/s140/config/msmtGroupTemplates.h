@@ -0,0 +1,210 @@
+/*
+Copyright (c) 2020 - 2024, Brian Reinhold
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the Software), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies
+or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MSMT_GROUP_TEMPLATES_H__
+#define MSMT_GROUP_TEMPLATES_H__
+
+#include "GhsControlStructs.h"
+#include "handleSpecializations.h"
+
+/**
+ * The measurement group data arrays of each specialization, kept in ROM. configureSpecializations() copies them into RAM
+ * with createMsmtGroupDataArrayFromTemplate() when USES_MSMT_GROUP_TEMPLATES is 1.
+ *
+ * These are the output of logMsmtGroupTemplate(). To regenerate them after changing a group, set USES_MSMT_GROUP_TEMPLATES
+ * to 0 and LOG_MSMT_GROUP_TEMPLATES to 1, run the device, and paste the logged source here. They were logged with
+ * USES_TIMESTAMP 1, millisecond epoch time and the group set up in configureSpecializations(). configureSpecializations()
+ * looks the msmt indices up by MDC type with getMsmtIndexOfType(), so a change in the order of the msmts is picked up.
+ * 'make check' in host/ builds every group the long way and fails if it no longer matches its template here.
+ */
+#if (USES_MSMT_GROUP_TEMPLATES == 1 && USES_TIMESTAMP != 1)
+    #error "The msmt group templates were logged with USES_TIMESTAMP 1. Regenerate them with USES_MSMT_GROUP_TEMPLATES 0"
+#endif
+
+#if (BP_CUFF == 1)
+static const unsigned char bpGroupTemplateData[111] =
+{
+    0xFF, 0x6C, 0x00, 0x02, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x03, 0x07,
+    0x31, 0x00, 0x51, 0x00, 0x04, 0x4A, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xF4, 0x06, 0x07,
+    0x00, 0x03, 0x05, 0x4A, 0x02, 0x00, 0x01, 0x20, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x06, 0x4A, 0x02,
+    0x00, 0x01, 0x20, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x07, 0x4A, 0x02, 0x00, 0x01, 0x20, 0x0F, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x10, 0x00, 0x11, 0x00, 0x2A, 0x48, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xA0, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x06, 0x16, 0x00, 0x81, 0x00, 0xF0, 0x55, 0x80, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex bpGroupTemplateIndex[3] =
+{
+    { .msmtValueType = 0x0007, .msmt_length = 52, .id_index = 24, .numberOfCmpds = 3, .numberOfBytes = 0, .value_index = 41, .isSfloat = false, .numberOfSuppTypes = 1, .suppTypes_index = 29, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 19, .id_index = 76, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 82, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0006, .msmt_length = 25, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 2, .value_index = 105, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 2, .ref_index = 96, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate bpGroupTemplate =
+{
+    .dataLength = 111, .timestamp_index = 5, .no_of_msmts_index = 14,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 3, .sGhsMsmtIndex = bpGroupTemplateIndex, .data = bpGroupTemplateData
+};
+#endif
+
+#if (PULSE_OX == 1)
+static const unsigned char spotGroupTemplateData[65] =
+{
+    0xFF, 0x3E, 0x00, 0x42, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x01, 0x3C,
+    0x4C, 0x02, 0x00, 0x03, 0x01, 0x0C, 0x00, 0x01, 0x00, 0xB8, 0x4B, 0x02, 0x00, 0x20, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x1A, 0x48, 0x02, 0x00, 0xA0, 0x0A, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x30, 0x4B, 0x02, 0x00, 0x20, 0x02, 0x00, 0x00, 0x00,
+    0x00,
+};
+static const s_GhsMsmtIndex spotGroupTemplateIndex[3] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 31, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 46, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 61, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate spotGroupTemplate =
+{
+    .dataLength = 65, .timestamp_index = 5, .no_of_msmts_index = 19,
+    .numberOfSuppTypes = 1, .suppTypes_index = 15, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 3, .sGhsMsmtIndex = spotGroupTemplateIndex, .data = spotGroupTemplateData
+};
+
+static const unsigned char contGroupTemplateData[51] =
+{
+    0xFF, 0x30, 0x00, 0x00, 0x00, 0x03, 0x01, 0x0C, 0x00, 0x01, 0x00, 0xB8, 0x4B, 0x02, 0x00, 0x20,
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x1A, 0x48, 0x02, 0x00, 0xA0, 0x0A,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x30, 0x4B, 0x02, 0x00, 0x20, 0x02, 0x00,
+    0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex contGroupTemplateIndex[3] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 17, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 32, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 47, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate contGroupTemplate =
+{
+    .dataLength = 51, .timestamp_index = 0, .no_of_msmts_index = 5,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 3, .sGhsMsmtIndex = contGroupTemplateIndex, .data = contGroupTemplateData
+};
+#endif
+
+#if (GLUCOSE == 1)
+static const unsigned char glucGroupTemplateData[106] =
+{
+    0xFF, 0x67, 0x00, 0x02, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x04, 0x01,
+    0x1D, 0x00, 0x41, 0x00, 0x70, 0x72, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x52, 0x08, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x11, 0x00, 0x41, 0x00, 0x04, 0x72, 0x80, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x60, 0x15, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x11, 0x00, 0x41, 0x00, 0xE4, 0x71, 0x80, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0xC0, 0x06, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00, 0x05, 0x00, 0xE0, 0x71, 0x80, 0x00,
+    0x10, 0x0E, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex glucGroupTemplateIndex[4] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 32, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 43, .isSfloat = false, .numberOfSuppTypes = 4, .suppTypes_index = 25, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 20, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 63, .isSfloat = false, .numberOfSuppTypes = 1, .suppTypes_index = 57, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 20, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 83, .isSfloat = false, .numberOfSuppTypes = 1, .suppTypes_index = 77, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 19, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 102, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 96 },
+};
+static const s_MsmtGroupTemplate glucGroupTemplate =
+{
+    .dataLength = 106, .timestamp_index = 5, .no_of_msmts_index = 14,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 4, .sGhsMsmtIndex = glucGroupTemplateIndex, .data = glucGroupTemplateData
+};
+#endif
+
+#if (HEART_RATE == 1)
+static const unsigned char hrGroupTemplateData[30] =
+{
+    0xFF, 0x1B, 0x00, 0x02, 0x00, 0x01, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x82, 0x41, 0x02, 0x00, 0xA0,
+    0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex hrGroupTemplateIndex[1] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 17, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate hrGroupTemplate =
+{
+    .dataLength = 30, .timestamp_index = 0, .no_of_msmts_index = 5,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 1, .sGhsMsmtIndex = hrGroupTemplateIndex, .data = hrGroupTemplateData
+};
+#endif
+
+#if (SCALE == 1)
+static const unsigned char settingsGroupTemplateData[27] =
+{
+    0xFF, 0x18, 0x00, 0x20, 0x00, 0x02, 0x00, 0x01, 0x01, 0x10, 0x00, 0x11, 0x00, 0x44, 0xE1, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x05, 0x00, 0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex settingsGroupTemplateIndex[1] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 19, .id_index = 17, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 23, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate settingsGroupTemplate =
+{
+    .dataLength = 27, .timestamp_index = 0, .no_of_msmts_index = 7,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 1, .sGhsMsmtIndex = settingsGroupTemplateIndex, .data = settingsGroupTemplateData
+};
+
+static const unsigned char scaleGroupTemplateData[60] =
+{
+    0xFF, 0x39, 0x00, 0x22, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x02, 0x00,
+    0x02, 0x01, 0x10, 0x00, 0x11, 0x00, 0x40, 0xE1, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC3, 0x06,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x15, 0x00, 0x81, 0x00, 0x50, 0xE1, 0x02, 0x00, 0x02, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x07, 0x00, 0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex scaleGroupTemplateIndex[2] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 19, .id_index = 26, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 32, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 24, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 56, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 2, .ref_index = 46, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate scaleGroupTemplate =
+{
+    .dataLength = 60, .timestamp_index = 5, .no_of_msmts_index = 16,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 2, .sGhsMsmtIndex = scaleGroupTemplateIndex, .data = scaleGroupTemplateData
+};
+#endif
+
+#if (THERMOMETER == 1)
+static const unsigned char tempGroupTemplateData[45] =
+{
+    0xFF, 0x2A, 0x00, 0x02, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x02, 0x01,
+    0x0C, 0x00, 0x01, 0x00, 0x0C, 0xE0, 0x02, 0x00, 0x40, 0x11, 0x00, 0x00, 0x00, 0x00, 0x01, 0x0C,
+    0x00, 0x01, 0x00, 0x5C, 0xE0, 0x02, 0x00, 0x40, 0x11, 0x00, 0x00, 0x00, 0x00,
+};
+static const s_GhsMsmtIndex tempGroupTemplateIndex[2] =
+{
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 26, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+    { .msmtValueType = 0x0001, .msmt_length = 15, .id_index = 0, .numberOfCmpds = 1, .numberOfBytes = 0, .value_index = 41, .isSfloat = false, .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0 },
+};
+static const s_MsmtGroupTemplate tempGroupTemplate =
+{
+    .dataLength = 45, .timestamp_index = 5, .no_of_msmts_index = 14,
+    .numberOfSuppTypes = 0, .suppTypes_index = 0, .numberRefs = 0, .ref_index = 0, .duration_index = 0,
+    .numberOfGhsMsmts = 2, .sGhsMsmtIndex = tempGroupTemplateIndex, .data = tempGroupTemplateData
+};
+#endif
+
+#endif  // MSMT_GROUP_TEMPLATES_H__
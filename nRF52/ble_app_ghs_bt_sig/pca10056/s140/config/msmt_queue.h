@@ -22,17 +22,29 @@ DEALINGS IN THE SOFTWARE.
 #ifndef MSMT_QUEUE_H__
 #define MSMT_QUEUE_H__
 
-// Data structure to represent a queue
+// Data structure to represent a queue. The producer side (enqueue) and the consumer side (front, dequeue, emptyQueue)
+// may run in different interrupt contexts without a lock. A side may be used from more than one context only if no
+// call on it can be interrupted by another call on the same side: a caller that can be preempted by another caller
+// of its side makes the call in a critical region. requestEmptyQueue() may be called from any context.
 typedef struct
 {
     void** msmts;     // array to store queue elements
-    int maxsize;    // maximum capacity of the queue
-    int front;      // front points to the front element in the queue (if any)
-    int rear;       // rear points to the last element in the queue
-    int size;       // current capacity of the queue
+    int maxsize;    // maximum capacity of the queue, a power of two
+    volatile unsigned int head;     // count of elements ever enqueued, only written by the producer
+    volatile unsigned int tail;     // count of elements ever dequeued, only written by the consumer
+    unsigned long overflowCount;    // number of elements rejected because the queue was full
+    unsigned char* pool;            // single block backing all slots when the queue is pool backed, else NULL
+    unsigned short elementSize;     // size of a pool slot in bytes, 0 if not pool backed
+    int highWaterMark;              // largest number of elements ever held at once
+    unsigned long allocationsAvoided;   // number of enqueues served from the pool instead of calloc
+    unsigned long bytesCopied;          // bytes memcpy'ed into slots by enqueue()
+    volatile unsigned int emptyTo;      // head when requestEmptyQueue() was last called
+    volatile unsigned char emptyRequested;  // set by requestEmptyQueue(), cleared by the consumer once it has emptied
 }s_Queue;
 
-s_Queue* initializeQueue(int size);
+// Utility function to initialize a queue. size must be a power of two, else NULL is returned.
+// If elementSize is non-zero all slots are taken from one pool
+s_Queue* initializeQueue(int size, unsigned short elementSize);
 
 // Utility function to return the size of the queue
 int size(s_Queue* queue);
@@ -52,5 +64,8 @@ void enqueue(s_Queue* queue, void* msmt, unsigned short length);
 void dequeue(s_Queue* queue);
 
 void emptyQueue(s_Queue* queue);
+
+// Utility function to have the consumer discard all queued elements the next time it takes or drops the front element
+void requestEmptyQueue(s_Queue* queue);
 void cleanUpQueue(s_Queue* queue);
 #endif